@@ -0,0 +1,457 @@
+// Measures how long sky settings take end to end, from a MenuState change to
+// the sky side finishing the command, over the same path Application uses:
+// the change callback renders the [remote] template and queues it on the
+// CommandExecutor remote lane, whose job sends it through the transport.
+//
+//   apply_latency_bench [--mode single|pipelined|batch|all] [--transport udp|ssh]
+//                       [--changes 30] [--debounce 150] [--config command.cfg]
+//                       [--latency ms] [--jitter ms] [--loss pct] [--reorder pct] [--exec-ms ms]
+//                       [--target ip] [--port 24650] [--rx-port 24651]
+//                       [--ssh host:port] [--user root] [--password 12345]
+//
+// single:    one change at a time through the debounced remote lane, as the
+//            menu does it.
+// pipelined: the same commands through SendAsync back to back (tagged UDP
+//            requests), against sending them one by one.
+// batch:     the startup state sync as one RenderBatch script, against one
+//            query per [remote_query] key.
+//
+// UDP starts sky_sim on --port/--rx-port with the --latency, --jitter,
+// --loss, --reorder and --exec-ms options unless --target names a real sky
+// unit. SSH needs a build with libssh and runs the templates for real, so
+// point --ssh at a throwaway container running sshd.
+
+#include "command_executor.h"
+#include "command_templates.h"
+#include "command_transport.h"
+#include "logger.h"
+#include "menu_state.h"
+#include "remote_setting.h"
+#include "udp_command_client.h"
+#include "video_mode.h"
+#ifdef AML_BENCH_HAVE_SSH
+#include "ssh_command_client.h"
+#endif
+
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+extern char **environ;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string mode = "all";
+    std::string transport = "udp";
+    int changes = 30;
+    int debounce_ms = 150;
+    std::string config;
+    std::string latency = "0";
+    std::string jitter = "0";
+    std::string loss = "0";
+    std::string reorder = "0";
+    std::string exec_ms = "0";
+    std::string target;
+    uint16_t port = 24650;
+    uint16_t rx_port = 24651;
+    std::string ssh_host = "127.0.0.1";
+    uint16_t ssh_port = 22;
+    std::string user = "root";
+    std::string password = "12345";
+};
+
+double Ms(Clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void Report(const char *name, std::vector<double> samples, int failures)
+{
+    if (samples.empty())
+    {
+        std::printf("%-22s no successful samples, %d failed\n", name, failures);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t p95 = std::min(samples.size() - 1, (samples.size() * 95 + 99) / 100 - 1);
+    std::printf("%-22s n=%-4zu min %7.1f  median %7.1f  p95 %7.1f  max %7.1f ms, %d failed\n", name,
+                samples.size(), samples.front(), samples[samples.size() / 2], samples[p95], samples.back(),
+                failures);
+}
+
+// The [remote] command for the setting type, from the same parameters
+// Application::ApplyRemoteSetting uses.
+bool RenderSetting(const CommandTemplates &templates, const MenuState &menu, MenuState::SettingType type,
+                   std::string &key, std::string &cmd)
+{
+    TemplateParams vars;
+    const char *name = RemoteSettingParams(menu, type, vars);
+    if (!name)
+        return false;
+    key = name;
+    cmd = templates.Render("remote", key, vars);
+    return !cmd.empty();
+}
+
+// Steps channel, bitrate and sky power in turn, like a user working the menu.
+void ChangeSetting(MenuState &menu, int step)
+{
+    switch (step % 3)
+    {
+    case 0:
+        menu.SetChannelIndex((menu.ChannelIndex() + 1) % static_cast<int>(menu.Channels().size()));
+        break;
+    case 1:
+        menu.SetBitrateIndex((menu.BitrateIndex() + 1) % static_cast<int>(menu.Bitrates().size()));
+        break;
+    default:
+        menu.SetSkyPowerIndex((menu.SkyPowerIndex() + 1) % static_cast<int>(menu.PowerLevels().size()));
+        break;
+    }
+}
+
+class SkySimProcess
+{
+public:
+    ~SkySimProcess() { Stop(); }
+
+    bool Start(const Options &options)
+    {
+        const std::string port = std::to_string(options.port);
+        const std::string reply = "127.0.0.1:" + std::to_string(options.rx_port);
+        std::vector<std::string> args = {AML_SKY_SIM, "--port", port, "--reply", reply, "--tags",
+                                         "--latency", options.latency, "--jitter", options.jitter,
+                                         "--loss", options.loss, "--reorder", options.reorder,
+                                         "--exec-ms", options.exec_ms};
+        std::vector<char *> argv;
+        for (auto &arg : args)
+            argv.push_back(&arg[0]);
+        argv.push_back(nullptr);
+        if (posix_spawn(&pid_, AML_SKY_SIM, nullptr, nullptr, argv.data(), environ) != 0)
+        {
+            pid_ = -1;
+            std::fprintf(stderr, "cannot start %s\n", AML_SKY_SIM);
+            return false;
+        }
+        return true;
+    }
+
+    void Stop()
+    {
+        if (pid_ <= 0)
+            return;
+        kill(pid_, SIGTERM);
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+    }
+
+private:
+    pid_t pid_ = -1;
+};
+
+std::shared_ptr<CommandTransport> MakeTransport(const Options &options, bool request_ids)
+{
+    if (options.transport == "ssh")
+    {
+#ifdef AML_BENCH_HAVE_SSH
+        return std::make_shared<SshCommandClient>(options.ssh_host, options.ssh_port, options.user,
+                                                  options.password);
+#else
+        std::fprintf(stderr, "built without libssh, SSH is not available\n");
+        return nullptr;
+#endif
+    }
+    const std::string ip = options.target.empty() ? "127.0.0.1" : options.target;
+    auto transport = std::make_shared<UdpCommandClient>(ip, options.port, options.rx_port, request_ids);
+    // Wait for the simulator to come up; with loss configured a probe may
+    // need a few attempts.
+    const auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (!transport->Send("true", false, 200))
+    {
+        if (Clock::now() > deadline)
+        {
+            std::fprintf(stderr, "no answer from the sky side on port %u\n", options.port);
+            return nullptr;
+        }
+    }
+    return transport;
+}
+
+bool RunSingle(const Options &options, const CommandTemplates &templates)
+{
+    auto transport = MakeTransport(options, false);
+    if (!transport)
+        return false;
+    MenuState menu(DefaultSkyModes(), {});
+    CommandExecutor executor;
+    executor.SetDebounce(std::chrono::milliseconds(options.debounce_ms));
+    executor.Start();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    int finished = 0;
+    int failures = 0;
+    std::vector<double> samples;
+    menu.SetOnChangeCallback([&](MenuState::SettingType type)
+                             {
+        const auto changed = Clock::now();
+        std::string key;
+        std::string cmd;
+        if (!RenderSetting(templates, menu, type, key, cmd))
+            return;
+        executor.EnqueueRemote([&, cmd, changed]()
+                               {
+            const bool ok = transport->Send(cmd, false);
+            const double ms = Ms(Clock::now() - changed);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok)
+                samples.push_back(ms);
+            else
+                ++failures;
+            ++finished;
+            cv.notify_all(); }, key); });
+
+    for (int i = 0; i < options.changes; ++i)
+    {
+        ChangeSetting(menu, i);
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!cv.wait_for(lock, std::chrono::seconds(10), [&]() { return finished > i; }))
+        {
+            std::fprintf(stderr, "change %d never finished\n", i);
+            break;
+        }
+    }
+    executor.Stop();
+    char name[64];
+    std::snprintf(name, sizeof(name), "single (debounce %d)", options.debounce_ms);
+    Report(name, samples, failures);
+    return true;
+}
+
+bool RunPipelined(const Options &options, const CommandTemplates &templates)
+{
+    auto transport = MakeTransport(options, true);
+    if (!transport)
+        return false;
+    MenuState menu(DefaultSkyModes(), {});
+    std::vector<std::string> commands;
+    menu.SetOnChangeCallback([&](MenuState::SettingType type)
+                             {
+        std::string key;
+        std::string cmd;
+        if (RenderSetting(templates, menu, type, key, cmd))
+            commands.push_back(cmd); });
+    for (int i = 0; i < options.changes; ++i)
+        ChangeSetting(menu, i);
+
+    std::vector<double> sequential;
+    int sequential_failures = 0;
+    const auto sequential_start = Clock::now();
+    for (const auto &cmd : commands)
+    {
+        const auto sent = Clock::now();
+        if (transport->Send(cmd, false))
+            sequential.push_back(Ms(Clock::now() - sent));
+        else
+            ++sequential_failures;
+    }
+    const double sequential_total = Ms(Clock::now() - sequential_start);
+
+    struct InFlight
+    {
+        Clock::time_point sent;
+        std::future<CommandResult> reply;
+    };
+    std::vector<InFlight> in_flight;
+    std::vector<double> pipelined;
+    int pipelined_failures = 0;
+    const auto pipelined_start = Clock::now();
+    for (const auto &cmd : commands)
+    {
+        const auto sent = Clock::now();
+        in_flight.push_back({sent, transport->SendAsync(cmd, sent + std::chrono::milliseconds(2000))});
+    }
+    // Poll so each command is timed when it finishes, not when it is reached.
+    while (!in_flight.empty())
+    {
+        for (auto it = in_flight.begin(); it != in_flight.end();)
+        {
+            if (it->reply.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++it;
+                continue;
+            }
+            if (it->reply.get().status == CommandStatus::Ok)
+                pipelined.push_back(Ms(Clock::now() - it->sent));
+            else
+                ++pipelined_failures;
+            it = in_flight.erase(it);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    const double pipelined_total = Ms(Clock::now() - pipelined_start);
+
+    Report("sequential", sequential, sequential_failures);
+    Report("pipelined", pipelined, pipelined_failures);
+    std::printf("%-22s %zu commands: sequential %.1f ms, pipelined %.1f ms\n", "total", commands.size(),
+                sequential_total, pipelined_total);
+    return true;
+}
+
+bool RunBatch(const Options &options, const CommandTemplates &templates)
+{
+    auto transport = MakeTransport(options, false);
+    if (!transport)
+        return false;
+    const std::string script = templates.RenderBatch("remote_query");
+    const std::vector<std::string> keys = templates.Keys("remote_query");
+    if (script.empty())
+    {
+        std::fprintf(stderr, "no [remote_query] templates\n");
+        return false;
+    }
+
+    std::vector<double> batch;
+    std::vector<double> per_key;
+    int batch_failures = 0;
+    int per_key_failures = 0;
+    for (int i = 0; i < options.changes; ++i)
+    {
+        auto start = Clock::now();
+        std::vector<std::string> lines;
+        std::unordered_map<std::string, std::string> values;
+        if (transport->SendWithReply(script, lines, 2000) && CommandTemplates::ParseBatchReply(lines, values) &&
+            values.size() == keys.size())
+            batch.push_back(Ms(Clock::now() - start));
+        else
+            ++batch_failures;
+
+        start = Clock::now();
+        size_t answered = 0;
+        for (const auto &key : keys)
+        {
+            if (transport->SendWithReply(templates.Render("remote_query", key), lines, 1000) && !lines.empty())
+                ++answered;
+        }
+        if (answered == keys.size())
+            per_key.push_back(Ms(Clock::now() - start));
+        else
+            ++per_key_failures;
+    }
+    Report("batch query", batch, batch_failures);
+    char name[64];
+    std::snprintf(name, sizeof(name), "per-key query (%zu)", keys.size());
+    Report(name, per_key, per_key_failures);
+    return true;
+}
+
+bool ParseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string arg = argv[i];
+        const std::string value = argv[i + 1];
+        if (arg == "--mode")
+            options.mode = value;
+        else if (arg == "--transport")
+            options.transport = value;
+        else if (arg == "--changes")
+            options.changes = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--debounce")
+            options.debounce_ms = std::atoi(value.c_str());
+        else if (arg == "--config")
+            options.config = value;
+        else if (arg == "--latency")
+            options.latency = value;
+        else if (arg == "--jitter")
+            options.jitter = value;
+        else if (arg == "--loss")
+            options.loss = value;
+        else if (arg == "--reorder")
+            options.reorder = value;
+        else if (arg == "--exec-ms")
+            options.exec_ms = value;
+        else if (arg == "--target")
+            options.target = value;
+        else if (arg == "--port")
+            options.port = static_cast<uint16_t>(std::atoi(value.c_str()));
+        else if (arg == "--rx-port")
+            options.rx_port = static_cast<uint16_t>(std::atoi(value.c_str()));
+        else if (arg == "--ssh")
+        {
+            const size_t colon = value.rfind(':');
+            options.ssh_host = value.substr(0, colon);
+            if (colon != std::string::npos)
+                options.ssh_port = static_cast<uint16_t>(std::atoi(value.c_str() + colon + 1));
+        }
+        else if (arg == "--user")
+            options.user = value;
+        else if (arg == "--password")
+            options.password = value;
+        else
+            return false;
+    }
+    return argc % 2 == 1 && (options.transport == "udp" || options.transport == "ssh") &&
+           (options.mode == "all" || options.mode == "single" || options.mode == "pipelined" ||
+            options.mode == "batch");
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr,
+                     "usage: %s [--mode single|pipelined|batch|all] [--transport udp|ssh] [--changes n]\n"
+                     "       [--debounce ms] [--config command.cfg] [--latency ms] [--jitter ms] [--loss pct]\n"
+                     "       [--reorder pct] [--exec-ms ms] [--target ip] [--port n] [--rx-port n]\n"
+                     "       [--ssh host:port] [--user name] [--password text]\n",
+                     argv[0]);
+        return 1;
+    }
+    // Rate-limited transport warnings stay visible; the rest would interleave
+    // with the results.
+    Logger::Shared().SetLevel(LogLevel::Warn);
+
+    CommandTemplates templates;
+    if (!options.config.empty() && !templates.LoadFromFile(options.config))
+    {
+        std::fprintf(stderr, "cannot load %s\n", options.config.c_str());
+        return 1;
+    }
+
+    SkySimProcess sim;
+    if (options.transport == "udp" && options.target.empty() && !sim.Start(options))
+        return 1;
+    std::printf("%s, %d changes, latency %s ms, jitter %s ms, loss %s%%, reorder %s%%, exec %s ms\n",
+                options.transport.c_str(), options.changes, options.latency.c_str(), options.jitter.c_str(),
+                options.loss.c_str(), options.reorder.c_str(), options.exec_ms.c_str());
+
+    const bool all = options.mode == "all";
+    if ((all || options.mode == "single") && !RunSingle(options, templates))
+        return 1;
+    if ((all || options.mode == "pipelined") && !RunPipelined(options, templates))
+        return 1;
+    if ((all || options.mode == "batch") && !RunBatch(options, templates))
+        return 1;
+    return 0;
+}
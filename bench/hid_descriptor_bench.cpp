@@ -0,0 +1,109 @@
+// Times FindHidBatteryField and HashHidDescriptor over a directory of raw HID
+// report descriptors and prints the battery field each one resolves to.
+//
+//   hid_descriptor_bench [descriptor dir] [iterations]
+//
+// The default is fuzz/corpus/hid_descriptor, which holds hand-written
+// descriptors (boot keyboard and mouse, gamepads and a UPS with battery
+// usages), not dumps from real devices. To time a real controller, copy its
+// descriptor from /sys/class/hidraw/hidrawN/device/report_descriptor into a
+// directory and pass that.
+
+#include "hid_descriptor.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct Descriptor
+{
+    std::string name;
+    std::vector<uint8_t> bytes;
+};
+
+std::vector<Descriptor> LoadDescriptors(const std::string &dir)
+{
+    std::vector<Descriptor> descriptors;
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return descriptors;
+    while (dirent *entry = readdir(d))
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::ifstream file(dir + "/" + entry->d_name, std::ios::binary);
+        if (!file)
+            continue;
+        Descriptor desc;
+        desc.name = entry->d_name;
+        desc.bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        descriptors.push_back(std::move(desc));
+    }
+    closedir(d);
+    std::sort(descriptors.begin(), descriptors.end(),
+              [](const Descriptor &a, const Descriptor &b) { return a.name < b.name; });
+    return descriptors;
+}
+
+template <typename Fn>
+double NsPerCall(int iterations, Fn &&fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < iterations; ++iter)
+        fn();
+    const double elapsed_ns =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed_ns / iterations;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const std::string dir = argc > 1 ? argv[1] : AML_HID_CORPUS_DIR;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 200000;
+
+    const std::vector<Descriptor> descriptors = LoadDescriptors(dir);
+    if (descriptors.empty() || iterations <= 0)
+    {
+        std::fprintf(stderr, "no descriptors in %s\n", dir.c_str());
+        return 1;
+    }
+
+    // Keeps the calls from being optimised away.
+    volatile uint64_t sink = 0;
+    std::printf("%s: %zu descriptors x %d\n", dir.c_str(), descriptors.size(), iterations);
+    std::printf("%-24s %6s %10s %10s  %s\n", "descriptor", "bytes", "find ns", "hash ns", "battery field");
+    double total_find_ns = 0.0;
+    for (const Descriptor &desc : descriptors)
+    {
+        const uint8_t *data = desc.bytes.data();
+        const size_t size = desc.bytes.size();
+        const double find_ns = NsPerCall(iterations, [&]() {
+            const auto field = FindHidBatteryField(data, size);
+            sink = sink + (field ? field->bit_offset + 1 : 0);
+        });
+        const double hash_ns = NsPerCall(iterations, [&]() { sink = sink + HashHidDescriptor(data, size); });
+        total_find_ns += find_ns;
+
+        char field_text[96] = "none";
+        if (const auto field = FindHidBatteryField(data, size))
+        {
+            std::snprintf(field_text, sizeof(field_text), "%s report %u, bits %u+%u of %u",
+                          field->is_feature ? "feature" : "input", static_cast<unsigned>(field->report_id),
+                          static_cast<unsigned>(field->bit_offset), static_cast<unsigned>(field->bit_size),
+                          static_cast<unsigned>(field->report_bits));
+        }
+        std::printf("%-24s %6zu %10.1f %10.1f  %s\n", desc.name.c_str(), size, find_ns, hash_ns, field_text);
+    }
+    std::printf("mean find: %.1f ns per descriptor\n", total_find_ns / static_cast<double>(descriptors.size()));
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Replays the MESSAGE fields of a journal export capture through
+// ParseWfbLogMessage and reports entries per second, plus the number of heap
+// allocations made while parsing (expected: 0).
+//
+//   wfb_log_parser_bench [capture] [iterations]
+//
+// Without arguments it reads bench/data/wfb_rx_export.log, a synthetic export
+// written in the journal's format with wfb_rx's RX_ANT/PKT message layout,
+// not a recording. For numbers from a real link, record a capture on the
+// ground station with
+//   journalctl -u wifibroadcast --output=export > wfb_rx_export.log
+
+#include "wfb_log_parser.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+std::atomic<uint64_t> g_allocations{0};
+
+// Same framing as SignalMonitor::ConsumeExport: "FIELD=value\n" lines, a blank
+// line between entries, and "FIELD\n<le64 size><data>\n" for binary values.
+std::vector<std::string> ReadMessages(const std::string &data)
+{
+    std::vector<std::string> messages;
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        const size_t nl = data.find('\n', pos);
+        if (nl == std::string::npos)
+            break;
+        if (nl == pos)
+        {
+            pos = nl + 1;
+            continue;
+        }
+        const size_t eq = data.find('=', pos);
+        if (eq != std::string::npos && eq < nl)
+        {
+            if (data.compare(pos, eq - pos, "MESSAGE") == 0)
+                messages.emplace_back(data, eq + 1, nl - eq - 1);
+            pos = nl + 1;
+            continue;
+        }
+        const size_t size_pos = nl + 1;
+        if (data.size() < size_pos + 8)
+            break;
+        uint64_t len = 0;
+        for (size_t i = 0; i < 8; ++i)
+            len |= static_cast<uint64_t>(static_cast<uint8_t>(data[size_pos + i])) << (8 * i);
+        const size_t data_pos = size_pos + 8;
+        if (data.size() < data_pos + len + 1)
+            break;
+        if (data.compare(pos, nl - pos, "MESSAGE") == 0)
+            messages.emplace_back(data, data_pos, static_cast<size_t>(len));
+        pos = data_pos + static_cast<size_t>(len) + 1;
+    }
+    return messages;
+}
+} // namespace
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char **argv)
+{
+    const std::string path = argc > 1 ? argv[1] : AML_BENCH_DATA_DIR "/wfb_rx_export.log";
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return 1;
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const std::vector<std::string> messages = ReadMessages(data);
+    if (messages.empty() || iterations <= 0)
+    {
+        std::fprintf(stderr, "no MESSAGE fields in %s\n", path.c_str());
+        return 1;
+    }
+
+    size_t rx_ant = 0;
+    size_t pkt = 0;
+    uint64_t checksum = 0;
+    const uint64_t allocations_before = g_allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < iterations; ++iter)
+    {
+        for (const std::string &message : messages)
+        {
+            uint64_t log_ts = 0;
+            AntennaSample antenna{};
+            PacketSample packets{};
+            switch (ParseWfbLogMessage(message, log_ts, antenna, packets))
+            {
+            case WfbLogRecord::RxAnt:
+                ++rx_ant;
+                checksum += static_cast<uint64_t>(antenna.rssi_avg);
+                break;
+            case WfbLogRecord::Pkt:
+                ++pkt;
+                checksum += packets.out_bytes;
+                break;
+            case WfbLogRecord::None:
+                break;
+            }
+            checksum += log_ts;
+        }
+    }
+    const double elapsed_s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t allocations = g_allocations.load() - allocations_before;
+
+    const double entries = static_cast<double>(messages.size()) * iterations;
+    std::printf("%s: %zu messages (%zu RX_ANT, %zu PKT per pass) x %d\n", path.c_str(), messages.size(),
+                rx_ant / static_cast<size_t>(iterations), pkt / static_cast<size_t>(iterations), iterations);
+    std::printf("%.0f entries/s, %.1f ns/entry, %llu allocations while parsing (checksum %llx)\n",
+                entries / elapsed_s, elapsed_s * 1e9 / entries, static_cast<unsigned long long>(allocations),
+                static_cast<unsigned long long>(checksum));
+    return allocations == 0 ? 0 : 2;
+}
@@ -0,0 +1,26 @@
+// Feeds arbitrary bytes to the HID report descriptor walker. Whatever field it
+// resolves must be readable from a report of the size it claims.
+
+#include "hid_descriptor.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    HashHidDescriptor(data, size);
+    const auto field = FindHidBatteryField(data, size, size > 0 && (data[0] & 1));
+    if (!field)
+        return 0;
+    if (field->bit_size == 0 || field->bit_size > 16)
+        std::abort();
+    // report_bits is where the report ends, so the field must fit inside it.
+    if (field->bit_offset + field->bit_size > field->report_bits)
+        std::abort();
+    const std::vector<uint8_t> report((field->report_bits + 7) / 8, 0xFF);
+    const float percent = ExtractHidBatteryPercent(report.data(), report.size(), *field);
+    if (percent < 0.0f || percent > 100.0f)
+        std::abort();
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Loads arbitrary bytes as the on-disk HID field cache, then checks that
+// what was accepted survives a Save/Load round trip unchanged.
+
+#include "hid_descriptor.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+const std::string &CachePath()
+{
+    static const std::string path = "/tmp/hid_field_cache_fuzz." + std::to_string(getpid());
+    return path;
+}
+
+bool SameField(const std::optional<HidBatteryField> &a, const std::optional<HidBatteryField> &b)
+{
+    if (a.has_value() != b.has_value())
+        return false;
+    if (!a)
+        return true;
+    return a->report_id == b->report_id && a->bit_offset == b->bit_offset && a->bit_size == b->bit_size &&
+           a->is_feature == b->is_feature && a->report_bits == b->report_bits;
+}
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    const std::string &path = CachePath();
+    if (FILE *file = std::fopen(path.c_str(), "wb"))
+    {
+        std::fwrite(data, 1, size, file);
+        std::fclose(file);
+    }
+    // Probe keys taken from the input so loaded entries are actually hit.
+    uint16_t vendor = 0x045e;
+    uint16_t product = 0x0b13;
+    uint64_t hash = HashHidDescriptor(data, size);
+    if (size >= 12)
+    {
+        vendor = static_cast<uint16_t>(data[0] | data[1] << 8);
+        product = static_cast<uint16_t>(data[2] | data[3] << 8);
+        hash = 0;
+        for (int i = 0; i < 8; ++i)
+            hash |= static_cast<uint64_t>(data[4 + i]) << (8 * i);
+    }
+
+    HidFieldCache loaded(path);
+    const auto before = loaded.Find(vendor, product, hash);
+    // Store rewrites the file from the parsed entries.
+    HidBatteryField probe{};
+    probe.report_id = 3;
+    probe.bit_offset = 8;
+    probe.bit_size = 8;
+    probe.report_bits = 16;
+    loaded.Store(0xffff, 0xffff, 0x5a5a5a5a5a5a5a5aull, probe);
+
+    HidFieldCache reloaded(path);
+    const auto after = reloaded.Find(vendor, product, hash);
+    if (before.has_value() != after.has_value() || (before && !SameField(*before, *after)))
+        std::abort();
+    const auto stored = reloaded.Find(0xffff, 0xffff, 0x5a5a5a5a5a5a5a5aull);
+    if (!stored || !SameField(*stored, probe))
+        std::abort();
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Stand-in for libFuzzer's driver on toolchains without -fsanitize=fuzzer:
+// runs every file given on the command line, or every file in a given
+// directory, through LLVMFuzzerTestOneInput once. Options ("-runs=0") are
+// ignored so the same ctest command works with both drivers.
+
+#include <cstdint>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+namespace
+{
+int RunFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return 1;
+    }
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    return 0;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int failures = 0;
+    size_t runs = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg.empty() || arg[0] == '-')
+            continue;
+        struct stat st{};
+        if (stat(arg.c_str(), &st) != 0)
+        {
+            std::fprintf(stderr, "cannot stat %s\n", arg.c_str());
+            ++failures;
+            continue;
+        }
+        if (!S_ISDIR(st.st_mode))
+        {
+            failures += RunFile(arg);
+            ++runs;
+            continue;
+        }
+        DIR *dir = opendir(arg.c_str());
+        while (dirent *entry = dir ? readdir(dir) : nullptr)
+        {
+            if (entry->d_name[0] == '.')
+                continue;
+            failures += RunFile(arg + "/" + entry->d_name);
+            ++runs;
+        }
+        if (dir)
+            closedir(dir);
+    }
+    std::printf("replayed %zu inputs\n", runs);
+    return failures == 0 ? 0 : 1;
+}
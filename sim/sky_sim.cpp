@@ -0,0 +1,483 @@
+// Stands in for the sky unit's command daemon on the ground box or a build
+// host, so UdpCommandClient and the Apply* paths can be exercised without a
+// drone. Speaks the same protocol: every command datagram is answered with an
+// "OK" (ACK), one datagram per output line, "timeout" if the command ran past
+// its limit, and a final "OK".
+//
+//   sky_sim [--port 14650] [--reply 127.0.0.1:14651] [--latency ms] [--jitter ms]
+//           [--loss pct] [--reorder pct] [--reorder-delay ms] [--exec-ms ms]
+//           [--exec] [--cmd-timeout ms] [--stub-reply text] [--workers n]
+//           [--tags] [--seed n] [--verbose]
+//
+// --latency/--jitter delay each datagram in both directions. --loss drops
+// that share of requests and of reply datagrams. --reorder holds that share
+// of reply datagrams back by --reorder-delay so later ones overtake them.
+// Commands are stubbed by default: they take --exec-ms and print
+// --stub-reply, or one line per "@@<key>" marker of a batch script. --exec
+// runs them with /bin/sh instead. --tags answers "#id:<n>" requests with
+// "#<n> " prefixed replies like a tag-aware daemon; without it the tag line is
+// ignored, as a legacy daemon's shell would. Statistics are printed on
+// SIGINT/SIGTERM.
+
+#include "process_runner.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+std::atomic<bool> g_stop{false};
+
+void OnSignal(int)
+{
+    g_stop = true;
+}
+
+struct Options
+{
+    uint16_t port = 14650;
+    std::string reply_host = "127.0.0.1";
+    uint16_t reply_port = 14651;
+    int latency_ms = 0;
+    int jitter_ms = 0;
+    double loss_pct = 0.0;
+    double reorder_pct = 0.0;
+    int reorder_delay_ms = 20;
+    int exec_ms = 0;
+    bool exec = false;
+    int cmd_timeout_ms = 5000;
+    std::string stub_reply = "1";
+    int workers = 4;
+    bool tags = false;
+    unsigned seed = 1;
+    bool verbose = false;
+};
+
+struct Stats
+{
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> requests_lost{0};
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> replies_lost{0};
+    std::atomic<uint64_t> reordered{0};
+    std::atomic<uint64_t> timed_out{0};
+};
+
+struct Request
+{
+    std::string tag;
+    std::string cmd;
+};
+
+struct Outgoing
+{
+    Clock::time_point due;
+    uint64_t seq = 0;
+    std::string payload;
+
+    bool operator>(const Outgoing &other) const
+    {
+        return due != other.due ? due > other.due : seq > other.seq;
+    }
+};
+
+class SkySim
+{
+public:
+    explicit SkySim(const Options &options) : options_(options), rng_(options.seed) {}
+
+    bool Open();
+    void Run();
+    void PrintStats() const;
+
+private:
+    void ReceiveLoop();
+    void SendLoop();
+    void WorkerLoop();
+    void Handle(const std::string &datagram);
+    void Execute(const Request &request);
+    // Queues payload to go out after the configured latency, unless it is lost.
+    void Reply(const std::string &tag, const std::string &payload);
+    bool Roll(double pct);
+    Clock::duration Delay();
+    static std::vector<std::string> StubOutput(const std::string &cmd, const std::string &value);
+
+    Options options_;
+    Stats stats_;
+    int fd_ = -1;
+    sockaddr_in reply_addr_{};
+
+    std::mutex rng_mutex_;
+    std::mt19937 rng_;
+
+    // Guards the two queues below; cv_ is signalled on any change.
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::priority_queue<Outgoing, std::vector<Outgoing>, std::greater<Outgoing>> outgoing_;
+    uint64_t next_seq_ = 0;
+    std::deque<Request> requests_;
+};
+
+bool SkySim::Open()
+{
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0)
+    {
+        std::perror("socket");
+        return false;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(options_.port);
+    if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        std::fprintf(stderr, "bind 127.0.0.1:%u: %s\n", options_.port, std::strerror(errno));
+        return false;
+    }
+    reply_addr_.sin_family = AF_INET;
+    reply_addr_.sin_port = htons(options_.reply_port);
+    if (inet_pton(AF_INET, options_.reply_host.c_str(), &reply_addr_.sin_addr) != 1)
+    {
+        std::fprintf(stderr, "invalid reply address %s\n", options_.reply_host.c_str());
+        return false;
+    }
+    return true;
+}
+
+void SkySim::Run()
+{
+    std::thread sender(&SkySim::SendLoop, this);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options_.workers; ++i)
+        workers.emplace_back(&SkySim::WorkerLoop, this);
+    ReceiveLoop();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_all();
+    }
+    for (auto &worker : workers)
+        worker.join();
+    sender.join();
+    close(fd_);
+}
+
+void SkySim::ReceiveLoop()
+{
+    char buf[65536];
+    while (!g_stop)
+    {
+        pollfd pfd{fd_, POLLIN, 0};
+        // Signals interrupt poll; the timeout only covers a signal that lands
+        // just before it.
+        const int pr = poll(&pfd, 1, 200);
+        if (pr <= 0)
+            continue;
+        const ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+        if (n < 0)
+            continue;
+        stats_.requests.fetch_add(1, std::memory_order_relaxed);
+        if (Roll(options_.loss_pct))
+        {
+            stats_.requests_lost.fetch_add(1, std::memory_order_relaxed);
+            if (options_.verbose)
+                std::fprintf(stderr, "lost request: %.*s\n", static_cast<int>(n), buf);
+            continue;
+        }
+        Handle(std::string(buf, static_cast<size_t>(n)));
+    }
+}
+
+void SkySim::Handle(const std::string &datagram)
+{
+    Request request;
+    request.cmd = datagram;
+    // "#id:<n>\n<command>"; a legacy daemon hands the whole text to the shell,
+    // where the tag line is a comment.
+    if (datagram.compare(0, 4, "#id:") == 0)
+    {
+        const size_t nl = datagram.find('\n');
+        if (options_.tags && nl != std::string::npos)
+            request.tag = "#" + datagram.substr(4, nl - 4) + " ";
+        if (nl != std::string::npos)
+            request.cmd = datagram.substr(nl + 1);
+    }
+    if (options_.verbose)
+        std::fprintf(stderr, "request %s: %s\n", request.tag.c_str(), request.cmd.c_str());
+    Reply(request.tag, "OK");
+    // Delay() charges the inbound latency to every reply, so the command can
+    // start right away.
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_.push_back(std::move(request));
+    cv_.notify_all();
+}
+
+void SkySim::WorkerLoop()
+{
+    pthread_setname_np(pthread_self(), "sim-exec");
+    while (true)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&]() { return g_stop || !requests_.empty(); });
+            if (g_stop)
+                return;
+            request = std::move(requests_.front());
+            requests_.pop_front();
+        }
+        Execute(request);
+    }
+}
+
+void SkySim::Execute(const Request &request)
+{
+    const auto timeout = std::chrono::milliseconds(options_.cmd_timeout_ms);
+    std::vector<std::string> lines;
+    bool timed_out = false;
+    if (options_.exec)
+    {
+        ProcessResult result = RunShellCommand(request.cmd, timeout, 64 * 1024);
+        timed_out = result.timed_out;
+        size_t pos = 0;
+        while (pos < result.output.size())
+        {
+            size_t nl = result.output.find('\n', pos);
+            if (nl == std::string::npos)
+                nl = result.output.size();
+            if (nl > pos)
+                lines.emplace_back(result.output, pos, nl - pos);
+            pos = nl + 1;
+        }
+    }
+    else
+    {
+        const auto run = std::chrono::milliseconds(options_.exec_ms);
+        timed_out = run > timeout;
+        std::this_thread::sleep_for(timed_out ? timeout : run);
+        if (!timed_out)
+            lines = StubOutput(request.cmd, options_.stub_reply);
+    }
+    if (timed_out)
+        stats_.timed_out.fetch_add(1, std::memory_order_relaxed);
+    for (const auto &line : lines)
+        Reply(request.tag, line);
+    if (timed_out)
+        Reply(request.tag, "timeout");
+    Reply(request.tag, "OK");
+}
+
+std::vector<std::string> SkySim::StubOutput(const std::string &cmd, const std::string &value)
+{
+    // A CommandTemplates::RenderBatch script announces each key with
+    // "echo '@@<key>'"; answer every key with the same value.
+    static const std::string kMarker = "echo '@@";
+    std::vector<std::string> lines;
+    size_t pos = cmd.find(kMarker);
+    if (pos == std::string::npos)
+    {
+        lines.push_back(value);
+        return lines;
+    }
+    while (pos != std::string::npos)
+    {
+        const size_t begin = pos + kMarker.size() - 2;
+        const size_t end = cmd.find('\'', begin);
+        if (end == std::string::npos)
+            break;
+        const std::string marker = cmd.substr(begin, end - begin);
+        lines.push_back(marker);
+        if (marker != "@@end")
+            lines.push_back(value);
+        pos = cmd.find(kMarker, end);
+    }
+    return lines;
+}
+
+void SkySim::Reply(const std::string &tag, const std::string &payload)
+{
+    if (Roll(options_.loss_pct))
+    {
+        stats_.replies_lost.fetch_add(1, std::memory_order_relaxed);
+        if (options_.verbose)
+            std::fprintf(stderr, "lost reply %s%s\n", tag.c_str(), payload.c_str());
+        return;
+    }
+    Outgoing out;
+    out.due = Clock::now() + Delay();
+    if (Roll(options_.reorder_pct))
+    {
+        stats_.reordered.fetch_add(1, std::memory_order_relaxed);
+        out.due += std::chrono::milliseconds(options_.reorder_delay_ms);
+    }
+    out.payload = tag + payload;
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.seq = next_seq_++;
+    outgoing_.push(std::move(out));
+    cv_.notify_all();
+}
+
+void SkySim::SendLoop()
+{
+    pthread_setname_np(pthread_self(), "sim-send");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!g_stop)
+    {
+        if (outgoing_.empty())
+        {
+            cv_.wait(lock);
+            continue;
+        }
+        const Clock::time_point due = outgoing_.top().due;
+        if (Clock::now() < due)
+        {
+            cv_.wait_until(lock, due);
+            continue;
+        }
+        const std::string payload = outgoing_.top().payload;
+        outgoing_.pop();
+        lock.unlock();
+        if (sendto(fd_, payload.data(), payload.size(), 0, reinterpret_cast<const sockaddr *>(&reply_addr_),
+                   sizeof(reply_addr_)) >= 0)
+            stats_.sent.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+    }
+}
+
+bool SkySim::Roll(double pct)
+{
+    if (pct <= 0.0)
+        return false;
+    std::lock_guard<std::mutex> lock(rng_mutex_);
+    return std::uniform_real_distribution<double>(0.0, 100.0)(rng_) < pct;
+}
+
+Clock::duration SkySim::Delay()
+{
+    // One-way latency each for the request and the reply, so the round trip
+    // is twice --latency.
+    int ms = 2 * options_.latency_ms;
+    if (options_.jitter_ms > 0)
+    {
+        std::lock_guard<std::mutex> lock(rng_mutex_);
+        ms += std::uniform_int_distribution<int>(0, options_.jitter_ms)(rng_);
+    }
+    return std::chrono::milliseconds(ms);
+}
+
+void SkySim::PrintStats() const
+{
+    std::fprintf(stderr,
+                 "sky_sim: %llu requests (%llu lost), %llu replies sent (%llu lost, %llu reordered), "
+                 "%llu timed out\n",
+                 static_cast<unsigned long long>(stats_.requests.load()),
+                 static_cast<unsigned long long>(stats_.requests_lost.load()),
+                 static_cast<unsigned long long>(stats_.sent.load()),
+                 static_cast<unsigned long long>(stats_.replies_lost.load()),
+                 static_cast<unsigned long long>(stats_.reordered.load()),
+                 static_cast<unsigned long long>(stats_.timed_out.load()));
+}
+
+bool ParseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        const auto value = [&]() { return std::string(argv[++i]); };
+        if (arg == "--exec")
+            options.exec = true;
+        else if (arg == "--tags")
+            options.tags = true;
+        else if (arg == "--verbose")
+            options.verbose = true;
+        else if (!has_value)
+            return false;
+        else if (arg == "--port")
+            options.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        else if (arg == "--reply")
+        {
+            const std::string target = value();
+            const size_t colon = target.rfind(':');
+            if (colon == std::string::npos)
+                return false;
+            options.reply_host = target.substr(0, colon);
+            options.reply_port = static_cast<uint16_t>(std::atoi(target.c_str() + colon + 1));
+        }
+        else if (arg == "--latency")
+            options.latency_ms = std::atoi(argv[++i]);
+        else if (arg == "--jitter")
+            options.jitter_ms = std::atoi(argv[++i]);
+        else if (arg == "--loss")
+            options.loss_pct = std::atof(argv[++i]);
+        else if (arg == "--reorder")
+            options.reorder_pct = std::atof(argv[++i]);
+        else if (arg == "--reorder-delay")
+            options.reorder_delay_ms = std::atoi(argv[++i]);
+        else if (arg == "--exec-ms")
+            options.exec_ms = std::atoi(argv[++i]);
+        else if (arg == "--cmd-timeout")
+            options.cmd_timeout_ms = std::atoi(argv[++i]);
+        else if (arg == "--stub-reply")
+            options.stub_reply = value();
+        else if (arg == "--workers")
+            options.workers = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--seed")
+            options.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else
+            return false;
+    }
+    return true;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr,
+                     "usage: %s [--port 14650] [--reply 127.0.0.1:14651] [--latency ms] [--jitter ms]\n"
+                     "       [--loss pct] [--reorder pct] [--reorder-delay ms] [--exec-ms ms] [--exec]\n"
+                     "       [--cmd-timeout ms] [--stub-reply text] [--workers n] [--tags] [--seed n] [--verbose]\n",
+                     argv[0]);
+        return 1;
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = OnSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    SkySim sim(options);
+    if (!sim.Open())
+        return 1;
+    std::fprintf(stderr, "sky_sim: listening on 127.0.0.1:%u, replying to %s:%u\n", options.port,
+                 options.reply_host.c_str(), options.reply_port);
+    sim.Run();
+    sim.PrintStats();
+    return 0;
+}
@@ -7,6 +7,8 @@
 #include "udp_command_client.h"
 #include "ssh_command_client.h"
 #include "command_templates.h"
+#include "remote_setting.h"
+#include "logger.h"
 #include "terminal.h"
 #include "splash_data.h"
 
@@ -21,11 +23,11 @@
 #include <cstring>
 #include <fcntl.h>
 #include <fstream>
-#include <glob.h>
 #include <linux/fb.h>
 #include <linux/input-event-codes.h>
 #include <linux/joystick.h>
 #include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <cerrno>
 #include <unordered_map>
@@ -44,6 +46,8 @@ namespace
 {
     constexpr float kOsdRefreshHz = 30.0f;
     constexpr int kSplashHoldMs = 1500;
+    // How long a synced remote state is trusted when the menu is reopened.
+    constexpr auto kRemoteStateTtl = std::chrono::seconds(30);
     std::string TrimCopy(const std::string &text)
     {
         size_t begin = 0;
@@ -59,6 +63,33 @@ namespace
         return text.substr(begin, end - begin);
     }
 
+    std::vector<MenuRenderer::GroundAntenna> ConvertGroundAntennas(const GroundSignalSnapshot &signal)
+    {
+        std::vector<MenuRenderer::GroundAntenna> out;
+        uint64_t total_packets = 0;
+        for (size_t i = 0; i < signal.antenna_count; ++i)
+        {
+            total_packets += signal.antennas[i].window_packets;
+        }
+        out.reserve(signal.antenna_count);
+        for (size_t i = 0; i < signal.antenna_count; ++i)
+        {
+            const AntennaStats &stats = signal.antennas[i];
+            MenuRenderer::GroundAntenna ant;
+            ant.card = static_cast<int>(stats.antenna_id >> 8);
+            ant.chain = static_cast<int>(stats.antenna_id & 0xff);
+            ant.rssi_min = stats.window_rssi_min;
+            ant.rssi_avg = static_cast<int>(std::lround(stats.window_rssi_avg));
+            ant.rssi_max = stats.window_rssi_max;
+            ant.snr_avg = static_cast<int>(std::lround(stats.window_snr_avg));
+            ant.packet_share = total_packets > 0
+                                   ? static_cast<float>(stats.window_packets) / static_cast<float>(total_packets)
+                                   : 0.0f;
+            out.push_back(ant);
+        }
+        return out;
+    }
+
     MenuRenderer::TelemetryData ConvertTelemetry(const ParsedTelemetry &src, const MenuState &state)
     {
         MenuRenderer::TelemetryData out{};
@@ -162,8 +193,7 @@ bool Application::Initialize(const std::string &font_path, bool use_mock,
         std::fprintf(stderr, "[AMLgsMenu] Failed to init libinput/udev\n");
         return false;
     }
-    ScanJoysticks();
-    last_js_scan_ = std::chrono::steady_clock::now();
+    InitJoysticks();
     command_templates_.LoadFromFile(command_cfg_path_);
     cmd_runner_ = std::make_unique<CommandExecutor>();
 
@@ -200,9 +230,6 @@ bool Application::Initialize(const std::string &font_path, bool use_mock,
 
     terminal_ = std::make_unique<Terminal>();
     terminal_->setEmbedded(true);
-    signal_monitor_ = std::make_unique<SignalMonitor>();
-    telemetry_worker_ = std::make_unique<TelemetryWorker>(signal_monitor_.get());
-    telemetry_worker_->Start();
     terminal_->setFont(terminal_font_);
 
     auto sky_modes = DefaultSkyModes();
@@ -223,6 +250,30 @@ bool Application::Initialize(const std::string &font_path, bool use_mock,
     }
     menu_state_ = std::make_unique<MenuState>(sky_modes, ground_modes);
     LoadConfig();
+    if (local_nl80211_)
+    {
+        auto nl80211 = std::make_unique<Nl80211Client>();
+        if (nl80211->Open())
+            nl80211_ = std::move(nl80211);
+    }
+    if (nl80211_)
+    {
+        for (const char *key : {"monitor_channel", "monitor_power"})
+        {
+            if (!command_templates_.IsBuiltIn("local", key))
+                LOG_INFO("AMLgsMenu", "[local] %s is customised in command.cfg, running it instead of nl80211", key);
+        }
+    }
+    if (cmd_runner_)
+    {
+        cmd_runner_->SetDebounce(command_debounce_);
+        cmd_runner_->Start();
+    }
+    signal_monitor_ = CreateSignalMonitor();
+    thermal_policy_ = std::make_unique<ThermalPolicy>(thermal_config_);
+    telemetry_worker_ = std::make_unique<TelemetryWorker>(signal_monitor_.get(), osd_diagnostics_, thermal_policy_.get());
+    signal_monitor_->Start();
+    telemetry_worker_->Start();
     RebuildTransport(menu_state_->GetFirmwareType());
     StartRemoteSync();
     ApplyLanguageToImGui(menu_state_->GetLanguage());
@@ -247,15 +298,22 @@ bool Application::Initialize(const std::string &font_path, bool use_mock,
                     if (last_data.ground_signal_a == 0.0f)
                     {
                         std::fprintf(stdout, "[AMLgsMenu] First ground signal received,refresh sky signal values\n");
-                        RestartRemoteSync();
+                        RequestRemoteSync(true);
                     }
                     data.ground_signal_a = snap.ground_signal.signal_a;
                     data.ground_signal_b = snap.ground_signal.signal_b;
+                    data.ground_antennas = ConvertGroundAntennas(snap.ground_signal);
                 }
                 if (snap.packet_rate.valid && snap.packet_rate.primary_mbps > 0.0f)
                 {
                     data.bitrate_mbps = snap.packet_rate.primary_mbps;
                 }
+                if (snap.packet_rate.valid)
+                {
+                    data.has_link_stats = true;
+                    data.link_loss_percent = snap.packet_rate.loss_percent;
+                    data.link_fec_percent = snap.packet_rate.fec_percent;
+                }
                 if (snap.has_ground_temp)
                 {
                     data.ground_temp_c = snap.ground_temp_c;
@@ -264,11 +322,51 @@ bool Application::Initialize(const std::string &font_path, bool use_mock,
                 {
                     data.video_refresh_hz = snap.output_fps;
                 }
+                if (snap.video.has_fps || snap.video.has_vdec)
+                {
+                    data.has_video_health = true;
+                    data.video_input_fps = snap.video.input_fps;
+                    data.video_output_fps = snap.video.output_fps;
+                    // fps_info's drop_fps covers display drops when vdec_status is absent.
+                    data.video_drops_per_s = snap.video.has_vdec ? snap.video.dropped_per_s
+                                                                 : static_cast<float>(snap.video.drop_fps);
+                    data.video_errors_per_s = snap.video.errors_per_s;
+                    data.video_buffer_percent = snap.video.has_buffer ? snap.video.buffer_percent : -1.0f;
+                    data.video_display_queue = snap.video.has_display_queue ? snap.video.display_queue : -1;
+                }
                 if (snap.has_hid_batt)
                 {
                     data.has_ground_batt = true;
                     data.ground_batt_percent = snap.hid_batt_percent;
                 }
+                if (snap.system.valid)
+                {
+                    data.has_diagnostics = true;
+                    data.cpu_percent = snap.system.cpu_percent;
+                    data.cpu_core_percent.assign(snap.system.core_percent.begin(),
+                                                 snap.system.core_percent.begin() + snap.system.core_count);
+                    data.mem_total_mb = static_cast<int>(snap.system.mem_total_kb / 1024);
+                    data.mem_available_mb = static_cast<int>(snap.system.mem_available_kb / 1024);
+                    data.self_cpu_percent = snap.system.self_cpu_percent;
+                    data.self_rss_mb = static_cast<float>(snap.system.self_rss_kb) / 1024.0f;
+                    data.top_thread = snap.system.top_thread;
+                    data.top_thread_percent = snap.system.top_thread_percent;
+                    if (cmd_runner_)
+                    {
+                        const auto local = cmd_runner_->Stats(CommandLane::Local);
+                        const auto remote = cmd_runner_->Stats(CommandLane::Remote);
+                        data.local_commands_queued = static_cast<int>(local.queued);
+                        data.local_commands_dropped = local.dropped;
+                        data.remote_commands_queued = static_cast<int>(remote.queued);
+                        data.remote_commands_dropped = remote.dropped;
+                        data.commands_coalesced = cmd_runner_->Coalesced();
+                    }
+                }
+                if (thermal_policy_)
+                {
+                    data.thermal_level = static_cast<int>(thermal_policy_->Level());
+                    data.osd_refresh_hz = thermal_policy_->OsdRefreshHz();
+                }
             }
             else
             {
@@ -287,6 +385,11 @@ bool Application::Initialize(const std::string &font_path, bool use_mock,
         if (terminal_)
             terminal_->toggleVisibility(); }, [this]()
                                                { return terminal_ && terminal_->isTerminalVisible(); });
+    if (telemetry_worker_)
+    {
+        renderer_->SetTelemetrySequence([this]()
+                                        { return telemetry_worker_ ? telemetry_worker_->Sequence() : 0; });
+    }
     InitSplash();
 
     menu_state_->SetOnChangeCallback([this](MenuState::SettingType type)
@@ -299,7 +402,7 @@ bool Application::Initialize(const std::string &font_path, bool use_mock,
         case MenuState::SettingType::Bandwidth:
             SaveConfigValue("bandwidth", std::to_string((menu_state_->BandwidthIndex() == 0) ? 10 :
                                                         (menu_state_->BandwidthIndex() == 1) ? 20 : 40));
-            ApplyBandwidth();
+            ApplyRemoteSetting(type);
             break;
         case MenuState::SettingType::GroundMode: {
             // update ground_res and clean legacy typo
@@ -323,17 +426,17 @@ bool Application::Initialize(const std::string &font_path, bool use_mock,
             break;
         }
         case MenuState::SettingType::SkyMode:
-            ApplySkyMode();
+            ApplyRemoteSetting(type);
             break;
         case MenuState::SettingType::GroundPower:
             SaveConfigValue("driver_txpower_override", std::to_string(menu_state_->PowerLevels()[menu_state_->GroundPowerIndex()]));
             ApplyGroundPower();
             break;
         case MenuState::SettingType::Bitrate:
-            ApplyBitrate();
+            ApplyRemoteSetting(type);
             break;
         case MenuState::SettingType::SkyPower:
-            ApplySkyPower();
+            ApplyRemoteSetting(type);
             break;
         case MenuState::SettingType::Language: {
             auto lang = menu_state_->GetLanguage();
@@ -353,7 +456,7 @@ bool Application::Initialize(const std::string &font_path, bool use_mock,
             auto mode = menu_state_->GetFirmwareType();
             SaveConfigValue("firmware", mode == MenuState::FirmwareType::CCEdition ? "cc" : "official");
             RebuildTransport(mode);
-            RestartRemoteSync();
+            RequestRemoteSync(true);
             break;
         }
         default:
@@ -437,6 +540,18 @@ void Application::Run()
         }
 
         float target_period = 1.0f / kOsdRefreshHz;
+        if (thermal_policy_)
+        {
+            // The telemetry thread moves the level; follow it here so the
+            // renderer is only touched from the render thread.
+            const ThermalLevel level = thermal_policy_->Level();
+            if (level != applied_thermal_level_)
+            {
+                applied_thermal_level_ = level;
+                renderer_->SetRefreshInterval(thermal_policy_->OsdDataInterval());
+            }
+            target_period = 1.0f / thermal_policy_->OsdRefreshHz();
+        }
         auto frame_elapsed = std::chrono::duration<float>(frame_end - loop_begin).count();
         if (frame_elapsed < target_period)
         {
@@ -457,22 +572,15 @@ void Application::Run()
     }
 }
 
-void Application::UpdateCommandRunner(bool menu_visible)
+void Application::OnMenuVisibilityChanged(bool menu_visible)
 {
-    if (!cmd_runner_)
-    {
-        return;
-    }
-    if (menu_visible && !command_runner_active_)
+    // The executor keeps running while the menu is closed; opening the menu
+    // only refreshes a stale view of the sky settings.
+    if (menu_visible && !menu_was_visible_)
     {
-        cmd_runner_->Start();
-        command_runner_active_ = true;
-    }
-    else if (!menu_visible && command_runner_active_)
-    {
-        cmd_runner_->Stop();
-        command_runner_active_ = false;
+        RequestRemoteSync(false);
     }
+    menu_was_visible_ = menu_visible;
 }
 
 std::shared_ptr<CommandTransport> Application::AcquireTransport() const
@@ -490,22 +598,16 @@ void Application::RebuildTransport(MenuState::FirmwareType type)
     }
     else
     {
-        new_transport = std::make_shared<UdpCommandClient>();
+        new_transport = std::make_shared<UdpCommandClient>("127.0.0.1", 14650, 14651, udp_request_ids_);
     }
     {
         std::lock_guard<std::mutex> lock(transport_mutex_);
-        transport_ = std::move(new_transport);
+        transport_.swap(new_transport);
         firmware_mode_ = type;
     }
-}
-
-void Application::RestartRemoteSync()
-{
-    if (remote_sync_thread_.joinable())
-    {
-        remote_sync_thread_.join();
-    }
-    StartRemoteSync();
+    // Queries still running on the old transport can no longer be applied.
+    if (new_transport)
+        new_transport->CancelAll();
 }
 
 void Application::Shutdown()
@@ -525,29 +627,49 @@ void Application::Shutdown()
         mav_receiver_.reset();
     }
     ShutdownSplash();
+    // Abandon the remote sync and the SendAsync queries it has in flight, so
+    // a state query does not hold up the remote lane. CancelAll only reaches
+    // SendAsync; setting jobs use the blocking Send and are not cancelled.
+    {
+        std::lock_guard<std::mutex> lock(remote_state_mutex_);
+        remote_sync_stop_ = true;
+        if (remote_sync_cancel_)
+            remote_sync_cancel_->Cancel();
+    }
+    remote_sync_cv_.notify_one();
+    if (remote_sync_thread_.joinable())
+    {
+        remote_sync_thread_.join();
+    }
+    if (auto transport = AcquireTransport())
+    {
+        transport->CancelAll();
+    }
+    // Runs the setting changes still queued and drops background jobs. Each
+    // setting is a blocking Send bounded by its own timeout, and at most one
+    // is queued per setting key, so an unreachable sky unit delays exit by a
+    // few seconds at most.
     if (cmd_runner_)
     {
         cmd_runner_->Stop();
-        command_runner_active_ = false;
-        cmd_runner_.reset();
     }
     if (terminal_)
     {
         terminal_.reset();
     }
-    if (telemetry_worker_)
-    {
-        telemetry_worker_->Stop();
-        telemetry_worker_.reset();
-    }
+    // The monitor pushes into the worker, so stop it before the worker goes away.
     if (signal_monitor_)
     {
-        signal_monitor_.reset();
+        signal_monitor_->Stop();
     }
-    if (remote_sync_thread_.joinable())
+    if (telemetry_worker_)
     {
-        remote_sync_thread_.join();
+        telemetry_worker_->Stop();
+        telemetry_worker_.reset();
     }
+    signal_monitor_.reset();
+    cmd_runner_.reset();
+    nl80211_.reset();
     {
         std::lock_guard<std::mutex> lock(transport_mutex_);
         transport_.reset();
@@ -580,6 +702,7 @@ void Application::Shutdown()
         libinput_unref(li_ctx_);
         li_ctx_ = nullptr;
     }
+    device_monitor_.reset();
     if (udev_ctx_)
     {
         udev_unref(udev_ctx_);
@@ -592,72 +715,36 @@ void Application::Shutdown()
     }
 }
 
-void Application::ApplyChannel()
+void Application::EnqueueRemoteSetting(const char *setting, const std::shared_ptr<CommandTransport> &transport,
+                                       const std::string &cmd)
 {
-    const auto &chs = menu_state_->Channels();
-    if (chs.empty())
+    if (cmd.empty() || !cmd_runner_)
         return;
-    int ch = chs[menu_state_->ChannelIndex()];
-    if (auto transport = AcquireTransport())
-    {
-        std::unordered_map<std::string, std::string> vars{{"CHANNEL", std::to_string(ch)}};
-        auto cmd = command_templates_.Render("remote", "channel", vars);
-        if (!cmd.empty() && cmd_runner_)
-        {
-            cmd_runner_->EnqueueRemote([transport, cmd]()
-                                       {
-                if (!transport->Send(cmd, false))
-                {
-                    std::fprintf(stderr, "[AMLgsMenu] Failed to send channel command\n");
-                } });
-        }
-    }
-    ApplyLocalMonitorChannel(ch);
+    cmd_runner_->EnqueueRemote([transport, cmd, setting]()
+                               {
+        if (!transport->Send(cmd, false))
+            LOG_WARN("AMLgsMenu", "failed to send %s command", setting); }, setting);
 }
 
-void Application::ApplyBandwidth()
+void Application::ApplyRemoteSetting(MenuState::SettingType type)
 {
-    int bw = (menu_state_->BandwidthIndex() == 0) ? 10 : (menu_state_->BandwidthIndex() == 1 ? 20 : 40);
+    TemplateParams vars;
+    const char *key = RemoteSettingParams(*menu_state_, type, vars);
+    if (!key)
+        return;
     if (auto transport = AcquireTransport())
     {
-        std::unordered_map<std::string, std::string> vars{
-            {"BANDWIDTH", std::to_string(bw)}};
-        auto cmd = command_templates_.Render("remote", "bandwidth", vars);
-        if (!cmd.empty() && cmd_runner_)
-        {
-            cmd_runner_->EnqueueRemote([transport, cmd]()
-                                       {
-                if (!transport->Send(cmd, false))
-                {
-                    std::fprintf(stderr, "[AMLgsMenu] Failed to send bandwidth command\n");
-                } });
-        }
+        EnqueueRemoteSetting(key, transport, command_templates_.Render("remote", key, vars));
     }
 }
 
-void Application::ApplySkyMode()
+void Application::ApplyChannel()
 {
-    const auto &sky_modes = menu_state_->SkyModes();
-    if (sky_modes.empty())
+    const auto &chs = menu_state_->Channels();
+    if (chs.empty())
         return;
-    VideoMode mode = sky_modes[menu_state_->SkyModeIndex()];
-    if (auto transport = AcquireTransport())
-    {
-        std::unordered_map<std::string, std::string> vars{
-            {"WIDTH", std::to_string(mode.width)},
-            {"HEIGHT", std::to_string(mode.height)},
-            {"FPS", std::to_string(mode.refresh ? mode.refresh : 60)}};
-        auto cmd = command_templates_.Render("remote", "sky_mode", vars);
-        if (!cmd.empty() && cmd_runner_)
-        {
-            cmd_runner_->EnqueueRemote([transport, cmd]()
-                                       {
-                if (!transport->Send(cmd, false))
-                {
-                    std::fprintf(stderr, "[AMLgsMenu] Failed to send sky mode command\n");
-                } });
-        }
-    }
+    ApplyRemoteSetting(MenuState::SettingType::Channel);
+    ApplyLocalMonitorChannel(chs[menu_state_->ChannelIndex()]);
 }
 
 void Application::ApplyGroundDisplayMode(const std::string &label)
@@ -675,55 +762,6 @@ void Application::ApplyGroundDisplayMode(const std::string &label)
     }
 }
 
-void Application::ApplyBitrate()
-{
-    const auto &bitrates = menu_state_->Bitrates();
-    if (bitrates.empty())
-        return;
-    int br_mbps = bitrates[menu_state_->BitrateIndex()];
-    int br_kbps = br_mbps * 1024; // CLI expects kbps; e.g. 2 -> 2048
-    if (auto transport = AcquireTransport())
-    {
-        std::unordered_map<std::string, std::string> vars{
-            {"BITRATE_KBPS", std::to_string(br_kbps)}};
-        auto cmd = command_templates_.Render("remote", "bitrate", vars);
-        if (!cmd.empty() && cmd_runner_)
-        {
-            cmd_runner_->EnqueueRemote([transport, cmd]()
-                                       {
-                if (!transport->Send(cmd, false))
-                {
-                    std::fprintf(stderr, "[AMLgsMenu] Failed to send bitrate command\n");
-                } });
-        }
-    }
-}
-
-void Application::ApplySkyPower()
-{
-    const auto &powers = menu_state_->PowerLevels();
-    if (powers.empty())
-        return;
-    int p = powers[menu_state_->SkyPowerIndex()];
-    if (auto transport = AcquireTransport())
-    {
-        int tx_pwr = p * 50;
-        std::unordered_map<std::string, std::string> vars{
-            {"POWER", std::to_string(p)},
-            {"TXPOWER", std::to_string(tx_pwr)}};
-        auto cmd = command_templates_.Render("remote", "sky_power", vars);
-        if (!cmd.empty() && cmd_runner_)
-        {
-            cmd_runner_->EnqueueRemote([transport, cmd]()
-                                       {
-                if (!transport->Send(cmd, false))
-                {
-                    std::fprintf(stderr, "[AMLgsMenu] Failed to send tx power command\n");
-                } });
-        }
-    }
-}
-
 void Application::ApplyGroundPower()
 {
     const auto &powers = menu_state_->PowerLevels();
@@ -743,13 +781,22 @@ void Application::ApplyLocalMonitorChannel(int channel)
         bw_suffix = " HT20";
     else if (bw_mhz == 40)
         bw_suffix = " HT40+";
-    std::unordered_map<std::string, std::string> vars{
-        {"CHANNEL", std::to_string(channel)},
-        {"BW_SUFFIX", bw_suffix}};
+    TemplateParams vars;
+    vars.Set(TemplateVar::Channel, std::to_string(channel)).Set(TemplateVar::BwSuffix, bw_suffix);
     auto cmd = command_templates_.Render("local", "monitor_channel", vars);
-    if (!cmd.empty() && cmd_runner_)
+    if (!cmd_runner_)
+        return;
+    // A customised template is the user's choice and is not second-guessed.
+    if (nl80211_ && command_templates_.IsBuiltIn("local", "monitor_channel"))
+    {
+        Nl80211Client *nl80211 = nl80211_.get();
+        cmd_runner_->EnqueueNative([nl80211, channel, bw_mhz]
+                                   { return nl80211->SetMonitorChannel(channel, bw_mhz); },
+                                   cmd, "monitor_channel");
+    }
+    else if (!cmd.empty())
     {
-        cmd_runner_->EnqueueShell(cmd);
+        cmd_runner_->EnqueueShell(cmd, "monitor_channel");
     }
 }
 
@@ -758,13 +805,21 @@ void Application::ApplyLocalMonitorPower(int power_level)
     if (power_level <= 0)
         return;
     int tx_pwr = power_level * 50;
-    std::unordered_map<std::string, std::string> vars{
-        {"POWER", std::to_string(power_level)},
-        {"TXPOWER", std::to_string(tx_pwr)}};
+    TemplateParams vars;
+    vars.Set(TemplateVar::Power, std::to_string(power_level)).Set(TemplateVar::TxPower, std::to_string(tx_pwr));
     auto cmd = command_templates_.Render("local", "monitor_power", vars);
-    if (!cmd.empty() && cmd_runner_)
+    if (!cmd_runner_)
+        return;
+    if (nl80211_ && command_templates_.IsBuiltIn("local", "monitor_power"))
+    {
+        Nl80211Client *nl80211 = nl80211_.get();
+        cmd_runner_->EnqueueNative([nl80211, tx_pwr]
+                                   { return nl80211->SetMonitorTxPower(tx_pwr); },
+                                   cmd, "monitor_power");
+    }
+    else if (!cmd.empty())
     {
-        cmd_runner_->EnqueueShell(cmd);
+        cmd_runner_->EnqueueShell(cmd, "monitor_power");
     }
 }
 
@@ -897,10 +952,17 @@ void Application::ProcessInput(bool &running)
 {
     if (!li_ctx_)
         return;
-    pollfd pfd{};
-    pfd.fd = libinput_get_fd(li_ctx_);
-    pfd.events = POLLIN;
-    poll(&pfd, 1, 1);
+    pollfd pfds[2]{};
+    pfds[0].fd = libinput_get_fd(li_ctx_);
+    pfds[0].events = POLLIN;
+    pfds[1].fd = device_monitor_ ? device_monitor_->Fd() : -1;
+    pfds[1].events = POLLIN;
+    poll(pfds, 2, 1);
+    if (pfds[1].revents & POLLIN)
+    {
+        device_monitor_->Dispatch([this](const DeviceMonitor::Event &event)
+                                  { HandleDeviceEvent(event); });
+    }
     if (libinput_dispatch(li_ctx_) != 0)
         return;
     libinput_event *event = nullptr;
@@ -910,12 +972,6 @@ void Application::ProcessInput(bool &running)
         libinput_event_destroy(event);
     }
     PollJoysticks(running);
-    auto now = std::chrono::steady_clock::now();
-    if (now - last_js_scan_ > std::chrono::seconds(2))
-    {
-        ScanJoysticks();
-        last_js_scan_ = now;
-    }
 }
 
 void Application::HandleLibinputEvent(struct libinput_event *event, bool &running)
@@ -1046,7 +1102,7 @@ void Application::HandleLibinputEvent(struct libinput_event *event, bool &runnin
         if (button == BTN_RIGHT && pressed)
         {
             menu_state_->ToggleMenuVisibility();
-            UpdateCommandRunner(menu_state_->MenuVisible());
+            OnMenuVisibilityChanged(menu_state_->MenuVisible());
         }
         break;
     }
@@ -1100,12 +1156,12 @@ void Application::HandleLibinputEvent(struct libinput_event *event, bool &runnin
             if (!terminal_visible && (key == KEY_X || key == BTN_WEST))
             {
                 menu_state_->ToggleMenuVisibility();
-                UpdateCommandRunner(menu_state_->MenuVisible());
+                OnMenuVisibilityChanged(menu_state_->MenuVisible());
             }
             if (!terminal_visible && (key == KEY_LEFTALT || key == KEY_RIGHTALT))
             {
                 menu_state_->ToggleMenuVisibility();
-                UpdateCommandRunner(menu_state_->MenuVisible());
+                OnMenuVisibilityChanged(menu_state_->MenuVisible());
             }
             if (key == KEY_ESC)
             {
@@ -1413,42 +1469,63 @@ void Application::HandleLibinputEvent(struct libinput_event *event, bool &runnin
     io.MousePos.y = std::max(0.0f, std::min(io.MousePos.y, static_cast<float>(fb_.height)));
 }
 
-void Application::ScanJoysticks()
+void Application::InitJoysticks()
 {
-    glob_t globbuf{};
-    if (glob("/dev/input/js*", 0, nullptr, &globbuf) != 0)
+    // Gamepads come and go through udev events on the input subsystem; the
+    // initial enumeration picks up the ones already plugged in.
+    device_monitor_ = std::make_unique<DeviceMonitor>(udev_ctx_);
+    if (!device_monitor_->Start({"input"}))
     {
+        LOG_WARN("AMLgsMenu", "udev monitor unavailable, gamepad hotplug disabled");
+    }
+    device_monitor_->Enumerate("input", [this](const DeviceMonitor::Event &event)
+                               { HandleDeviceEvent(event); });
+}
+
+void Application::HandleDeviceEvent(const DeviceMonitor::Event &event)
+{
+    if (event.subsystem != "input" || event.devnode.empty() || event.sysname.rfind("js", 0) != 0)
         return;
+    if (event.action == DeviceMonitor::Action::Add)
+    {
+        OpenJoystick(event.devnode);
     }
-    for (size_t i = 0; i < globbuf.gl_pathc; ++i)
+    else if (event.action == DeviceMonitor::Action::Remove)
     {
-        const std::string path = globbuf.gl_pathv[i];
-        bool exists = std::any_of(joysticks_.begin(), joysticks_.end(),
-                                  [&](const JoystickDevice &dev)
-                                  { return dev.path == path; });
-        if (exists)
-            continue;
+        auto it = std::find_if(joysticks_.begin(), joysticks_.end(),
+                               [&](const JoystickDevice &dev)
+                               { return dev.path == event.devnode; });
+        if (it != joysticks_.end())
+            RemoveJoystick(static_cast<size_t>(it - joysticks_.begin()));
+    }
+}
 
-        int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
-        if (fd < 0)
-            continue;
+void Application::OpenJoystick(const std::string &path)
+{
+    bool exists = std::any_of(joysticks_.begin(), joysticks_.end(),
+                              [&](const JoystickDevice &dev)
+                              { return dev.path == path; });
+    if (exists)
+        return;
 
-        JoystickDevice dev;
-        dev.fd = fd;
-        dev.path = path;
-        unsigned char axes = 0;
-        if (ioctl(fd, JSIOCGAXES, &axes) < 0 || axes == 0)
-            axes = 8;
-        dev.axes.assign(axes, 0);
-        unsigned char buttons = 0;
-        if (ioctl(fd, JSIOCGBUTTONS, &buttons) < 0 || buttons == 0)
-            buttons = 16;
-        dev.buttons.assign(buttons, 0);
-        joysticks_.push_back(std::move(dev));
-        std::fprintf(stdout, "[AMLgsMenu] Gamepad attached: %s\n", path.c_str());
-        std::fflush(stdout);
-    }
-    globfree(&globbuf);
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd < 0)
+        return;
+
+    JoystickDevice dev;
+    dev.fd = fd;
+    dev.path = path;
+    unsigned char axes = 0;
+    if (ioctl(fd, JSIOCGAXES, &axes) < 0 || axes == 0)
+        axes = 8;
+    dev.axes.assign(axes, 0);
+    unsigned char buttons = 0;
+    if (ioctl(fd, JSIOCGBUTTONS, &buttons) < 0 || buttons == 0)
+        buttons = 16;
+    dev.buttons.assign(buttons, 0);
+    joysticks_.push_back(std::move(dev));
+    LOG_INFO("AMLgsMenu", "gamepad attached: %s", path.c_str());
+    std::fflush(stdout);
 }
 
 void Application::CloseJoysticks()
@@ -1487,7 +1564,7 @@ void Application::RemoveJoystick(size_t index)
     {
         close(joysticks_[index].fd);
     }
-    std::fprintf(stdout, "[AMLgsMenu] Gamepad removed: %s\n", joysticks_[index].path.c_str());
+    LOG_INFO("AMLgsMenu", "gamepad removed: %s", joysticks_[index].path.c_str());
     std::fflush(stdout);
     joysticks_.erase(joysticks_.begin() + index);
 }
@@ -1592,7 +1669,7 @@ void Application::HandleJoystickButton(int button, bool pressed)
         if (pressed && !terminal_visible)
         {
             menu_state_->ToggleMenuVisibility();
-            UpdateCommandRunner(menu_state_->MenuVisible());
+            OnMenuVisibilityChanged(menu_state_->MenuVisible());
         }
         break;
     case 3: // Y
@@ -1603,7 +1680,7 @@ void Application::HandleJoystickButton(int button, bool pressed)
         if (pressed && !terminal_visible)
         {
             menu_state_->ToggleMenuVisibility();
-            UpdateCommandRunner(menu_state_->MenuVisible());
+            OnMenuVisibilityChanged(menu_state_->MenuVisible());
         }
         break;
     default:
@@ -1894,6 +1971,46 @@ void Application::LoadConfig()
         else if (v == "cn")
             menu_state_->SetLanguage(MenuState::Language::CN);
     }
+    // thermal_warm_c / thermal_hot_c / thermal_critical_c / thermal_hysteresis_c
+    const auto read_celsius = [this](const char *key, float &value)
+    {
+        auto it = config_kv_.find(key);
+        if (it == config_kv_.end())
+            return;
+        char *end = nullptr;
+        const float parsed = std::strtof(it->second.c_str(), &end);
+        if (end != it->second.c_str())
+            value = parsed;
+        else
+            LOG_WARN("AMLgsMenu", "ignoring %s=%s", key, it->second.c_str());
+    };
+    read_celsius("thermal_warm_c", thermal_config_.warm_c);
+    read_celsius("thermal_hot_c", thermal_config_.hot_c);
+    read_celsius("thermal_critical_c", thermal_config_.critical_c);
+    read_celsius("thermal_hysteresis_c", thermal_config_.hysteresis_c);
+    auto it_diag = config_kv_.find("osd_diagnostics");
+    osd_diagnostics_ = it_diag != config_kv_.end() && (it_diag->second == "1" || it_diag->second == "true");
+    // Quiet time before a changed setting is sent; newer values replace queued ones.
+    auto it_debounce = config_kv_.find("command_debounce_ms");
+    if (it_debounce != config_kv_.end())
+    {
+        char *end = nullptr;
+        const long ms = std::strtol(it_debounce->second.c_str(), &end, 10);
+        if (end != it_debounce->second.c_str() && ms >= 0)
+            command_debounce_ = std::chrono::milliseconds(ms);
+    }
+    // Tag UDP commands with request ids; needs a sky daemon that echoes them.
+    auto it_ids = config_kv_.find("udp_request_ids");
+    udp_request_ids_ = it_ids != config_kv_.end() && (it_ids->second == "1" || it_ids->second == "true");
+    // Retune local monitor interfaces through nl80211 rather than the [local] templates.
+    auto it_nl = config_kv_.find("local_nl80211");
+    local_nl80211_ = it_nl == config_kv_.end() || !(it_nl->second == "0" || it_nl->second == "false");
+    // log_level=<level>[,<module>=<level>...], e.g. "info,Telemetry=debug".
+    auto it_log = config_kv_.find("log_level");
+    if (it_log != config_kv_.end() && !Logger::Shared().Configure(it_log->second))
+    {
+        LOG_WARN("AMLgsMenu", "ignoring unrecognised log_level parts: %s", it_log->second.c_str());
+    }
     auto it_fw = config_kv_.find("firmware");
     if (it_fw != config_kv_.end())
     {
@@ -1911,26 +2028,114 @@ void Application::LoadConfig()
     }
 }
 
+std::unique_ptr<SignalMonitor> Application::CreateSignalMonitor() const
+{
+    // signal_source=journal (default) scrapes the wifibroadcast journal;
+    // signal_source=wfb_api subscribes to the wfb-ng stats API instead.
+    auto value_of = [this](const char *key, const std::string &fallback) {
+        auto it = config_kv_.find(key);
+        return it != config_kv_.end() && !it->second.empty() ? it->second : fallback;
+    };
+    std::string source = value_of("signal_source", "journal");
+    for (auto &c : source)
+        c = static_cast<char>(tolower(c));
+    if (source != "wfb_api")
+    {
+        return std::make_unique<SignalMonitor>();
+    }
+    const std::string host = value_of("wfb_api_host", "127.0.0.1");
+    const std::string port_text = value_of("wfb_api_port", "8003");
+    int port = 0;
+    try
+    {
+        port = std::stoi(port_text);
+    }
+    catch (const std::exception &)
+    {
+        port = 0;
+    }
+    if (port < 1 || port > 65535)
+    {
+        LOG_WARN("AMLgsMenu", "ignoring wfb_api_port=%s", port_text.c_str());
+        port = 8003;
+    }
+    LOG_INFO("AMLgsMenu", "ground signal source: wfb-ng stats API %s:%d", host.c_str(), port);
+    return std::make_unique<SignalMonitor>(SignalMonitor::Source::WfbApi, host, static_cast<uint16_t>(port));
+}
+
 void Application::StartRemoteSync()
 {
-    if (remote_sync_thread_.joinable())
+    if (!remote_sync_thread_.joinable())
     {
-        return;
+        remote_sync_thread_ = std::thread(&Application::RemoteSyncLoop, this);
     }
-    auto transport = AcquireTransport();
-    if (!transport)
+    RequestRemoteSync(true);
+}
+
+void Application::RequestRemoteSync(bool force)
+{
+    std::lock_guard<std::mutex> lock(remote_state_mutex_);
+    if (!force && (remote_sync_busy_ || (remote_state_cached_ &&
+                                         std::chrono::steady_clock::now() - remote_state_time_ < kRemoteStateTtl)))
     {
         return;
     }
-    remote_sync_thread_ = std::thread([this, transport]()
-                                      {
+    ++remote_sync_generation_;
+    // Whatever the worker is collecting now has been superseded.
+    if (remote_sync_cancel_)
+    {
+        remote_sync_cancel_->Cancel();
+    }
+    remote_sync_cv_.notify_one();
+}
+
+void Application::RemoteSyncLoop()
+{
+    pthread_setname_np(pthread_self(), "remote-sync");
+    uint64_t served = 0;
+    std::unique_lock<std::mutex> lock(remote_state_mutex_);
+    while (true)
+    {
+        remote_sync_cv_.wait(lock, [&]()
+                             { return remote_sync_stop_ || remote_sync_generation_ != served; });
+        if (remote_sync_stop_)
+        {
+            break;
+        }
+        const uint64_t generation = remote_sync_generation_;
+        served = generation;
+        remote_sync_cancel_ = std::make_shared<CommandCancelToken>();
+        remote_sync_busy_ = true;
+        lock.unlock();
+
+        // The transport is picked per request so a firmware switch takes effect.
         RemoteStateSnapshot snapshot{};
-        if (CollectRemoteState(snapshot, transport))
+        bool collected = false;
+        const auto started = std::chrono::steady_clock::now();
+        if (auto transport = AcquireTransport())
+        {
+            collected = CollectRemoteState(snapshot, transport);
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+
+        lock.lock();
+        remote_sync_busy_ = false;
+        if (generation != remote_sync_generation_)
+        {
+            LOG_DEBUG("AMLgsMenu", "dropping superseded remote state sync after %lld ms",
+                      static_cast<long long>(elapsed.count()));
+            continue;
+        }
+        LOG_INFO("AMLgsMenu", "remote state sync %s in %lld ms", collected ? "done" : "failed",
+                 static_cast<long long>(elapsed.count()));
+        if (collected)
         {
-            std::lock_guard<std::mutex> lock(remote_state_mutex_);
             pending_remote_state_ = snapshot;
             remote_sync_ready_ = true;
-        } });
+            remote_state_cached_ = true;
+            remote_state_time_ = std::chrono::steady_clock::now();
+        }
+    }
 }
 
 void Application::DrainRemoteState()
@@ -1972,9 +2177,23 @@ bool Application::CollectRemoteState(RemoteStateSnapshot &snapshot,
         }
     };
 
+    std::unordered_map<std::string, std::string> values;
+    if (!QueryRemoteValues(values, transport))
+    {
+        return false;
+    }
+    auto lookup = [&values](const char *key, std::string &out) -> bool
+    {
+        auto it = values.find(key);
+        if (it == values.end())
+            return false;
+        out = it->second;
+        return true;
+    };
+
     bool any = false;
     std::string value;
-    if (QueryRemoteValue("channel", value, transport))
+    if (lookup("channel", value))
     {
         int ch = 0;
         if (try_parse_int(value, ch))
@@ -1984,7 +2203,7 @@ bool Application::CollectRemoteState(RemoteStateSnapshot &snapshot,
             any = true;
         }
     }
-    if (QueryRemoteValue("bandwidth", value, transport))
+    if (lookup("bandwidth", value))
     {
         int bw = 0;
         if (try_parse_int(value, bw))
@@ -1994,7 +2213,7 @@ bool Application::CollectRemoteState(RemoteStateSnapshot &snapshot,
             any = true;
         }
     }
-    if (QueryRemoteValue("sky_power", value, transport))
+    if (lookup("sky_power", value))
     {
         int p = 0;
         if (try_parse_int(value, p))
@@ -2004,7 +2223,7 @@ bool Application::CollectRemoteState(RemoteStateSnapshot &snapshot,
             any = true;
         }
     }
-    if (QueryRemoteValue("bitrate", value, transport))
+    if (lookup("bitrate", value))
     {
         int kbps = 0;
         if (try_parse_int(value, kbps))
@@ -2016,8 +2235,8 @@ bool Application::CollectRemoteState(RemoteStateSnapshot &snapshot,
     }
     std::string size_value;
     std::string fps_value;
-    bool have_size = QueryRemoteValue("sky_size", size_value, transport);
-    bool have_fps = QueryRemoteValue("sky_fps", fps_value, transport);
+    bool have_size = lookup("sky_size", size_value);
+    bool have_fps = lookup("sky_fps", fps_value);
     if (have_size && have_fps)
     {
         int width = 0;
@@ -2102,24 +2321,87 @@ void Application::ApplyRemoteStateSnapshot(const RemoteStateSnapshot &snapshot)
     }
 }
 
+CommandResult Application::RunRemoteQuery(const std::shared_ptr<CommandTransport> &transport,
+                                         const std::string &cmd, int timeout_ms)
+{
+    // Asynchronous so superseded syncs and transport switches can cancel it
+    // instead of waiting out the timeout. Started from background work on the
+    // remote lane so setting changes queued before it go out first; the lane
+    // only starts the query and this thread waits for the reply, so settings
+    // queued meanwhile are not held up. The timeout starts once the query is
+    // started.
+    auto cancel = remote_sync_cancel_;
+    auto start = [transport, cmd, timeout_ms, cancel]()
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        return transport->SendAsync(cmd, deadline, cancel);
+    };
+    if (!cmd_runner_)
+        return start().get();
+    auto started = std::make_shared<std::promise<std::future<CommandResult>>>();
+    auto reply = started->get_future();
+    cmd_runner_->EnqueueRemote([started, start]()
+                               { started->set_value(start()); }, {}, CommandPriority::Background, [started]()
+                               {
+                                   std::promise<CommandResult> dropped;
+                                   dropped.set_value(CommandResult{});
+                                   started->set_value(dropped.get_future());
+                               });
+    // The lane may be busy with a slow setting; do not hold up a cancel.
+    while (reply.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready)
+    {
+        if (cancel && cancel->IsCancelled())
+            return CommandResult{CommandStatus::Cancelled, {}};
+    }
+    return reply.get().get();
+}
+
+bool Application::QueryRemoteValues(std::unordered_map<std::string, std::string> &values,
+                                    const std::shared_ptr<CommandTransport> &transport)
+{
+    if (!transport)
+        return false;
+    // All [remote_query] templates in one round trip; per-key queries are
+    // only the fallback for a batch that failed or was cut short.
+    const auto script = command_templates_.RenderBatch("remote_query");
+    if (script.empty())
+        return false;
+    CommandResult batch = RunRemoteQuery(transport, script, 2000);
+    if (batch.status == CommandStatus::Cancelled)
+        return false;
+    // A batch cut short by a timeout still yields the values printed before it;
+    // only the missing keys are queried again.
+    if (CommandAccepted(batch.status) && CommandTemplates::ParseBatchReply(batch.response, values) &&
+        batch.status == CommandStatus::Ok)
+        return !values.empty();
+    LOG_WARN("AMLgsMenu", "batched remote query failed (%zu values), querying keys one by one", values.size());
+    for (const auto &key : command_templates_.Keys("remote_query"))
+    {
+        if (remote_sync_cancel_ && remote_sync_cancel_->IsCancelled())
+            break;
+        std::string value;
+        if (values.find(key) == values.end() && QueryRemoteValue(key, value, transport))
+            values[key] = value;
+    }
+    return !values.empty();
+}
+
 bool Application::QueryRemoteValue(const std::string &key, std::string &out,
                                    const std::shared_ptr<CommandTransport> &transport)
 {
     if (!transport)
         return false;
-    auto cmd = command_templates_.Render("remote_query", key, {});
+    auto cmd = command_templates_.Render("remote_query", key);
     if (cmd.empty())
         return false;
-    std::vector<std::string> response;
-    if (!transport->SendWithReply(cmd, response, 1000))
+    CommandResult result = RunRemoteQuery(transport, cmd, 1000);
+    if (result.status != CommandStatus::Ok)
         return false;
-    for (const auto &line : response)
+    for (const auto &line : result.response)
     {
         auto trimmed = TrimCopy(line);
         if (trimmed.empty())
             continue;
-        if (trimmed == "timeout")
-            continue;
         out = trimmed;
         return true;
     }
@@ -6,8 +6,11 @@
 #include "command_transport.h"
 #include "command_templates.h"
 #include "command_executor.h"
+#include "nl80211_client.h"
 #include "terminal.h"
 #include "telemetry_worker.h"
+#include "thermal_policy.h"
+#include "device_monitor.h"
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -24,6 +27,7 @@
 #include <functional>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
 
 struct JoystickDevice
@@ -85,7 +89,9 @@ private:
     void ProcessInput(bool &running);
     void HandleLibinputEvent(struct libinput_event *event, bool &running);
     void PollJoysticks(bool &running);
-    void ScanJoysticks();
+    void InitJoysticks();
+    void OpenJoystick(const std::string &path);
+    void HandleDeviceEvent(const DeviceMonitor::Event &event);
     void CloseJoysticks();
     void RemoveJoystick(size_t index);
     void HandleJoystickButton(int button, bool pressed);
@@ -102,6 +108,7 @@ public:
 
 private:
     void LoadConfig();
+    std::unique_ptr<SignalMonitor> CreateSignalMonitor() const;
     void SaveConfigValue(const std::string &key, const std::string &value);
     int FindChannelIndex(int channel_val) const;
     int FindPowerIndex(int power_val) const;
@@ -115,22 +122,31 @@ private:
                             const std::shared_ptr<CommandTransport> &transport);
     bool QueryRemoteValue(const std::string &key, std::string &out,
                           const std::shared_ptr<CommandTransport> &transport);
+    CommandResult RunRemoteQuery(const std::shared_ptr<CommandTransport> &transport, const std::string &cmd,
+                                 int timeout_ms);
+    bool QueryRemoteValues(std::unordered_map<std::string, std::string> &values,
+                           const std::shared_ptr<CommandTransport> &transport);
     void ApplyLanguageToImGui(MenuState::Language lang);
+    void EnqueueRemoteSetting(const char *setting, const std::shared_ptr<CommandTransport> &transport,
+                              const std::string &cmd);
+    // Renders the [remote] template for a sky setting from the menu state and
+    // queues it on the remote lane.
+    void ApplyRemoteSetting(MenuState::SettingType type);
     void ApplyChannel();
-    void ApplyBandwidth();
-    void ApplySkyMode();
     void ApplyGroundDisplayMode(const std::string &label);
-    void ApplyBitrate();
-    void ApplySkyPower();
     void ApplyGroundPower();
     void ApplyLocalMonitorChannel(int channel);
     void ApplyLocalMonitorPower(int power_level);
     bool SendRecordingCommand(bool enable);
     void RebuildTransport(MenuState::FirmwareType type);
     std::shared_ptr<CommandTransport> AcquireTransport() const;
-    void RestartRemoteSync();
+    // Asks the remote sync worker for a fresh snapshot without blocking.
+    // Unless force is set, a snapshot younger than kRemoteStateTtl or a sync
+    // already in progress satisfies the request.
+    void RequestRemoteSync(bool force);
+    void RemoteSyncLoop();
     std::string command_cfg_path_ = "/flash/command.cfg";
-    void UpdateCommandRunner(bool menu_visible);
+    void OnMenuVisibilityChanged(bool menu_visible);
 
     FbContext fb_{};
     EGLDisplay egl_display_ = EGL_NO_DISPLAY;
@@ -139,6 +155,7 @@ private:
     EGLConfig egl_config_ = nullptr;
     struct libinput *li_ctx_ = nullptr;
     struct udev *udev_ctx_ = nullptr;
+    std::unique_ptr<DeviceMonitor> device_monitor_;
     bool running_ = false;
     bool initialized_ = false;
     std::chrono::steady_clock::time_point last_frame_time_{};
@@ -147,12 +164,18 @@ private:
     std::unique_ptr<MenuRenderer> renderer_;
     std::unique_ptr<class MavlinkReceiver> mav_receiver_;
     CommandTemplates command_templates_;
+    // Used only from the executor's local lane; null when nl80211 is
+    // unavailable or disabled, in which case the [local] templates run.
+    std::unique_ptr<Nl80211Client> nl80211_;
     std::unique_ptr<CommandExecutor> cmd_runner_;
     std::unique_ptr<SignalMonitor> signal_monitor_;
     std::unique_ptr<TelemetryWorker> telemetry_worker_;
+    std::unique_ptr<ThermalPolicy> thermal_policy_;
+    ThermalConfig thermal_config_{};
+    ThermalLevel applied_thermal_level_ = ThermalLevel::Normal;
     std::vector<JoystickDevice> joysticks_;
     bool use_mock_ = false;
-    bool command_runner_active_ = false;
+    bool menu_was_visible_ = false;
     std::unique_ptr<Terminal> terminal_;
     ImFont *ui_font_ = nullptr;
     ImFont *terminal_font_ = nullptr;
@@ -171,9 +194,23 @@ private:
 
     std::unordered_map<std::string, std::string> config_kv_;
     std::string config_path_ = "/flash/wfb.conf";
+    bool osd_diagnostics_ = false;
+    bool udp_request_ids_ = false;
+    bool local_nl80211_ = true;
+    std::chrono::milliseconds command_debounce_{150};
+    // Persistent remote sync worker. Requests bump remote_sync_generation_;
+    // results of a superseded generation are dropped. Everything below is
+    // guarded by remote_state_mutex_.
     std::thread remote_sync_thread_;
     std::mutex remote_state_mutex_;
+    std::condition_variable remote_sync_cv_;
+    uint64_t remote_sync_generation_ = 0;
+    bool remote_sync_busy_ = false;
+    bool remote_sync_stop_ = false;
+    // Cancels the queries of the running sync; replaced by the worker only.
+    std::shared_ptr<CommandCancelToken> remote_sync_cancel_;
     RemoteStateSnapshot pending_remote_state_{};
     bool remote_sync_ready_ = false;
-    std::chrono::steady_clock::time_point last_js_scan_{};
+    bool remote_state_cached_ = false;
+    std::chrono::steady_clock::time_point remote_state_time_{};
 };
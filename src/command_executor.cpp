@@ -1,8 +1,28 @@
 #include "command_executor.h"
 
-#include <cstdio>
-#include <cstdlib>
+#include "logger.h"
+#include "process_runner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <pthread.h>
 #include <sys/resource.h>
+#include <vector>
+
+namespace
+{
+size_t PriorityIndex(CommandPriority priority)
+{
+    return priority == CommandPriority::User ? 0 : 1;
+}
+} // namespace
+
+CommandExecutor::CommandExecutor(size_t lane_capacity)
+    : lane_capacity_(std::max<size_t>(1, lane_capacity))
+{
+    lanes_[static_cast<size_t>(CommandLane::Local)].name = "cmd-local";
+    lanes_[static_cast<size_t>(CommandLane::Remote)].name = "cmd-remote";
+}
 
 CommandExecutor::~CommandExecutor()
 {
@@ -11,82 +31,233 @@ CommandExecutor::~CommandExecutor()
 
 void CommandExecutor::Start()
 {
+    std::lock_guard<std::mutex> lock(mtx_);
     if (running_)
         return;
     stop_ = false;
     running_ = true;
-    worker_ = std::thread(&CommandExecutor::ThreadFunc, this);
+    for (Lane &lane : lanes_)
+        lane.worker = std::thread(&CommandExecutor::ThreadFunc, this, std::ref(lane));
 }
 
 void CommandExecutor::Stop()
 {
     {
         std::lock_guard<std::mutex> lock(mtx_);
+        if (!running_)
+            return;
         stop_ = true;
     }
-    cv_.notify_one();
-    if (worker_.joinable())
+    cv_.notify_all();
+    for (Lane &lane : lanes_)
     {
-        worker_.join();
+        if (lane.worker.joinable())
+            lane.worker.join();
     }
+    std::lock_guard<std::mutex> lock(mtx_);
     running_ = false;
+    for (const Lane &lane : lanes_)
+    {
+        LOG_INFO("CommandExecutor", "%s: %llu executed, %llu coalesced, %llu dropped", lane.name,
+                 static_cast<unsigned long long>(lane.stats.executed),
+                 static_cast<unsigned long long>(lane.stats.coalesced),
+                 static_cast<unsigned long long>(lane.stats.dropped));
+    }
 }
 
-void CommandExecutor::EnqueueShell(const std::string &cmd)
+void CommandExecutor::EnqueueShell(const std::string &cmd, const std::string &key, std::chrono::milliseconds timeout)
 {
-    if (!running_)
-    {
-        std::fprintf(stderr, "[CommandExecutor] cannot enqueue command, executor not running\n");
-        return;
-    }
-    {
-        std::lock_guard<std::mutex> lock(mtx_);
-        queue_.push(CommandJob{CommandJob::Kind::Shell, cmd, {}});
-    }
-    cv_.notify_one();
+    CommandJob job;
+    job.kind = CommandJob::Kind::Shell;
+    job.shell_cmd = cmd;
+    job.timeout = timeout;
+    job.key = key;
+    Enqueue(CommandLane::Local, std::move(job));
 }
 
-void CommandExecutor::EnqueueRemote(std::function<void()> job)
+void CommandExecutor::EnqueueNative(std::function<bool()> native, const std::string &cmd, const std::string &key)
 {
-    if (!running_ || !job)
+    CommandJob job;
+    job.kind = CommandJob::Kind::Shell;
+    job.native = std::move(native);
+    job.shell_cmd = cmd;
+    job.key = key;
+    Enqueue(CommandLane::Local, std::move(job));
+}
+
+void CommandExecutor::EnqueueRemote(std::function<void()> job, const std::string &key, CommandPriority priority,
+                                    std::function<void()> on_drop)
+{
+    if (!job)
         return;
+    CommandJob remote;
+    remote.kind = CommandJob::Kind::Remote;
+    remote.remote_job = std::move(job);
+    remote.key = key;
+    remote.priority = priority;
+    remote.on_drop = std::move(on_drop);
+    Enqueue(CommandLane::Remote, std::move(remote));
+}
+
+void CommandExecutor::SetDebounce(std::chrono::milliseconds debounce)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    debounce_ = std::max(debounce, std::chrono::milliseconds(0));
+}
+
+uint64_t CommandExecutor::Coalesced() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return lanes_[0].stats.coalesced + lanes_[1].stats.coalesced;
+}
+
+CommandExecutor::LaneStats CommandExecutor::Stats(CommandLane lane) const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    LaneStats stats = lanes_[static_cast<size_t>(lane)].stats;
+    stats.queued = QueuedJobs(lanes_[static_cast<size_t>(lane)]);
+    return stats;
+}
+
+size_t CommandExecutor::QueuedJobs(const Lane &lane)
+{
+    return lane.queues[0].size() + lane.queues[1].size();
+}
+
+void CommandExecutor::Enqueue(CommandLane lane_id, CommandJob job)
+{
+    std::vector<std::function<void()>> dropped;
     {
         std::lock_guard<std::mutex> lock(mtx_);
-        queue_.push(CommandJob{CommandJob::Kind::Remote, {}, std::move(job)});
+        Lane &lane = lanes_[static_cast<size_t>(lane_id)];
+        if (!running_ || stop_)
+        {
+            LOG_WARN("CommandExecutor", "%s: executor not running, dropping job", lane.name);
+            ++lane.stats.dropped;
+            if (job.on_drop)
+                dropped.push_back(std::move(job.on_drop));
+        }
+        else
+        {
+            std::deque<CommandJob> &queue = lane.queues[PriorityIndex(job.priority)];
+            if (!job.key.empty())
+            {
+                job.ready_at = std::chrono::steady_clock::now() + debounce_;
+                auto stale = std::find_if(queue.begin(), queue.end(),
+                                          [&job](const CommandJob &queued) { return queued.key == job.key; });
+                if (stale != queue.end())
+                {
+                    queue.erase(stale);
+                    ++lane.stats.coalesced;
+                    LOG_DEBUG("CommandExecutor", "coalesced superseded %s command (%llu so far)", job.key.c_str(),
+                              static_cast<unsigned long long>(lane.stats.coalesced));
+                }
+            }
+            if (QueuedJobs(lane) >= lane_capacity_)
+            {
+                std::deque<CommandJob> &victims = lane.queues[1].empty() ? lane.queues[0] : lane.queues[1];
+                if (victims.front().on_drop)
+                    dropped.push_back(std::move(victims.front().on_drop));
+                victims.pop_front();
+                ++lane.stats.dropped;
+                LOG_EVERY_MS(LogLevel::Warn, "CommandExecutor", 5000, "%s: queue full, %llu jobs dropped so far",
+                             lane.name, static_cast<unsigned long long>(lane.stats.dropped));
+            }
+            queue.push_back(std::move(job));
+        }
     }
-    cv_.notify_one();
+    cv_.notify_all();
+    for (auto &on_drop : dropped)
+        on_drop();
 }
 
-void CommandExecutor::ThreadFunc()
+void CommandExecutor::ThreadFunc(Lane &lane)
 {
+    pthread_setname_np(pthread_self(), lane.name);
 #ifdef __linux__
     setpriority(PRIO_PROCESS, 0, 5);
 #endif
     while (true)
     {
         CommandJob job;
+        std::vector<std::function<void()>> dropped;
         {
             std::unique_lock<std::mutex> lock(mtx_);
             cv_.wait(lock, [&]
-                     { return stop_ || !queue_.empty(); });
-            if (stop_ && queue_.empty())
+                     { return stop_ || QueuedJobs(lane) > 0; });
+            if (stop_)
+            {
+                // Background work is not worth delaying shutdown for.
+                for (CommandJob &background : lane.queues[1])
+                {
+                    if (background.on_drop)
+                        dropped.push_back(std::move(background.on_drop));
+                }
+                lane.stats.dropped += lane.queues[1].size();
+                lane.queues[1].clear();
+            }
+            std::deque<CommandJob> &queue = lane.queues[0].empty() ? lane.queues[1] : lane.queues[0];
+            if (queue.empty())
+            {
+                lock.unlock();
+                for (auto &on_drop : dropped)
+                    on_drop();
                 break;
-            job = std::move(queue_.front());
-            queue_.pop();
-        }
-        if (job.kind == CommandJob::Kind::Shell)
-        {
-            std::fprintf(stdout, "[AMLgsMenu] exec: %s\n", job.shell_cmd.c_str());
-            std::fflush(stdout);
-            int rc = std::system(job.shell_cmd.c_str());
-            if (rc != 0)
+            }
+            // Later jobs wait behind a debouncing one to keep submission
+            // order. On stop the remaining user jobs run right away.
+            if (!stop_ && queue.front().ready_at > std::chrono::steady_clock::now())
             {
-                std::fprintf(stderr, "[AMLgsMenu] Command failed (rc=%d): %s\n", rc, job.shell_cmd.c_str());
+                cv_.wait_until(lock, queue.front().ready_at);
+                continue;
             }
+            job = std::move(queue.front());
+            queue.pop_front();
+            ++lane.stats.executed;
+        }
+        for (auto &on_drop : dropped)
+            on_drop();
+        RunJob(job);
+    }
+}
+
+void CommandExecutor::RunJob(CommandJob &job)
+{
+    if (job.kind == CommandJob::Kind::Shell)
+    {
+        if (job.native && job.native())
+            return;
+        if (job.shell_cmd.empty())
+            return;
+        LOG_DEBUG("CommandExecutor", "exec: %s", job.shell_cmd.c_str());
+        const ProcessResult result = RunShellCommand(job.shell_cmd, job.timeout);
+        if (result.Succeeded())
+        {
+            LOG_DEBUG("CommandExecutor", "done in %lld ms: %s", static_cast<long long>(result.duration.count()),
+                      job.shell_cmd.c_str());
+        }
+        else if (!result.started)
+        {
+            LOG_WARN("CommandExecutor", "could not start: %s", job.shell_cmd.c_str());
+        }
+        else if (result.wait_error != 0)
+        {
+            LOG_WARN("CommandExecutor", "exit status lost (%s): %s", std::strerror(result.wait_error),
+                     job.shell_cmd.c_str());
+        }
+        else if (result.timed_out)
+        {
+            LOG_WARN("CommandExecutor", "killed after %lld ms timeout: %s", static_cast<long long>(job.timeout.count()),
+                     job.shell_cmd.c_str());
         }
         else
         {
-            job.remote_job();
+            LOG_WARN("CommandExecutor", "command failed (exit=%d signal=%d): %s: %s", result.exit_code, result.signal,
+                     job.shell_cmd.c_str(), result.output.c_str());
         }
     }
+    else
+    {
+        job.remote_job();
+    }
 }
@@ -1,36 +1,93 @@
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <thread>
 
+enum class CommandLane { Local, Remote };
+enum class CommandPriority { User, Background };
+
+// Runs local shell commands and remote transport jobs on one worker thread
+// per lane, so a slow sky link never holds up local iw commands. It lives for
+// the whole session; Stop() is only meant for shutdown.
 class CommandExecutor {
 public:
-    CommandExecutor() = default;
+    static constexpr size_t kDefaultLaneCapacity = 32;
+    static constexpr std::chrono::milliseconds kDefaultShellTimeout{5000};
+
+    struct LaneStats {
+        size_t queued = 0;
+        uint64_t executed = 0;
+        // Jobs replaced by a newer one with the same key.
+        uint64_t coalesced = 0;
+        // Jobs discarded because the lane was full or the executor stopped.
+        uint64_t dropped = 0;
+    };
+
+    explicit CommandExecutor(size_t lane_capacity = kDefaultLaneCapacity);
     ~CommandExecutor();
 
     void Start();
+    // Runs the user jobs still queued, drops background ones and joins.
     void Stop();
-    void EnqueueShell(const std::string &cmd);
-    void EnqueueRemote(std::function<void()> job);
+    // Within a lane, user jobs run before background ones and each priority
+    // runs in submission order. A job with a non-empty key replaces a
+    // still-queued job with the same key, moving to the back of its queue,
+    // and only starts once the key has been quiet for the debounce interval.
+    // Scrolling through a combo thus sends just the final value.
+    // A full lane makes room by dropping its oldest background job, else its
+    // oldest job; on_drop runs in place of a dropped job.
+    // Shell commands that outlive timeout are killed along with their children.
+    void EnqueueShell(const std::string &cmd, const std::string &key = {},
+                      std::chrono::milliseconds timeout = kDefaultShellTimeout);
+    // Runs native on the local lane and falls back to cmd as a shell command
+    // when it returns false.
+    void EnqueueNative(std::function<bool()> native, const std::string &cmd, const std::string &key = {});
+    void EnqueueRemote(std::function<void()> job, const std::string &key = {},
+                       CommandPriority priority = CommandPriority::User, std::function<void()> on_drop = nullptr);
+    void SetDebounce(std::chrono::milliseconds debounce);
+    // Coalesced jobs over both lanes.
+    uint64_t Coalesced() const;
+    LaneStats Stats(CommandLane lane) const;
 
 private:
     struct CommandJob {
         enum class Kind { Shell, Remote };
         Kind kind = Kind::Shell;
         std::string shell_cmd;
+        std::chrono::milliseconds timeout = kDefaultShellTimeout;
+        std::function<bool()> native;
         std::function<void()> remote_job;
+        std::string key;
+        CommandPriority priority = CommandPriority::User;
+        std::function<void()> on_drop;
+        std::chrono::steady_clock::time_point ready_at{};
+    };
+
+    struct Lane {
+        const char *name = "";
+        std::thread worker;
+        // Indexed by CommandPriority.
+        std::deque<CommandJob> queues[2];
+        LaneStats stats;
     };
 
-    void ThreadFunc();
+    void Enqueue(CommandLane lane, CommandJob job);
+    void ThreadFunc(Lane &lane);
+    void RunJob(CommandJob &job);
+    static size_t QueuedJobs(const Lane &lane);
 
-    std::thread worker_;
-    std::mutex mtx_;
+    mutable std::mutex mtx_;
     std::condition_variable cv_;
-    std::queue<CommandJob> queue_;
+    Lane lanes_[2];
+    size_t lane_capacity_;
+    std::chrono::milliseconds debounce_{150};
     bool running_ = false;
     bool stop_ = false;
 };
@@ -1,7 +1,12 @@
 #include "command_templates.h"
 
+#include "logger.h"
+
+#include <algorithm>
+#include <cctype>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 namespace {
 std::string Trim(const std::string &s) {
@@ -10,10 +15,76 @@ std::string Trim(const std::string &s) {
     auto e = s.find_last_not_of(" \t\r\n");
     return s.substr(b, e - b + 1);
 }
+
+constexpr char kBatchMarker[] = "@@";
+constexpr char kBatchEnd[] = "end";
+
+constexpr std::array<const char *, static_cast<size_t>(TemplateVar::Count)> kVarNames = {
+    "CHANNEL", "BANDWIDTH", "WIDTH", "HEIGHT", "FPS", "BITRATE_KBPS", "POWER", "TXPOWER", "BW_SUFFIX"};
+
+constexpr uint32_t Bit(TemplateVar var) {
+    return 1u << static_cast<unsigned>(var);
+}
+
+// Placeholders the application supplies for each template it renders.
+// Templates not listed here are rendered without parameters.
+struct TemplateSpec {
+    const char *section;
+    const char *key;
+    uint32_t vars;
+};
+constexpr TemplateSpec kSpecs[] = {
+    {"remote", "channel", Bit(TemplateVar::Channel)},
+    {"remote", "bandwidth", Bit(TemplateVar::Bandwidth)},
+    {"remote", "sky_mode", Bit(TemplateVar::Width) | Bit(TemplateVar::Height) | Bit(TemplateVar::Fps)},
+    {"remote", "bitrate", Bit(TemplateVar::BitrateKbps)},
+    {"remote", "sky_power", Bit(TemplateVar::Power) | Bit(TemplateVar::TxPower)},
+    {"local", "monitor_channel", Bit(TemplateVar::Channel) | Bit(TemplateVar::BwSuffix)},
+    {"local", "monitor_power", Bit(TemplateVar::Power) | Bit(TemplateVar::TxPower)},
+};
+
+// [local] texts shipped in earlier command.cfg files. Boxes that kept one
+// have not customised the key, so it still counts as built-in.
+struct ShippedTemplate {
+    const char *section;
+    const char *key;
+    const char *text;
+};
+constexpr ShippedTemplate kPreviouslyShipped[] = {
+    {"local", "monitor_channel",
+     "sh -c 'for dev in $(iw dev 2>/dev/null | awk '\\''/Interface/ {iface=$2} /type[[:space:]]+monitor/ {print iface}'\\''); "
+     "do iw dev $dev set channel ${CHANNEL} ${BW_SUFFIX}; done'"},
+    {"local", "monitor_power",
+     "sh -c 'for dev in $(iw dev 2>/dev/null | awk '\\''/Interface/ {iface=$2} /type[[:space:]]+monitor/ {print iface}'\\''); "
+     "do iw dev $dev set txpower fixed $(( ${POWER} * 50 )); done'"},
+};
+
+uint32_t SuppliedVars(const std::string &section, const std::string &key) {
+    for (const auto &spec : kSpecs) {
+        if (section == spec.section && key == spec.key) return spec.vars;
+    }
+    return 0;
+}
+
+int FindVar(const std::string &name) {
+    for (size_t i = 0; i < kVarNames.size(); ++i) {
+        if (name == kVarNames[i]) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// Only ${UPPER_CASE} names are placeholders; ${dev} or ${1:-x} belong to the shell.
+bool IsPlaceholderName(const std::string &name) {
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) return false;
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return std::isupper(static_cast<unsigned char>(c)) || std::isdigit(static_cast<unsigned char>(c)) || c == '_';
+    });
+}
 } // namespace
 
 CommandTemplates::CommandTemplates() {
     InitDefaults();
+    Compile();
 }
 
 bool CommandTemplates::LoadFromFile(const std::string &path) {
@@ -38,36 +109,146 @@ bool CommandTemplates::LoadFromFile(const std::string &path) {
         if (section.empty()) continue;
         commands_[section][key] = value;
     }
+    Compile();
     return true;
 }
 
+void CommandTemplates::Compile() {
+    templates_.clear();
+    for (const auto &[section, entries] : commands_) {
+        for (const auto &[key, templ] : entries) templates_[section][key] = CompileOne(section, key, templ);
+    }
+    for (const auto &[section, entries] : defaults_) {
+        Section &compiled = templates_[section];
+        for (const auto &[key, templ] : entries) {
+            if (compiled.find(key) == compiled.end()) compiled[key] = CompileOne(section, key, templ);
+        }
+    }
+}
+
+CommandTemplates::CompiledTemplate CommandTemplates::CompileOne(const std::string &section, const std::string &key,
+                                                                const std::string &templ) {
+    CompiledTemplate compiled;
+    const uint32_t supplied = SuppliedVars(section, key);
+    std::string literal;
+    size_t pos = 0;
+    while (pos < templ.size()) {
+        const size_t open = templ.find("${", pos);
+        const size_t close = open == std::string::npos ? std::string::npos : templ.find('}', open + 2);
+        if (close == std::string::npos) {
+            literal.append(templ, pos, std::string::npos);
+            break;
+        }
+        const std::string name = templ.substr(open + 2, close - open - 2);
+        literal.append(templ, pos, open - pos);
+        pos = close + 1;
+        if (!IsPlaceholderName(name)) {
+            literal.append(templ, open, pos - open);
+            continue;
+        }
+        const int var = FindVar(name);
+        if (var < 0) {
+            LOG_WARN("CommandTemplates", "[%s] %s: unknown placeholder ${%s} is left as is", section.c_str(),
+                     key.c_str(), name.c_str());
+        } else if (!(supplied & (1u << var))) {
+            LOG_WARN("CommandTemplates", "[%s] %s: ${%s} is not supplied for this command and is left as is",
+                     section.c_str(), key.c_str(), name.c_str());
+        }
+        if (!literal.empty()) {
+            compiled.literal_size += literal.size();
+            compiled.segments.push_back({std::move(literal), -1});
+            literal.clear();
+        }
+        compiled.segments.push_back({templ.substr(open, pos - open), var});
+    }
+    if (!literal.empty()) {
+        compiled.literal_size += literal.size();
+        compiled.segments.push_back({std::move(literal), -1});
+    }
+    return compiled;
+}
+
 std::string CommandTemplates::Render(const std::string &section, const std::string &key,
-                                     const std::unordered_map<std::string, std::string> &params) const {
+                                     const TemplateParams &params) const {
+    const auto sec = templates_.find(section);
+    if (sec == templates_.end()) return {};
+    const auto it = sec->second.find(key);
+    if (it == sec->second.end()) return {};
+    const CompiledTemplate &templ = it->second;
+
+    size_t size = templ.literal_size;
+    for (const auto &segment : templ.segments) {
+        if (segment.var < 0) continue;
+        const std::string *value = params.Get(static_cast<TemplateVar>(segment.var));
+        size += value ? value->size() : segment.text.size();
+    }
+    std::string out;
+    out.reserve(size);
+    for (const auto &segment : templ.segments) {
+        const std::string *value =
+            segment.var < 0 ? nullptr : params.Get(static_cast<TemplateVar>(segment.var));
+        out += value ? *value : segment.text;
+    }
+    return out;
+}
+
+bool CommandTemplates::IsBuiltIn(const std::string &section, const std::string &key) const {
     const auto sec = commands_.find(section);
+    if (sec == commands_.end()) return true;
+    const auto it = sec->second.find(key);
+    if (it == sec->second.end()) return true;
+    for (const auto &shipped : kPreviouslyShipped) {
+        if (section == shipped.section && key == shipped.key && it->second == shipped.text) return true;
+    }
     const auto def_sec = defaults_.find(section);
-    const auto lookup = [key](const std::unordered_map<std::string, std::string> &map) -> const std::string * {
-        auto it = map.find(key);
-        return it != map.end() ? &it->second : nullptr;
-    };
-    const std::string *templ = nullptr;
-    if (sec != commands_.end()) templ = lookup(sec->second);
-    if (!templ && def_sec != defaults_.end()) templ = lookup(def_sec->second);
-    if (!templ) return {};
-    return ReplaceVars(*templ, params);
+    if (def_sec == defaults_.end()) return false;
+    const auto def = def_sec->second.find(key);
+    return def != def_sec->second.end() && def->second == it->second;
 }
 
-std::string CommandTemplates::ReplaceVars(std::string templ,
-                                          const std::unordered_map<std::string, std::string> &params) {
-    for (const auto &[key, value] : params) {
-        std::string placeholder = "${" + key + "}";
+std::vector<std::string> CommandTemplates::Keys(const std::string &section) const {
+    std::vector<std::string> keys;
+    auto sec = templates_.find(section);
+    if (sec != templates_.end()) {
+        for (const auto &entry : sec->second) keys.push_back(entry.first);
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+std::string CommandTemplates::RenderBatch(const std::string &section, const TemplateParams &params) const {
+    std::string script;
+    for (const auto &key : Keys(section)) {
+        std::string cmd = Render(section, key, params);
+        if (cmd.empty() || key == kBatchEnd) continue;
+        // Each query runs in its own subshell so a failing one cannot end the
+        // script or leak into the next key's output.
+        script += std::string("echo '") + kBatchMarker + key + "'; ( " + cmd + " ) 2>/dev/null; ";
+    }
+    if (script.empty()) return {};
+    return script + "echo '" + kBatchMarker + kBatchEnd + "'";
+}
 
-        size_t pos = 0;
-        while ((pos = templ.find(placeholder, pos)) != std::string::npos) {
-            templ.replace(pos, placeholder.size(), value);
-            pos += value.size();
+bool CommandTemplates::ParseBatchReply(const std::vector<std::string> &lines,
+                                       std::unordered_map<std::string, std::string> &values) {
+    const std::string marker = kBatchMarker;
+    std::string current;
+    for (const auto &entry : lines) {
+        // UDP replies may carry several lines per datagram.
+        std::istringstream stream(entry);
+        std::string line;
+        while (std::getline(stream, line)) {
+            std::string trimmed = Trim(line);
+            if (trimmed.compare(0, marker.size(), marker) == 0) {
+                current = trimmed.substr(marker.size());
+                if (current == kBatchEnd) return true;
+                continue;
+            }
+            if (current.empty() || trimmed.empty()) continue;
+            values.emplace(current, trimmed);
         }
     }
-    return templ;
+    return false;
 }
 
 void CommandTemplates::InitDefaults() {
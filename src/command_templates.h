@@ -1,20 +1,75 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+// Placeholders the application fills in, written ${NAME} in command.cfg.
+enum class TemplateVar { Channel, Bandwidth, Width, Height, Fps, BitrateKbps, Power, TxPower, BwSuffix, Count };
+
+class TemplateParams {
+public:
+    TemplateParams &Set(TemplateVar var, std::string value) {
+        values_[static_cast<size_t>(var)] = std::move(value);
+        set_ |= 1u << static_cast<unsigned>(var);
+        return *this;
+    }
+    const std::string *Get(TemplateVar var) const {
+        return (set_ & (1u << static_cast<unsigned>(var))) ? &values_[static_cast<size_t>(var)] : nullptr;
+    }
+
+private:
+    std::array<std::string, static_cast<size_t>(TemplateVar::Count)> values_;
+    uint32_t set_ = 0;
+};
+
+// Templates are compiled into literal and placeholder segments when loaded,
+// and placeholders a template cannot be given are reported then. Unknown or
+// unset placeholders are left in the command as written.
 class CommandTemplates {
 public:
     CommandTemplates();
     bool LoadFromFile(const std::string &path);
-    std::string Render(const std::string &section, const std::string &key,
-                       const std::unordered_map<std::string, std::string> &params) const;
+    std::string Render(const std::string &section, const std::string &key, const TemplateParams &params = {}) const;
+
+    // True when command.cfg leaves section/key at its built-in default, by not
+    // setting it or by setting the same text or a previously shipped one.
+    bool IsBuiltIn(const std::string &section, const std::string &key) const;
+    // Keys defined for section, from command.cfg or the built-in defaults, sorted.
+    std::vector<std::string> Keys(const std::string &section) const;
+    // Combines every template of section into one shell script whose output
+    // is split by "@@<key>" marker lines and ends with "@@end", so a whole
+    // section can be queried in one round trip. Empty if the section is empty.
+    std::string RenderBatch(const std::string &section, const TemplateParams &params = {}) const;
+    // Splits the reply to a RenderBatch script into the first non-empty line
+    // printed under each key. Returns false if the "@@end" marker is missing,
+    // i.e. the reply was cut short; values parsed so far are still stored.
+    static bool ParseBatchReply(const std::vector<std::string> &lines,
+                                std::unordered_map<std::string, std::string> &values);
 
 private:
+    struct Segment {
+        std::string text;
+        // Placeholder slot, or -1 for literal text. A placeholder keeps its
+        // ${NAME} form in text for when no value is given.
+        int var = -1;
+    };
+    struct CompiledTemplate {
+        std::vector<Segment> segments;
+        size_t literal_size = 0;
+    };
+    using Section = std::unordered_map<std::string, CompiledTemplate>;
+
     void InitDefaults();
-    static std::string ReplaceVars(std::string templ, const std::unordered_map<std::string, std::string> &params);
+    // Rebuilds templates_ from the defaults overlaid with command.cfg.
+    void Compile();
+    static CompiledTemplate CompileOne(const std::string &section, const std::string &key, const std::string &templ);
 
     std::unordered_map<std::string, std::unordered_map<std::string, std::string>> commands_;
     std::unordered_map<std::string, std::unordered_map<std::string, std::string>> defaults_;
+    std::unordered_map<std::string, Section> templates_;
 };
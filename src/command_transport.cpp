@@ -0,0 +1,133 @@
+#include "command_transport.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+
+void CommandCancelToken::Cancel() {
+    cancelled_.store(true, std::memory_order_release);
+    std::function<void()> waker;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        waker = waker_;
+    }
+    if (waker) {
+        waker();
+    }
+}
+
+void CommandCancelToken::SetWaker(std::function<void()> waker) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    waker_ = std::move(waker);
+}
+
+CommandTransport::~CommandTransport() {
+    StopAsync();
+}
+
+std::future<CommandResult> CommandTransport::SendAsync(const std::string &cmd,
+                                                       std::chrono::steady_clock::time_point deadline,
+                                                       std::shared_ptr<CommandCancelToken> cancel) {
+    if (!cancel) {
+        cancel = std::make_shared<CommandCancelToken>();
+    }
+    std::weak_ptr<CommandTransport> weak_self = weak_from_this();
+    cancel->SetWaker([weak_self]() {
+        if (auto transport = weak_self.lock()) {
+            transport->WakeWaiters();
+        }
+    });
+
+    AsyncJob job;
+    job.cmd = cmd;
+    job.deadline = deadline;
+    job.cancel = cancel;
+    std::future<CommandResult> future = job.promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(async_mutex_);
+        if (async_stopping_) {
+            cancel->SetWaker(nullptr);
+            job.promise.set_value(CommandResult{CommandStatus::Cancelled, {}});
+            return future;
+        }
+        in_flight_.erase(std::remove_if(in_flight_.begin(), in_flight_.end(),
+                                        [](const std::weak_ptr<CommandCancelToken> &t) { return t.expired(); }),
+                         in_flight_.end());
+        in_flight_.push_back(cancel);
+        async_jobs_.push_back(std::move(job));
+        // Workers are started on demand and stay until StopAsync().
+        if (idle_workers_ < async_jobs_.size() && async_workers_.size() < kMaxAsyncWorkers) {
+            async_workers_.emplace_back(&CommandTransport::AsyncWorker, this);
+        }
+    }
+    async_cv_.notify_one();
+    return future;
+}
+
+void CommandTransport::AsyncWorker() {
+    pthread_setname_np(pthread_self(), "cmd-async");
+    std::unique_lock<std::mutex> lock(async_mutex_);
+    while (true) {
+        ++idle_workers_;
+        async_cv_.wait(lock, [this] { return async_stopping_ || !async_jobs_.empty(); });
+        --idle_workers_;
+        if (async_stopping_) {
+            return;
+        }
+        AsyncJob job = std::move(async_jobs_.front());
+        async_jobs_.pop_front();
+        lock.unlock();
+        RunAsyncJob(job);
+        lock.lock();
+    }
+}
+
+void CommandTransport::RunAsyncJob(AsyncJob &job) {
+    CommandResult result;
+    if (job.cancel->IsCancelled()) {
+        result.status = CommandStatus::Cancelled;
+    } else if (std::chrono::steady_clock::now() < job.deadline) {
+        result.status = ExecuteCancellable(job.cmd, result.response, job.deadline, *job.cancel);
+    }
+    job.cancel->SetWaker(nullptr);
+    job.promise.set_value(std::move(result));
+}
+
+void CommandTransport::StopAsync() {
+    std::deque<AsyncJob> queued;
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(async_mutex_);
+        if (async_stopping_) {
+            return;
+        }
+        async_stopping_ = true;
+        queued.swap(async_jobs_);
+        workers.swap(async_workers_);
+    }
+    CancelAll();
+    async_cv_.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    for (AsyncJob &job : queued) {
+        job.cancel->SetWaker(nullptr);
+        job.promise.set_value(CommandResult{CommandStatus::Cancelled, {}});
+    }
+}
+
+void CommandTransport::CancelAll() {
+    std::vector<std::shared_ptr<CommandCancelToken>> tokens;
+    {
+        std::lock_guard<std::mutex> lock(async_mutex_);
+        for (const auto &weak : in_flight_) {
+            if (auto token = weak.lock()) {
+                tokens.push_back(std::move(token));
+            }
+        }
+        in_flight_.clear();
+    }
+    for (const auto &token : tokens) {
+        token->Cancel();
+    }
+}
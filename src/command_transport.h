@@ -1,12 +1,100 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
-class CommandTransport {
+// TimedOut: the command was accepted but did not finish by the deadline, or
+// the sky side reported that it timed out; response holds what arrived.
+enum class CommandStatus { Ok, Failed, Cancelled, TimedOut };
+
+// What the blocking Send/SendWithReply report as success: the command was
+// taken, even if its reply was cut short by a timeout.
+inline bool CommandAccepted(CommandStatus status) {
+    return status == CommandStatus::Ok || status == CommandStatus::TimedOut;
+}
+
+struct CommandResult {
+    CommandStatus status = CommandStatus::Failed;
+    std::vector<std::string> response;
+};
+
+// Shared by the caller of SendAsync and the transport running the command.
+// Cancel() may be called from any thread, any number of times.
+class CommandCancelToken {
 public:
-    virtual ~CommandTransport() = default;
+    void Cancel();
+    bool IsCancelled() const { return cancelled_.load(std::memory_order_acquire); }
+
+private:
+    friend class CommandTransport;
+    void SetWaker(std::function<void()> waker);
+
+    std::atomic<bool> cancelled_{false};
+    std::mutex mutex_;
+    std::function<void()> waker_;
+};
+
+class CommandTransport : public std::enable_shared_from_this<CommandTransport> {
+public:
+    // SendAsync commands run on up to this many worker threads per transport.
+    static constexpr size_t kMaxAsyncWorkers = 4;
+
+    virtual ~CommandTransport();
     virtual bool Send(const std::string &cmd, bool expect_reply = false, int timeout_ms = 500) = 0;
     virtual bool SendWithReply(const std::string &cmd, std::vector<std::string> &response,
                                int timeout_ms = 1000) = 0;
+
+    // Runs cmd on one of the transport's workers, capturing its output. The
+    // future is ready once the command finishes, fails, runs past deadline or
+    // is cancelled through cancel or CancelAll(). Cancelling wakes a blocked
+    // command only when the transport is owned by a shared_ptr.
+    std::future<CommandResult> SendAsync(const std::string &cmd, std::chrono::steady_clock::time_point deadline,
+                                         std::shared_ptr<CommandCancelToken> cancel = nullptr);
+    // Cancels every SendAsync command still in flight, e.g. before the
+    // transport is replaced.
+    void CancelAll();
+
+protected:
+    // Blocking execution behind SendAsync; nothing may wait past deadline.
+    // Implementations check cancel.IsCancelled() wherever they wait and
+    // return Cancelled promptly.
+    virtual CommandStatus ExecuteCancellable(const std::string &cmd, std::vector<std::string> &response,
+                                             std::chrono::steady_clock::time_point deadline,
+                                             const CommandCancelToken &cancel) = 0;
+    // Called after a token is cancelled so blocked waits can re-check it.
+    virtual void WakeWaiters() {}
+    // Cancels running commands, joins the workers and resolves queued ones
+    // as Cancelled. Derived destructors call this first, while the members
+    // ExecuteCancellable uses still exist.
+    void StopAsync();
+
+private:
+    struct AsyncJob {
+        std::string cmd;
+        std::chrono::steady_clock::time_point deadline;
+        std::shared_ptr<CommandCancelToken> cancel;
+        std::promise<CommandResult> promise;
+    };
+
+    void AsyncWorker();
+    void RunAsyncJob(AsyncJob &job);
+
+    // Guards everything below.
+    std::mutex async_mutex_;
+    std::condition_variable async_cv_;
+    std::deque<AsyncJob> async_jobs_;
+    std::vector<std::thread> async_workers_;
+    size_t idle_workers_ = 0;
+    bool async_stopping_ = false;
+    std::vector<std::weak_ptr<CommandCancelToken>> in_flight_;
 };
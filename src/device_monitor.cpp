@@ -0,0 +1,106 @@
+#include "device_monitor.h"
+
+#include "logger.h"
+
+#include <cstring>
+#include <libudev.h>
+
+namespace
+{
+std::string SafeString(const char *value)
+{
+    return value ? std::string(value) : std::string();
+}
+
+DeviceMonitor::Event MakeEvent(DeviceMonitor::Action action, struct udev_device *dev)
+{
+    DeviceMonitor::Event event;
+    event.action = action;
+    event.subsystem = SafeString(udev_device_get_subsystem(dev));
+    event.sysname = SafeString(udev_device_get_sysname(dev));
+    event.syspath = SafeString(udev_device_get_syspath(dev));
+    event.devnode = SafeString(udev_device_get_devnode(dev));
+    return event;
+}
+} // namespace
+
+DeviceMonitor::DeviceMonitor(struct udev *udev)
+    : udev_(udev ? udev_ref(udev) : udev_new())
+{
+    if (!udev_)
+        LOG_ERROR("DeviceMonitor", "udev_new failed");
+}
+
+DeviceMonitor::~DeviceMonitor()
+{
+    if (monitor_)
+        udev_monitor_unref(monitor_);
+    if (udev_)
+        udev_unref(udev_);
+}
+
+bool DeviceMonitor::Start(std::initializer_list<const char *> subsystems)
+{
+    if (!udev_ || monitor_)
+        return monitor_ != nullptr;
+    monitor_ = udev_monitor_new_from_netlink(udev_, "udev");
+    if (!monitor_)
+    {
+        LOG_ERROR("DeviceMonitor", "udev_monitor_new_from_netlink failed");
+        return false;
+    }
+    for (const char *subsystem : subsystems)
+        udev_monitor_filter_add_match_subsystem_devtype(monitor_, subsystem, nullptr);
+    if (udev_monitor_enable_receiving(monitor_) < 0)
+    {
+        LOG_ERROR("DeviceMonitor", "udev_monitor_enable_receiving failed");
+        udev_monitor_unref(monitor_);
+        monitor_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+int DeviceMonitor::Fd() const
+{
+    return monitor_ ? udev_monitor_get_fd(monitor_) : -1;
+}
+
+void DeviceMonitor::Enumerate(const char *subsystem, const Handler &handler)
+{
+    if (!udev_)
+        return;
+    struct udev_enumerate *enumerate = udev_enumerate_new(udev_);
+    if (!enumerate)
+        return;
+    udev_enumerate_add_match_subsystem(enumerate, subsystem);
+    udev_enumerate_scan_devices(enumerate);
+    struct udev_list_entry *entry = nullptr;
+    udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate))
+    {
+        struct udev_device *dev = udev_device_new_from_syspath(udev_, udev_list_entry_get_name(entry));
+        if (!dev)
+            continue;
+        handler(MakeEvent(Action::Add, dev));
+        udev_device_unref(dev);
+    }
+    udev_enumerate_unref(enumerate);
+}
+
+void DeviceMonitor::Dispatch(const Handler &handler)
+{
+    if (!monitor_)
+        return;
+    // The monitor socket is non-blocking, so this returns once it is drained.
+    while (struct udev_device *dev = udev_monitor_receive_device(monitor_))
+    {
+        const char *action = udev_device_get_action(dev);
+        Action kind = Action::Change;
+        if (action && std::strcmp(action, "add") == 0)
+            kind = Action::Add;
+        else if (action && std::strcmp(action, "remove") == 0)
+            kind = Action::Remove;
+        handler(MakeEvent(kind, dev));
+        udev_device_unref(dev);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <functional>
+#include <initializer_list>
+#include <string>
+
+struct udev;
+struct udev_monitor;
+
+// Hotplug notifications from a udev netlink monitor. Devices present at
+// startup are reported as Add events by Enumerate(), so callers open devices
+// from one code path and never scan /dev or /sys directories themselves.
+// Not thread-safe: each thread that needs hotplug events owns its own monitor.
+class DeviceMonitor
+{
+public:
+    enum class Action
+    {
+        Add,
+        Remove,
+        Change,
+    };
+
+    struct Event
+    {
+        Action action = Action::Add;
+        std::string subsystem;
+        std::string sysname; // e.g. "hidraw0", "js1", "BAT0"
+        std::string syspath;
+        std::string devnode; // empty for devices without a /dev node
+    };
+
+    using Handler = std::function<void(const Event &)>;
+
+    // Uses the given udev context (taking a reference) or creates one.
+    explicit DeviceMonitor(struct udev *udev = nullptr);
+    ~DeviceMonitor();
+    DeviceMonitor(const DeviceMonitor &) = delete;
+    DeviceMonitor &operator=(const DeviceMonitor &) = delete;
+
+    bool Start(std::initializer_list<const char *> subsystems);
+    int Fd() const;
+    // Reports every existing device of the subsystem as an Add event.
+    void Enumerate(const char *subsystem, const Handler &handler);
+    // Drains pending events without blocking.
+    void Dispatch(const Handler &handler);
+
+private:
+    struct udev *udev_ = nullptr;
+    struct udev_monitor *monitor_ = nullptr;
+};
@@ -0,0 +1,336 @@
+#include "hid_descriptor.h"
+
+#include "logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Descriptor walks trace every item when verbose; normally they are silent.
+#define HID_TRACE(...)                               \
+    do                                               \
+    {                                                \
+        if (verbose)                                 \
+            LOG_DEBUG("HidDescriptor", __VA_ARGS__); \
+    } while (0)
+
+namespace
+{
+// hidraw reports are at most HID_MAX_BUFFER_SIZE (16 KiB); anything larger
+// comes from a corrupt descriptor.
+constexpr uint64_t kMaxReportBits = 16384 * 8;
+
+bool IsBatteryUsage(uint32_t usage, bool verbose)
+{
+    uint16_t page = static_cast<uint16_t>(usage >> 16);
+    uint16_t code = static_cast<uint16_t>(usage & 0xFFFF);
+    if (page == 0x06 && code == 0x20)
+    {
+        HID_TRACE("matched battery usage GD 0x%04x", code);
+        return true;
+    }
+    if (page == 0x84 && (code == 0x68 || code == 0x20))
+    {
+        HID_TRACE("matched battery usage PD 0x%04x", code);
+        return true;
+    }
+    return false;
+}
+} // namespace
+
+std::optional<HidBatteryField> FindHidBatteryField(const uint8_t *desc, size_t desc_size, bool verbose)
+{
+    std::unordered_map<uint8_t, std::pair<uint32_t, uint32_t>> report_bits;
+    uint16_t usage_page = 0;
+    uint32_t report_size = 0;
+    uint32_t report_count = 0;
+    uint8_t report_id = 0;
+    std::vector<uint32_t> usages;
+    std::optional<uint32_t> usage_min;
+    std::optional<uint32_t> usage_max;
+    bool pending_battery_usage = false;
+
+    size_t i = 0;
+    while (i < desc_size)
+    {
+        uint8_t b = desc[i++];
+        uint8_t item_size = b & 0x3;
+        if (item_size == 3)
+            item_size = 4;
+        if (i + item_size > desc_size)
+            break;
+        uint8_t type = (b >> 2) & 0x3;
+        uint8_t tag = (b >> 4) & 0xF;
+        uint32_t value = 0;
+        for (uint8_t n = 0; n < item_size; ++n)
+        {
+            value |= static_cast<uint32_t>(desc[i++]) << (8 * n);
+        }
+
+        if (type == 1) // Global
+        {
+            switch (tag)
+            {
+            case 0: usage_page = static_cast<uint16_t>(value); break;
+            case 7: report_size = value; break;
+            case 8: report_id = static_cast<uint8_t>(value); break;
+            case 9: report_count = value; break;
+            default: break;
+            }
+        }
+        else if (type == 2) // Local
+        {
+            switch (tag)
+            {
+            case 0: // Usage
+            {
+                uint32_t usage = (static_cast<uint32_t>(usage_page) << 16) | (value & 0xFFFF);
+                if (usage_page == 0x84)
+                    HID_TRACE("saw usage page84 code=0x%04x", value & 0xFFFF);
+                if (IsBatteryUsage(usage, verbose))
+                    pending_battery_usage = true;
+                usages.push_back(usage);
+                break;
+            }
+            case 1:
+                usage_min = value & 0xFFFF;
+                break;
+            case 2:
+                usage_max = value & 0xFFFF;
+                if (usage_min && usage_max && usage_max >= usage_min)
+                {
+                    for (uint32_t u = *usage_min; u <= *usage_max && usages.size() < 32; ++u)
+                    {
+                        usages.push_back((static_cast<uint32_t>(usage_page) << 16) | u);
+                    }
+                }
+                usage_min.reset();
+                usage_max.reset();
+                break;
+            default:
+                break;
+            }
+        }
+        else if (type == 0) // Main
+        {
+            bool is_input = (tag == 8);
+            bool is_feature = (tag == 11);
+            if ((is_input || is_feature) && report_size > 0 && report_count > 0)
+            {
+                auto &state = report_bits[report_id];
+                uint32_t offset = is_feature ? state.second : state.first;
+                const uint64_t block_bits = static_cast<uint64_t>(report_size) * report_count;
+                if (report_size > 32 || offset + block_bits > kMaxReportBits)
+                {
+                    HID_TRACE("report_id=%u exceeds the maximum report size, giving up", report_id);
+                    return std::nullopt;
+                }
+                uint32_t total_bits = static_cast<uint32_t>(block_bits);
+                HID_TRACE("main item report_id=%u type=%s size=%u count=%u usages=%zu pending=%d offset=%u",
+                          report_id, is_feature ? "feature" : "input", report_size, report_count,
+                          usages.size(), pending_battery_usage ? 1 : 0, offset);
+                if (usages.empty() && usage_min && usage_max && usage_max >= usage_min)
+                {
+                    for (uint32_t u = *usage_min; u <= *usage_max && usages.size() < 32; ++u)
+                    {
+                        usages.push_back((static_cast<uint32_t>(usage_page) << 16) | u);
+                    }
+                }
+                // Slots past the listed usages can only match through a
+                // pending battery usage, and only in slot 0.
+                const size_t slots = std::min<size_t>(report_count, std::max<size_t>(usages.size(), 1));
+                for (size_t idx = 0; idx < slots; ++idx)
+                {
+                    bool usage_is_batt = false;
+                    if (idx < usages.size())
+                    {
+                        HID_TRACE("checking usage 0x%08x (page=0x%04x code=0x%04x)",
+                                  usages[idx], static_cast<uint16_t>(usages[idx] >> 16),
+                                  static_cast<uint16_t>(usages[idx] & 0xFFFF));
+                        usage_is_batt = IsBatteryUsage(usages[idx], verbose);
+                        if (usage_is_batt)
+                            HID_TRACE("usage slot %zu matches battery", idx);
+                    }
+                    else if (pending_battery_usage && idx == 0)
+                    {
+                        HID_TRACE("assuming pending battery usage in mixed block");
+                        usage_is_batt = true;
+                    }
+
+                    if (usage_is_batt)
+                    {
+                        HidBatteryField field{};
+                        field.report_id = report_id;
+                        field.bit_offset = offset + static_cast<uint32_t>(idx) * report_size;
+                        field.bit_size = std::min<uint32_t>(report_size, 16);
+                        field.is_feature = is_feature;
+                        field.report_bits = offset + total_bits;
+                        HID_TRACE("battery field resolved report_id=%u offset=%u size=%u",
+                                  field.report_id, field.bit_offset, field.bit_size);
+                        return field;
+                    }
+                }
+                if (pending_battery_usage)
+                {
+                    HidBatteryField field{};
+                    field.report_id = report_id;
+                    field.bit_offset = offset;
+                    field.bit_size = report_size ? std::min<uint32_t>(report_size, 16) : 8;
+                    field.is_feature = is_feature;
+                    field.report_bits = offset + total_bits;
+                    HID_TRACE("fallback battery field report_id=%u offset=%u size=%u",
+                              field.report_id, field.bit_offset, field.bit_size);
+                    return field;
+                }
+                pending_battery_usage = false;
+                if (is_feature)
+                    state.second += total_bits;
+                else
+                    state.first += total_bits;
+                usages.clear();
+                usage_min.reset();
+                usage_max.reset();
+            }
+            else if (tag == 10)
+            {
+                usages.clear();
+                usage_min.reset();
+                usage_max.reset();
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+float ExtractHidBatteryPercent(const uint8_t *data, size_t len, const HidBatteryField &field)
+{
+    if (field.bit_size == 0)
+        return -1.0f;
+    const size_t needed_bits = field.bit_offset + field.bit_size;
+    if (needed_bits > len * 8)
+        return -1.0f;
+    uint32_t raw = 0;
+    for (uint32_t bit = 0; bit < field.bit_size; ++bit)
+    {
+        uint32_t idx = field.bit_offset + bit;
+        uint8_t byte = data[idx / 8];
+        raw |= ((byte >> (idx % 8)) & 0x1u) << bit;
+    }
+    uint32_t max_value = (field.bit_size >= 31) ? 0xFFFFFFFFu : ((1u << field.bit_size) - 1u);
+    if (max_value == 0)
+        return -1.0f;
+    float pct = (static_cast<float>(raw) * 100.0f) / static_cast<float>(max_value);
+    return std::clamp(pct, 0.0f, 100.0f);
+}
+
+
+uint64_t HashHidDescriptor(const uint8_t *desc, size_t desc_size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < desc_size; ++i)
+    {
+        hash ^= desc[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+HidFieldCache::HidFieldCache(std::string path) : path_(std::move(path)) {}
+
+std::optional<std::optional<HidBatteryField>> HidFieldCache::Find(uint16_t vendor, uint16_t product,
+                                                                  uint64_t hash)
+{
+    if (!loaded_)
+        Load();
+    auto it = entries_.find(Key{vendor, product, hash});
+    if (it == entries_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+void HidFieldCache::Store(uint16_t vendor, uint16_t product, uint64_t hash,
+                          const std::optional<HidBatteryField> &field)
+{
+    if (!loaded_)
+        Load();
+    entries_[Key{vendor, product, hash}] = field;
+    Save();
+}
+
+// One entry per line, all numbers in hex:
+//   <vid> <pid> <hash> none
+//   <vid> <pid> <hash> <report_id> <bit_offset> <bit_size> <is_feature> <report_bits>
+void HidFieldCache::Load()
+{
+    loaded_ = true;
+    std::ifstream file(path_);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream in(line);
+        in >> std::hex;
+        uint32_t vendor = 0, product = 0;
+        uint64_t hash = 0;
+        if (!(in >> vendor >> product >> hash))
+            continue;
+        std::string first;
+        if (!(in >> first))
+            continue;
+        Key key{static_cast<uint16_t>(vendor), static_cast<uint16_t>(product), hash};
+        if (first == "none")
+        {
+            entries_[key] = std::nullopt;
+            continue;
+        }
+        uint32_t report_id = 0, bit_offset = 0, bit_size = 0, is_feature = 0, report_bits = 0;
+        std::istringstream rest(first);
+        rest >> std::hex >> report_id;
+        if (rest.fail() || !(in >> bit_offset >> bit_size >> is_feature >> report_bits) ||
+            report_id > 0xFF || bit_size == 0 || bit_size > 16)
+            continue;
+        HidBatteryField field{};
+        field.report_id = static_cast<uint8_t>(report_id);
+        field.bit_offset = bit_offset;
+        field.bit_size = static_cast<uint8_t>(bit_size);
+        field.is_feature = is_feature != 0;
+        field.report_bits = report_bits;
+        entries_[key] = field;
+    }
+}
+
+void HidFieldCache::Save() const
+{
+    const std::string tmp = path_ + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        if (!file)
+            return;
+        file << std::hex;
+        for (const auto &entry : entries_)
+        {
+            file << std::get<0>(entry.first) << ' ' << std::get<1>(entry.first) << ' '
+                 << std::get<2>(entry.first) << ' ';
+            const auto &field = entry.second;
+            if (!field)
+            {
+                file << "none\n";
+                continue;
+            }
+            file << static_cast<uint32_t>(field->report_id) << ' ' << field->bit_offset << ' '
+                 << static_cast<uint32_t>(field->bit_size) << ' ' << (field->is_feature ? 1 : 0) << ' '
+                 << field->report_bits << '\n';
+        }
+        if (!file)
+        {
+            LOG_WARN("HidDescriptor", "failed to write %s", tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), path_.c_str()) != 0)
+        std::remove(tmp.c_str());
+}
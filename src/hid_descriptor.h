@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+
+// Location of the battery strength value inside a HID input or feature report.
+struct HidBatteryField
+{
+    uint8_t report_id = 0;
+    uint32_t bit_offset = 0;
+    uint8_t bit_size = 0;
+    bool is_feature = false;
+    uint32_t report_bits = 0;
+};
+
+// Walks a raw HID report descriptor looking for a battery strength usage
+// (Generic Device 0x20 or Power Device 0x20/0x68). With verbose set every
+// item is logged at debug level under the "HidDescriptor" module.
+std::optional<HidBatteryField> FindHidBatteryField(const uint8_t *desc, size_t desc_size,
+                                                   bool verbose = false);
+
+// Scales the field's raw value in a report payload to 0..100, or -1 if the
+// payload is too short.
+float ExtractHidBatteryPercent(const uint8_t *data, size_t len, const HidBatteryField &field);
+
+// FNV-1a over the descriptor bytes.
+uint64_t HashHidDescriptor(const uint8_t *desc, size_t desc_size);
+
+// Resolved battery fields keyed by VID/PID and descriptor hash, including
+// negative results for devices without a battery usage. The on-disk copy is
+// a small text file loaded on first use and rewritten after each insert. Not
+// thread safe; the telemetry thread owns it.
+class HidFieldCache
+{
+public:
+    explicit HidFieldCache(std::string path = "/storage/digitalfpv/hid_fields.cache");
+
+    // Outer optional: whether the device is known. Inner: its field, if any.
+    std::optional<std::optional<HidBatteryField>> Find(uint16_t vendor, uint16_t product,
+                                                       uint64_t hash);
+    void Store(uint16_t vendor, uint16_t product, uint64_t hash,
+               const std::optional<HidBatteryField> &field);
+
+private:
+    using Key = std::tuple<uint16_t, uint16_t, uint64_t>;
+
+    void Load();
+    void Save() const;
+
+    std::string path_;
+    bool loaded_ = false;
+    std::map<Key, std::optional<HidBatteryField>> entries_;
+};
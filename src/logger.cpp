@@ -0,0 +1,406 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+constexpr size_t kRingMask = Logger::kRingSize - 1;
+static_assert((Logger::kRingSize & kRingMask) == 0, "ring size must be a power of two");
+
+constexpr auto kDrainInterval = std::chrono::milliseconds(200);
+
+int SyslogPriority(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Debug: return 7;
+    case LogLevel::Info: return 6;
+    case LogLevel::Warn: return 4;
+    default: return 3;
+    }
+}
+
+void CopyModule(char (&dst)[Logger::kModuleSize], const char *module)
+{
+    std::strncpy(dst, module ? module : "", Logger::kModuleSize - 1);
+    dst[Logger::kModuleSize - 1] = '\0';
+}
+
+void WriteAll(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(STDERR_FILENO, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+void StepLevel(int delta)
+{
+    Logger &logger = Logger::Shared();
+    int level = static_cast<int>(logger.Level()) + delta;
+    if (level < static_cast<int>(LogLevel::Debug))
+        level = static_cast<int>(LogLevel::Debug);
+    if (level > static_cast<int>(LogLevel::Error))
+        level = static_cast<int>(LogLevel::Error);
+    logger.SetLevel(static_cast<LogLevel>(level));
+}
+
+void OnLevelSignal(int sig)
+{
+    // Only atomics are touched; the drain thread reports the new level.
+    StepLevel(sig == SIGUSR1 ? -1 : 1);
+}
+} // namespace
+
+const char *LogLevelName(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Debug: return "debug";
+    case LogLevel::Info: return "info";
+    case LogLevel::Warn: return "warn";
+    case LogLevel::Error: return "error";
+    default: return "off";
+    }
+}
+
+bool ParseLogLevel(std::string_view text, LogLevel &level)
+{
+    std::string lower(text);
+    for (auto &c : lower)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    if (lower == "debug")
+        level = LogLevel::Debug;
+    else if (lower == "info")
+        level = LogLevel::Info;
+    else if (lower == "warn" || lower == "warning")
+        level = LogLevel::Warn;
+    else if (lower == "error")
+        level = LogLevel::Error;
+    else if (lower == "off" || lower == "none")
+        level = LogLevel::Off;
+    else
+        return false;
+    return true;
+}
+
+Logger &Logger::Shared()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+{
+    for (size_t i = 0; i < kRingSize; ++i)
+        ring_[i].seq.store(i, std::memory_order_relaxed);
+    // systemd passes JOURNAL_STREAM when stderr is connected to the journal,
+    // which then reads the level from a "<N>" line prefix.
+    journal_prefix_ = std::getenv("JOURNAL_STREAM") != nullptr;
+}
+
+Logger::~Logger()
+{
+    Stop();
+}
+
+void Logger::Start()
+{
+    if (running_.load())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = false;
+    }
+    worker_ = std::thread(&Logger::ThreadMain, this);
+    running_.store(true, std::memory_order_release);
+}
+
+void Logger::Stop()
+{
+    if (!running_.exchange(false))
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (worker_.joinable())
+        worker_.join();
+    // A producer that saw running_ before it was cleared may still be filling
+    // its slot; wait for it to publish so the final drain picks it up.
+    while (producers_.load() != 0)
+        std::this_thread::yield();
+    // Anything a producer pushed while the thread was exiting.
+    std::string batch;
+    if (DrainOnce(batch))
+        WriteAll(batch.data(), batch.size());
+}
+
+void Logger::SetLevel(LogLevel level)
+{
+    level_.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+LogLevel Logger::Level() const
+{
+    return static_cast<LogLevel>(level_.load(std::memory_order_relaxed));
+}
+
+void Logger::SetModuleLevel(std::string_view module, LogLevel level)
+{
+    if (module.empty() || module.size() >= kModuleSize)
+        return;
+    std::lock_guard<std::mutex> lock(modules_mutex_);
+    const size_t count = module_count_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (module == modules_[i].name)
+        {
+            modules_[i].level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+            return;
+        }
+    }
+    if (count == kMaxModules)
+        return;
+    // Names are never rewritten once published, so readers need no lock.
+    ModuleLevel &slot = modules_[count];
+    std::memcpy(slot.name, module.data(), module.size());
+    slot.name[module.size()] = '\0';
+    slot.level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+    module_count_.store(count + 1, std::memory_order_release);
+}
+
+bool Logger::Configure(std::string_view spec)
+{
+    bool ok = true;
+    while (!spec.empty())
+    {
+        size_t comma = spec.find(',');
+        std::string_view part = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view{} : spec.substr(comma + 1);
+        while (!part.empty() && std::isspace(static_cast<unsigned char>(part.front())))
+            part.remove_prefix(1);
+        while (!part.empty() && std::isspace(static_cast<unsigned char>(part.back())))
+            part.remove_suffix(1);
+        if (part.empty())
+            continue;
+        LogLevel level;
+        size_t eq = part.find('=');
+        if (eq == std::string_view::npos)
+        {
+            if (ParseLogLevel(part, level))
+                SetLevel(level);
+            else
+                ok = false;
+            continue;
+        }
+        if (ParseLogLevel(part.substr(eq + 1), level) && eq > 0)
+            SetModuleLevel(part.substr(0, eq), level);
+        else
+            ok = false;
+    }
+    return ok;
+}
+
+void Logger::InstallLevelSignals()
+{
+    struct sigaction sa
+    {
+    };
+    sa.sa_handler = OnLevelSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, nullptr);
+    sigaction(SIGUSR2, &sa, nullptr);
+}
+
+bool Logger::Enabled(const char *module, LogLevel level) const
+{
+    uint8_t threshold = level_.load(std::memory_order_relaxed);
+    const size_t count = module_count_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (std::strcmp(modules_[i].name, module) == 0)
+        {
+            threshold = modules_[i].level.load(std::memory_order_relaxed);
+            break;
+        }
+    }
+    return static_cast<uint8_t>(level) >= threshold && threshold != static_cast<uint8_t>(LogLevel::Off);
+}
+
+void Logger::Write(LogLevel level, const char *module, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    Emit(level, module, 0, fmt, args);
+    va_end(args);
+}
+
+void Logger::WriteSuppressed(LogLevel level, const char *module, uint64_t suppressed, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    Emit(level, module, suppressed, fmt, args);
+    va_end(args);
+}
+
+void Logger::Emit(LogLevel level, const char *module, uint64_t suppressed, const char *fmt, va_list args)
+{
+    char text[kMessageSize];
+    int n = std::vsnprintf(text, sizeof(text), fmt, args);
+    size_t len = n < 0 ? 0 : std::min(static_cast<size_t>(n), sizeof(text) - 1);
+    while (len > 0 && text[len - 1] == '\n')
+        text[--len] = '\0';
+    if (suppressed > 0)
+        std::snprintf(text + len, sizeof(text) - len, " (%llu similar suppressed)",
+                      static_cast<unsigned long long>(suppressed));
+
+    // Pairs with the running_ exchange in Stop(): either this producer sees
+    // the logger stopped and writes directly, or Stop() waits for its slot.
+    producers_.fetch_add(1);
+    if (!running_.load())
+    {
+        producers_.fetch_sub(1, std::memory_order_release);
+        char line[kModuleSize + kMessageSize + 16];
+        WriteAll(line, FormatLine(line, sizeof(line), level, module, text));
+        return;
+    }
+
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    while (true)
+    {
+        slot = &ring_[pos & kRingMask];
+        const size_t seq = slot->seq.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0)
+        {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            dropped_total_.fetch_add(1, std::memory_order_relaxed);
+            producers_.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        else
+        {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->level = level;
+    CopyModule(slot->module, module);
+    std::memcpy(slot->text, text, sizeof(text));
+    slot->seq.store(pos + 1, std::memory_order_release);
+    producers_.fetch_sub(1, std::memory_order_release);
+
+    if (level >= LogLevel::Warn && sleeping_.exchange(false, std::memory_order_acq_rel))
+        cv_.notify_one();
+}
+
+size_t Logger::FormatLine(char *out, size_t cap, LogLevel level, const char *module, const char *text) const
+{
+    int n;
+    if (journal_prefix_)
+        n = std::snprintf(out, cap, "<%d>[%s] %s\n", SyslogPriority(level), module, text);
+    else
+        n = std::snprintf(out, cap, "[%s] %s\n", module, text);
+    if (n < 0)
+        return 0;
+    if (static_cast<size_t>(n) >= cap)
+    {
+        out[cap - 2] = '\n';
+        return cap - 1;
+    }
+    return static_cast<size_t>(n);
+}
+
+bool Logger::DrainOnce(std::string &batch)
+{
+    batch.clear();
+    char line[kModuleSize + kMessageSize + 16];
+    while (true)
+    {
+        Slot &slot = ring_[tail_ & kRingMask];
+        if (slot.seq.load(std::memory_order_acquire) != tail_ + 1)
+            break;
+        batch.append(line, FormatLine(line, sizeof(line), slot.level, slot.module, slot.text));
+        slot.seq.store(tail_ + kRingSize, std::memory_order_release);
+        ++tail_;
+    }
+    if (uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed))
+    {
+        char text[64];
+        std::snprintf(text, sizeof(text), "ring full, dropped %llu messages",
+                      static_cast<unsigned long long>(dropped));
+        batch.append(line, FormatLine(line, sizeof(line), LogLevel::Warn, "Log", text));
+    }
+    const uint8_t level = level_.load(std::memory_order_relaxed);
+    if (level != reported_level_)
+    {
+        reported_level_ = level;
+        char text[64];
+        std::snprintf(text, sizeof(text), "default level now %s", LogLevelName(static_cast<LogLevel>(level)));
+        batch.append(line, FormatLine(line, sizeof(line), LogLevel::Warn, "Log", text));
+    }
+    return !batch.empty();
+}
+
+void Logger::ThreadMain()
+{
+    pthread_setname_np(pthread_self(), "logger");
+    std::string batch;
+    batch.reserve(kRingSize * 96);
+    while (true)
+    {
+        if (DrainOnce(batch))
+            WriteAll(batch.data(), batch.size());
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stop_)
+            break;
+        // Info and debug lines are batched for up to kDrainInterval; warnings
+        // and errors wake the thread right away.
+        sleeping_.store(true, std::memory_order_release);
+        cv_.wait_for(lock, kDrainInterval, [this] { return stop_ || !sleeping_.load(std::memory_order_acquire); });
+        sleeping_.store(false, std::memory_order_release);
+    }
+    if (DrainOnce(batch))
+        WriteAll(batch.data(), batch.size());
+}
+
+bool LogRateLimit::Allow(uint64_t &suppressed)
+{
+    const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+    int64_t next = next_ms_.load(std::memory_order_relaxed);
+    if (now < next || !next_ms_.compare_exchange_strong(next, now + interval_ms_, std::memory_order_relaxed))
+    {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+}
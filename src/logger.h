@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+enum class LogLevel : uint8_t
+{
+    Debug = 0,
+    Info,
+    Warn,
+    Error,
+    Off,
+};
+
+// Process-wide logger. Producers format into a slot of a bounded lock-free
+// ring; a background thread drains the ring and writes whole batches to
+// stderr. Before Start() and after Stop() messages are written directly. When
+// the ring is full messages are dropped and counted rather than blocking the
+// caller.
+class Logger
+{
+public:
+    static constexpr size_t kRingSize = 256; // power of two
+    static constexpr size_t kModuleSize = 24;
+    static constexpr size_t kMessageSize = 232;
+    static constexpr size_t kMaxModules = 32;
+
+    static Logger &Shared();
+
+    void Start();
+    void Stop();
+
+    // Thresholds can be changed at any time from any thread.
+    void SetLevel(LogLevel level);
+    LogLevel Level() const;
+    void SetModuleLevel(std::string_view module, LogLevel level);
+    // Accepts "<level>[,<module>=<level>...]", e.g. "warn,Telemetry=debug".
+    // Returns false if any part was not understood.
+    bool Configure(std::string_view spec);
+    // SIGUSR1 makes the default level more verbose, SIGUSR2 less.
+    void InstallLevelSignals();
+
+    bool Enabled(const char *module, LogLevel level) const;
+    void Write(LogLevel level, const char *module, const char *fmt, ...)
+        __attribute__((format(printf, 4, 5)));
+    // Same as Write, noting how many messages the call site suppressed.
+    void WriteSuppressed(LogLevel level, const char *module, uint64_t suppressed, const char *fmt, ...)
+        __attribute__((format(printf, 5, 6)));
+
+    uint64_t Dropped() const { return dropped_total_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> seq{0};
+        LogLevel level = LogLevel::Info;
+        char module[kModuleSize] = {};
+        char text[kMessageSize] = {};
+    };
+
+    struct ModuleLevel
+    {
+        char name[kModuleSize] = {};
+        std::atomic<uint8_t> level{0};
+    };
+
+    Logger();
+    ~Logger();
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    void Emit(LogLevel level, const char *module, uint64_t suppressed, const char *fmt, va_list args);
+    size_t FormatLine(char *out, size_t cap, LogLevel level, const char *module, const char *text) const;
+    bool DrainOnce(std::string &batch);
+    void ThreadMain();
+
+    std::array<Slot, kRingSize> ring_;
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t tail_ = 0; // consumer side only
+
+    std::atomic<uint8_t> level_{static_cast<uint8_t>(LogLevel::Info)};
+    uint8_t reported_level_ = static_cast<uint8_t>(LogLevel::Info);
+    std::array<ModuleLevel, kMaxModules> modules_;
+    std::atomic<size_t> module_count_{0};
+    std::mutex modules_mutex_;
+
+    bool journal_prefix_ = false;
+    std::atomic<bool> running_{false};
+    // Producers between their running_ check and publishing their slot.
+    std::atomic<uint32_t> producers_{0};
+    std::atomic<bool> sleeping_{false};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> dropped_total_{0};
+    bool stop_ = false;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread worker_;
+};
+
+// Lets one message through per interval; the next one that passes carries the
+// number suppressed in between. Lock-free, safe to share between threads.
+class LogRateLimit
+{
+public:
+    explicit LogRateLimit(uint32_t interval_ms) : interval_ms_(interval_ms) {}
+
+    bool Allow(uint64_t &suppressed);
+
+private:
+    const uint32_t interval_ms_;
+    std::atomic<int64_t> next_ms_{0};
+    std::atomic<uint64_t> suppressed_{0};
+};
+
+const char *LogLevelName(LogLevel level);
+bool ParseLogLevel(std::string_view text, LogLevel &level);
+
+#define LOG_AT(level, module, ...)                          \
+    do                                                      \
+    {                                                       \
+        Logger &log_ = Logger::Shared();                    \
+        if (log_.Enabled(module, level))                    \
+            log_.Write(level, module, __VA_ARGS__);         \
+    } while (0)
+
+#define LOG_DEBUG(module, ...) LOG_AT(LogLevel::Debug, module, __VA_ARGS__)
+#define LOG_INFO(module, ...) LOG_AT(LogLevel::Info, module, __VA_ARGS__)
+#define LOG_WARN(module, ...) LOG_AT(LogLevel::Warn, module, __VA_ARGS__)
+#define LOG_ERROR(module, ...) LOG_AT(LogLevel::Error, module, __VA_ARGS__)
+
+// Rate limited per call site: at most one message every interval_ms.
+#define LOG_EVERY_MS(level, module, interval_ms, ...)                               \
+    do                                                                              \
+    {                                                                               \
+        static LogRateLimit log_limit_(interval_ms);                                \
+        Logger &log_ = Logger::Shared();                                            \
+        uint64_t log_suppressed_ = 0;                                               \
+        if (log_.Enabled(module, level) && log_limit_.Allow(log_suppressed_))       \
+            log_.WriteSuppressed(level, module, log_suppressed_, __VA_ARGS__);      \
+    } while (0)
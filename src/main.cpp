@@ -1,4 +1,5 @@
 #include "application.h"
+#include "logger.h"
 
 #include <getopt.h>
 #include <string>
@@ -64,6 +65,9 @@ int main(int argc, char **argv) {
         std::perror("[AMLgsMenu] setpriority");
     }
 
+    Logger::Shared().InstallLevelSignals();
+    Logger::Shared().Start();
+
     Application app;
     if (!cmd_cfg.empty()) {
         app.SetCommandCfgPath(cmd_cfg);
@@ -72,11 +76,13 @@ int main(int argc, char **argv) {
         app.SetConfigPath(cfg_path);
     }
     if (!app.Initialize(font_path, use_mock, term_font_path)) {
+        Logger::Shared().Stop();
         return 1;
     }
 
     app.Run();
     app.Shutdown();
+    Logger::Shared().Stop();
 
     return 0;
 }
@@ -6,6 +6,7 @@
 #include <cstring>
 #include <climits>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <sys/resource.h>
@@ -58,6 +59,7 @@ ParsedTelemetry MavlinkReceiver::Latest() const {
 }
 
 void MavlinkReceiver::ThreadFunc() {
+    pthread_setname_np(pthread_self(), "mavlink");
     uint8_t buf[1500];
     sockaddr_in src{};
     socklen_t srclen = sizeof(src);
@@ -1,12 +1,15 @@
 #include "menu_renderer.h"
 
 #include "imgui.h"
+#include "logger.h"
+#include "process_runner.h"
 #include "video_mode.h"
 
 #include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <cstdio>
+#include <cfloat>
 #include <cmath>
 #include <sstream>
 #include <string>
@@ -56,6 +59,19 @@ static MenuRenderer::TelemetryData BuildMockTelemetry(const MenuState &state)
     {
         ground_cache.ground_signal_a = -60.0f + 5.0f * std::sin(t * 0.8f);
         ground_cache.ground_signal_b = -62.0f + 6.0f * std::cos(t * 0.65f);
+        ground_cache.ground_antennas.clear();
+        for (int i = 0; i < 4; ++i)
+        {
+            MenuRenderer::GroundAntenna ant;
+            ant.card = i / 2;
+            ant.chain = i % 2;
+            ant.rssi_avg = static_cast<int>(-58.0f - 4.0f * i + 5.0f * std::sin(t * 0.7f + i));
+            ant.rssi_min = ant.rssi_avg - 4;
+            ant.rssi_max = ant.rssi_avg + 3;
+            ant.snr_avg = ant.rssi_avg + 85;
+            ant.packet_share = 0.25f + 0.1f * std::sin(t * 0.5f + i * 1.6f);
+            ground_cache.ground_antennas.push_back(ant);
+        }
         ground_cache.ground_temp_c = ReadTemperatureC();
 
         const auto &ground_modes = state.GroundModes();
@@ -76,20 +92,52 @@ static MenuRenderer::TelemetryData BuildMockTelemetry(const MenuState &state)
         int fps = cached_fps;
         ground_cache.video_refresh_hz = fps > 0 ? fps : (mode.refresh ? mode.refresh : 60);
         ground_cache.bitrate_mbps = std::max(1.0f, 6.0f + 2.0f * std::sin(t * 0.4f));
+        ground_cache.has_link_stats = true;
+        ground_cache.link_loss_percent = std::max(0.0f, 0.6f * std::sin(t * 0.3f));
+        ground_cache.link_fec_percent = 3.0f + 2.0f * std::sin(t * 0.45f);
+        ground_cache.has_video_health = true;
+        ground_cache.video_input_fps = ground_cache.video_refresh_hz;
+        ground_cache.video_output_fps = ground_cache.video_refresh_hz;
+        ground_cache.video_drops_per_s = std::max(0.0f, 2.0f * std::sin(t * 0.2f) - 1.5f);
+        ground_cache.video_buffer_percent = 30.0f + 10.0f * std::sin(t * 0.6f);
+        ground_cache.video_display_queue = 2;
 
         last_ground_sample = now_tp;
     }
 
     data.ground_signal_a = ground_cache.ground_signal_a;
     data.ground_signal_b = ground_cache.ground_signal_b;
+    data.ground_antennas = ground_cache.ground_antennas;
     data.ground_temp_c = ground_cache.ground_temp_c;
     data.video_resolution = ground_cache.video_resolution;
     data.video_refresh_hz = ground_cache.video_refresh_hz;
     data.bitrate_mbps = ground_cache.bitrate_mbps;
+    data.has_link_stats = ground_cache.has_link_stats;
+    data.link_loss_percent = ground_cache.link_loss_percent;
+    data.link_fec_percent = ground_cache.link_fec_percent;
+    data.has_video_health = ground_cache.has_video_health;
+    data.video_input_fps = ground_cache.video_input_fps;
+    data.video_output_fps = ground_cache.video_output_fps;
+    data.video_drops_per_s = ground_cache.video_drops_per_s;
+    data.video_errors_per_s = ground_cache.video_errors_per_s;
+    data.video_buffer_percent = ground_cache.video_buffer_percent;
+    data.video_display_queue = ground_cache.video_display_queue;
 
     return data;
 }
 
+// Runs a power/session action before the menu exits. These are the last
+// thing the app does, so they run inline, bounded by a timeout.
+static void RunExitAction(const char *command)
+{
+    const ProcessResult result = RunShellCommand(command, std::chrono::seconds(15));
+    if (!result.Succeeded())
+    {
+        LOG_WARN("Menu", "'%s' failed (exit=%d signal=%d timed_out=%d): %s", command, result.exit_code,
+                 result.signal, result.timed_out ? 1 : 0, result.output.c_str());
+    }
+}
+
 MenuRenderer::MenuRenderer(MenuState &state, bool &use_mock, std::function<TelemetryData(TelemetryData)> provider,
                            std::function<void()> toggle_terminal,
                            std::function<bool()> terminal_visible)
@@ -198,13 +246,35 @@ MenuRenderer::~MenuRenderer()
     }
 }
 
+void MenuRenderer::SetTelemetrySequence(std::function<uint64_t()> sequence)
+{
+    telemetry_sequence_ = std::move(sequence);
+}
+
+void MenuRenderer::SetRefreshInterval(std::chrono::milliseconds interval)
+{
+    refresh_interval_ = interval;
+}
+
 void MenuRenderer::Render(bool &running_flag)
 {
     const ImGuiViewport *viewport = ImGui::GetMainViewport();
     auto now_tp = std::chrono::steady_clock::now();
+    const auto since_refresh = std::chrono::duration_cast<std::chrono::milliseconds>(now_tp - last_osd_tp_);
     bool need_refresh = (last_osd_update_time_ < 0.0f ||
                          last_osd_tp_.time_since_epoch().count() == 0 ||
-                         std::chrono::duration_cast<std::chrono::milliseconds>(now_tp - last_osd_tp_).count() >= 100);
+                         since_refresh >= std::max(std::chrono::milliseconds(100), refresh_interval_));
+    if (!use_mock_ && telemetry_sequence_)
+    {
+        // Ground sources push updates; show them on the next frame unless the
+        // thermal policy asked for a longer refresh interval.
+        const uint64_t sequence = telemetry_sequence_();
+        if (sequence != last_telemetry_sequence_ && since_refresh >= refresh_interval_)
+        {
+            last_telemetry_sequence_ = sequence;
+            need_refresh = true;
+        }
+    }
     if (need_refresh)
     {
         TelemetryData new_data = cached_telemetry_;
@@ -216,23 +286,6 @@ void MenuRenderer::Render(bool &running_flag)
         else if (telemetry_provider_)
         {
             new_data = telemetry_provider_(cached_telemetry_);
-
-            static auto last_ground_sample = std::chrono::steady_clock::time_point{};
-            auto ms_ground = std::chrono::duration_cast<std::chrono::milliseconds>(now_tp - last_ground_sample).count();
-            const bool update_ground = (last_ground_sample.time_since_epoch().count() == 0 || ms_ground >= 1000);
-            if (!update_ground)
-            {
-                new_data.ground_signal_a = cached_telemetry_.ground_signal_a;
-                new_data.ground_signal_b = cached_telemetry_.ground_signal_b;
-                new_data.ground_temp_c = cached_telemetry_.ground_temp_c;
-                new_data.video_refresh_hz = cached_telemetry_.video_refresh_hz;
-                new_data.video_resolution = cached_telemetry_.video_resolution;
-                new_data.bitrate_mbps = cached_telemetry_.bitrate_mbps;
-            }
-            else
-            {
-                last_ground_sample = now_tp;
-            }
             bool any = new_data.has_attitude || new_data.has_gps || new_data.has_battery ||
                        new_data.has_rc_signal || new_data.has_sky_temp || new_data.has_flight_mode;
             if (any)
@@ -364,6 +417,62 @@ void MenuRenderer::DrawOsd(const ImGuiViewport *viewport, const TelemetryData &d
         signal_block_bottom = viewport->Pos.y + viewport->Size.y * 0.05f + ImGui::GetFontSize() * 1.2f;
     }
 
+    if (!data.ground_antennas.empty())
+    {
+        // Diversity widget: one row per ground antenna with an RSSI bar, SNR and
+        // the antenna's share of received packets over the stats window.
+        const float small = ImGui::GetFontSize() * 0.8f;
+        const float row_h = small * 1.25f;
+        const float bar_w = small * 5.0f;
+        const float bar_h = small * 0.6f;
+        const char *label_fmt = is_cn ? "\u5929\u7ebf%d.%d" : "ANT %d.%d";
+        float widest = 0.0f;
+        for (const auto &ant : data.ground_antennas)
+        {
+            char label[32];
+            snprintf(label, sizeof(label), label_fmt, ant.card, ant.chain);
+            widest = std::max(widest, ImGui::GetFont()->CalcTextSizeA(small, FLT_MAX, 0.0f, label).x);
+        }
+        const float stats_w = ImGui::GetFont()->CalcTextSizeA(small, FLT_MAX, 0.0f, "-100dBm  99dB  100%").x;
+        const float gap = small * 0.5f;
+        const float total_w = widest + gap + bar_w + gap + stats_w;
+        float y = signal_block_bottom + small * 0.2f;
+        for (const auto &ant : data.ground_antennas)
+        {
+            float x = center.x - total_w * 0.5f;
+            char label[32];
+            snprintf(label, sizeof(label), label_fmt, ant.card, ant.chain);
+            draw_list->AddText(ImGui::GetFont(), small, ImVec2(x + 1, y + 1), text_outline, label);
+            draw_list->AddText(ImGui::GetFont(), small, ImVec2(x, y), text_fill, label);
+            x += widest + gap;
+
+            // Bar spans -100..-30 dBm; the thin tick marks the window minimum.
+            auto rssi_frac = [](int dbm)
+            {
+                return std::clamp((static_cast<float>(dbm) + 100.0f) / 70.0f, 0.0f, 1.0f);
+            };
+            const float frac = rssi_frac(ant.rssi_avg);
+            const ImU32 bar_col = frac > 0.5f   ? IM_COL32(90, 210, 120, 230)
+                                  : frac > 0.25f ? IM_COL32(230, 200, 80, 230)
+                                                 : IM_COL32(230, 90, 80, 230);
+            const ImVec2 bar_min(x, y + (small - bar_h) * 0.5f);
+            const ImVec2 bar_max(x + bar_w, bar_min.y + bar_h);
+            draw_list->AddRectFilled(bar_min, bar_max, IM_COL32(0, 0, 0, 140), 2.0f);
+            draw_list->AddRectFilled(bar_min, ImVec2(x + bar_w * frac, bar_max.y), bar_col, 2.0f);
+            const float min_x = x + bar_w * rssi_frac(ant.rssi_min);
+            draw_list->AddLine(ImVec2(min_x, bar_min.y - 1.0f), ImVec2(min_x, bar_max.y + 1.0f), text_outline, 1.5f);
+            x += bar_w + gap;
+
+            char stats[48];
+            snprintf(stats, sizeof(stats), "%ddBm  %ddB  %.0f%%", ant.rssi_avg, ant.snr_avg,
+                     ant.packet_share * 100.0f);
+            draw_list->AddText(ImGui::GetFont(), small, ImVec2(x + 1, y + 1), text_outline, stats);
+            draw_list->AddText(ImGui::GetFont(), small, ImVec2(x, y), text_fill, stats);
+            y += row_h;
+        }
+        signal_block_bottom = y;
+    }
+
     if (data.has_flight_mode)
     {
         ImFont *font = ImGui::GetFont();
@@ -447,6 +556,38 @@ void MenuRenderer::DrawOsd(const ImGuiViewport *viewport, const TelemetryData &d
                      data.bitrate_mbps, data.video_resolution.c_str(), data.video_refresh_hz);
         }
         icon_text_line(video_buf, icon_monitor_);
+        if (data.has_link_stats)
+        {
+            char link_buf[96];
+            snprintf(link_buf, sizeof(link_buf), is_cn ? "\u4e22\u5305: %.1f%%  FEC\u6062\u590d: %.1f%%" : "Loss: %.1f%%  FEC: %.1f%%",
+                     data.link_loss_percent, data.link_fec_percent);
+            icon_text_line(link_buf, icon_antenna_);
+        }
+        if (data.has_video_health)
+        {
+            char health_buf[128];
+            int len = snprintf(health_buf, sizeof(health_buf),
+                               is_cn ? "\u89e3\u7801: %d/%d fps  \u4e22\u5e27 %.1f/s  \u9519\u8bef %.1f/s"
+                                     : "Decode: %d/%d fps  drop %.1f/s  err %.1f/s",
+                               data.video_output_fps, data.video_input_fps, data.video_drops_per_s,
+                               data.video_errors_per_s);
+            if (data.video_buffer_percent >= 0.0f && len > 0 && static_cast<size_t>(len) < sizeof(health_buf))
+            {
+                len += snprintf(health_buf + len, sizeof(health_buf) - len, is_cn ? "  \u7f13\u51b2 %.0f%%" : "  buf %.0f%%",
+                                data.video_buffer_percent);
+            }
+            if (data.video_display_queue >= 0 && len > 0 && static_cast<size_t>(len) < sizeof(health_buf))
+            {
+                snprintf(health_buf + len, sizeof(health_buf) - len, is_cn ? "  \u961f\u5217 %d" : "  queue %d",
+                         data.video_display_queue);
+            }
+            // Amber when frames are being lost or output falls behind input.
+            const bool degraded = data.video_drops_per_s > 0.0f || data.video_errors_per_s > 0.0f ||
+                                  (data.video_input_fps > 0 && data.video_output_fps * 10 < data.video_input_fps * 9);
+            ImGui::PushStyleColor(ImGuiCol_Text, degraded ? IM_COL32(255, 190, 70, 255) : text_fill);
+            icon_text_line(health_buf, icon_monitor_);
+            ImGui::PopStyleColor();
+        }
         ImGui::PopStyleColor();
     }
     ImGui::End();
@@ -475,6 +616,67 @@ void MenuRenderer::DrawOsd(const ImGuiViewport *viewport, const TelemetryData &d
         ImGui::End();
     }
 
+    if (data.has_diagnostics)
+    {
+        ImGui::SetNextWindowPos(ImVec2(viewport->Pos.x + 16.0f, viewport->Pos.y + 80.0f));
+        ImGui::SetNextWindowBgAlpha(0.0f);
+        if (ImGui::Begin("OSD_DIAG", nullptr, overlay_flags))
+        {
+            // Amber once the box, or any single core, is close to saturated.
+            bool saturated = data.cpu_percent >= 85.0f;
+            char cores[64] = "";
+            size_t used = 0;
+            for (float core : data.cpu_core_percent)
+            {
+                saturated = saturated || core >= 95.0f;
+                int n = snprintf(cores + used, sizeof(cores) - used, used ? " %.0f" : "%.0f", core);
+                if (n < 0 || static_cast<size_t>(n) >= sizeof(cores) - used)
+                    break;
+                used += static_cast<size_t>(n);
+            }
+            char cpu_buf[96];
+            snprintf(cpu_buf, sizeof(cpu_buf), "CPU: %.0f%%  [%s]", data.cpu_percent, cores);
+            ImGui::PushStyleColor(ImGuiCol_Text, saturated ? IM_COL32(255, 190, 70, 255) : text_fill);
+            ImGui::TextUnformatted(cpu_buf);
+            ImGui::PopStyleColor();
+
+            ImGui::PushStyleColor(ImGuiCol_Text, text_fill);
+            char mem_buf[64];
+            snprintf(mem_buf, sizeof(mem_buf), is_cn ? "\u5185\u5b58: %d / %d MB" : "RAM: %d / %d MB",
+                     data.mem_total_mb - data.mem_available_mb, data.mem_total_mb);
+            ImGui::TextUnformatted(mem_buf);
+            char self_buf[64];
+            snprintf(self_buf, sizeof(self_buf), is_cn ? "\u83dc\u5355: %.0f%% CPU  %.0f MB" : "Menu: %.0f%% CPU  %.0f MB",
+                     data.self_cpu_percent, data.self_rss_mb);
+            ImGui::TextUnformatted(self_buf);
+            if (!data.top_thread.empty())
+            {
+                char top_buf[64];
+                snprintf(top_buf, sizeof(top_buf), is_cn ? "\u6700\u5fd9\u7ebf\u7a0b: %s %.0f%%" : "Top thread: %s %.0f%%",
+                         data.top_thread.c_str(), data.top_thread_percent);
+                ImGui::TextUnformatted(top_buf);
+            }
+            char lane_buf[96];
+            snprintf(lane_buf, sizeof(lane_buf),
+                     is_cn ? "\u672c\u5730\u547d\u4ee4: %d \u6392\u961f  %llu \u4e22\u5f03"
+                           : "Local cmds: %d queued  %llu dropped",
+                     data.local_commands_queued, static_cast<unsigned long long>(data.local_commands_dropped));
+            ImGui::TextUnformatted(lane_buf);
+            snprintf(lane_buf, sizeof(lane_buf),
+                     is_cn ? "\u5929\u7a7a\u7aef\u547d\u4ee4: %d \u6392\u961f  %llu \u4e22\u5f03"
+                           : "Sky cmds: %d queued  %llu dropped",
+                     data.remote_commands_queued, static_cast<unsigned long long>(data.remote_commands_dropped));
+            ImGui::TextUnformatted(lane_buf);
+            char coalesced_buf[64];
+            snprintf(coalesced_buf, sizeof(coalesced_buf),
+                     is_cn ? "\u5408\u5e76\u547d\u4ee4: %llu" : "Coalesced cmds: %llu",
+                     static_cast<unsigned long long>(data.commands_coalesced));
+            ImGui::TextUnformatted(coalesced_buf);
+            ImGui::PopStyleColor();
+        }
+        ImGui::End();
+    }
+
     if (data.has_battery)
     {
         ImGui::SetNextWindowPos(ImVec2(viewport->Pos.x + 16.0f, center.y - 24.0f));
@@ -523,6 +725,18 @@ void MenuRenderer::DrawOsd(const ImGuiViewport *viewport, const TelemetryData &d
         snprintf(ground_buf, sizeof(ground_buf), is_cn ? "\u5730\u9762\u7aef\u6e29\u5ea6: %.1f\u2103" : "Ground Temp: %.1fC", data.ground_temp_c);
         icon_text_line(ground_buf, icon_temp_ground_);
         ImGui::PopStyleColor();
+        if (data.thermal_level > 0)
+        {
+            static const char *const kLevelEn[] = {"normal", "warm", "hot", "critical"};
+            static const char *const kLevelCn[] = {"\u6b63\u5e38", "\u504f\u70ed", "\u8fc7\u70ed", "\u5371\u9669"};
+            const int level = std::min(data.thermal_level, 3);
+            char thermal_buf[64];
+            snprintf(thermal_buf, sizeof(thermal_buf), is_cn ? "\u6e29\u63a7: %s  OSD %.0fHz" : "Thermal: %s  OSD %.0fHz",
+                     is_cn ? kLevelCn[level] : kLevelEn[level], data.osd_refresh_hz);
+            ImGui::PushStyleColor(ImGuiCol_Text, level >= 2 ? IM_COL32(255, 110, 90, 255) : IM_COL32(255, 190, 70, 255));
+            icon_text_line(thermal_buf, icon_temp_ground_);
+            ImGui::PopStyleColor();
+        }
     }
     ImGui::End();
 }
@@ -812,7 +1026,7 @@ void MenuRenderer::DrawMenu(const ImGuiViewport *viewport, bool &running_flag)
             }
             if (ImGui::Button(is_cn ? "\u542f\u52a8\u5230\u5b89\u5353" : "Boot to Android", ImVec2(-1, 0)))
             {
-                std::system("/sbin/rebootfromnand;reboot");
+                RunExitAction("/sbin/rebootfromnand;reboot");
                 running_flag = false;
             }
             if (ImGui::IsItemFocused())
@@ -1002,7 +1216,7 @@ void MenuRenderer::DrawMenu(const ImGuiViewport *viewport, bool &running_flag)
             });
 
             render_popup_button(1, is_cn ? "\u786e\u8ba4" : "Confirm", [&]() {
-                std::system("bash -lc 'systemctl stop amldigitalfpv || true; systemctl start kodi2'"); // restart kodi and exit
+                RunExitAction("bash -lc 'systemctl stop amldigitalfpv || true; systemctl start kodi2'"); // restart kodi and exit
                 running_flag = false;
                 ImGui::CloseCurrentPopup();
                 kodi_popup_focus_index_ = 0;
@@ -12,10 +12,22 @@
 class MenuRenderer
 {
 public:
+    struct GroundAntenna
+    {
+        int card = 0;
+        int chain = 0;
+        int rssi_min = 0;
+        int rssi_avg = 0;
+        int rssi_max = 0;
+        int snr_avg = 0;
+        float packet_share = 0.0f; // fraction of all antennas' packets over the window
+    };
+
     struct TelemetryData
     {
         float ground_signal_a = 0.0f;
         float ground_signal_b = 0.0f;
+        std::vector<GroundAntenna> ground_antennas;
         float rc_signal = 0.0f;
         bool has_rc_signal = false;
         bool has_flight_mode = false;
@@ -29,6 +41,18 @@ public:
         float altitude_m = 0.0f;
         float home_distance_m = 0.0f;
         float bitrate_mbps = 0.0f;
+        float link_loss_percent = 0.0f;
+        float link_fec_percent = 0.0f;
+        bool has_link_stats = false;
+        // Decoder health from the vdec/video sysfs counters. Buffer fill and the
+        // display queue are negative when the driver does not report them.
+        bool has_video_health = false;
+        int video_input_fps = 0;
+        int video_output_fps = 0;
+        float video_drops_per_s = 0.0f;
+        float video_errors_per_s = 0.0f;
+        float video_buffer_percent = -1.0f;
+        int video_display_queue = -1;
         std::string video_resolution;
         int video_refresh_hz = 0;
         float cell_voltage = 0.0f;
@@ -39,6 +63,27 @@ public:
         float pitch_deg = 0.0f;
         float ground_batt_percent = 0.0f;
         bool has_ground_batt = false;
+        // Ground box load, shown when osd_diagnostics is enabled. Process and
+        // thread CPU are relative to one core.
+        bool has_diagnostics = false;
+        float cpu_percent = 0.0f;
+        std::vector<float> cpu_core_percent;
+        int mem_total_mb = 0;
+        int mem_available_mb = 0;
+        float self_cpu_percent = 0.0f;
+        float self_rss_mb = 0.0f;
+        std::string top_thread;
+        float top_thread_percent = 0.0f;
+        // Command executor lanes: jobs waiting now, jobs dropped since start,
+        // and setting changes replaced by a newer value before they were sent.
+        int local_commands_queued = 0;
+        int remote_commands_queued = 0;
+        uint64_t local_commands_dropped = 0;
+        uint64_t remote_commands_dropped = 0;
+        uint64_t commands_coalesced = 0;
+        // ThermalLevel of the ground box; above 0 AMLgsMenu is shedding load.
+        int thermal_level = 0;
+        float osd_refresh_hz = 0.0f;
     };
 
     MenuRenderer(MenuState &state, bool &use_mock, std::function<TelemetryData(TelemetryData)> provider,
@@ -46,6 +91,12 @@ public:
     ~MenuRenderer();
 
     void Render(bool &running_flag);
+    // Optional change counter for the live provider. When it moves, the OSD
+    // refreshes on the next frame instead of waiting for the periodic poll.
+    void SetTelemetrySequence(std::function<uint64_t()> sequence);
+    // Minimum spacing between OSD telemetry refreshes, raised by the thermal
+    // policy; zero lets every sequence change through.
+    void SetRefreshInterval(std::chrono::milliseconds interval);
 
 private:
     void DrawOsd(const ImGuiViewport *viewport, const TelemetryData &data) const;
@@ -56,6 +107,9 @@ private:
     // Application &application_;
     bool use_mock_ = true;
     std::function<TelemetryData(TelemetryData)> telemetry_provider_;
+    std::function<uint64_t()> telemetry_sequence_;
+    uint64_t last_telemetry_sequence_ = 0;
+    std::chrono::milliseconds refresh_interval_{0};
     TelemetryData cached_telemetry_{};
     float last_osd_update_time_ = -1.0f;
     std::chrono::steady_clock::time_point last_osd_tp_{};
@@ -0,0 +1,409 @@
+#include "nl80211_client.h"
+
+#include "logger.h"
+
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace
+{
+constexpr size_t kReceiveBufferSize = 32768;
+
+void PutAttr(std::vector<char> &buf, uint16_t type, const void *data, size_t len)
+{
+    nlattr hdr{};
+    hdr.nla_len = static_cast<uint16_t>(NLA_HDRLEN + len);
+    hdr.nla_type = type;
+    const size_t offset = buf.size();
+    buf.resize(offset + NLA_ALIGN(hdr.nla_len), 0);
+    std::memcpy(&buf[offset], &hdr, sizeof(hdr));
+    std::memcpy(&buf[offset + NLA_HDRLEN], data, len);
+}
+
+void PutU32(std::vector<char> &buf, uint16_t type, uint32_t value)
+{
+    PutAttr(buf, type, &value, sizeof(value));
+}
+
+void PutString(std::vector<char> &buf, uint16_t type, const char *value)
+{
+    PutAttr(buf, type, value, std::strlen(value) + 1);
+}
+
+template <typename T>
+T ReadScalar(const char *data, size_t len)
+{
+    T value = 0;
+    if (len >= sizeof(T))
+        std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+std::string ReadString(const char *data, size_t len)
+{
+    return std::string(data, strnlen(data, len));
+}
+
+// Calls fn(type, payload, payload_len) for every attribute in the stream.
+template <typename Fn>
+void ForEachAttr(const char *data, size_t len, Fn fn)
+{
+    while (len >= NLA_HDRLEN)
+    {
+        nlattr hdr;
+        std::memcpy(&hdr, data, sizeof(hdr));
+        if (hdr.nla_len < NLA_HDRLEN || hdr.nla_len > len)
+            return;
+        fn(static_cast<uint16_t>(hdr.nla_type & NLA_TYPE_MASK), data + NLA_HDRLEN, hdr.nla_len - NLA_HDRLEN);
+        const size_t step = NLA_ALIGN(hdr.nla_len);
+        if (step >= len)
+            return;
+        data += step;
+        len -= step;
+    }
+}
+
+// Looks up a multicast group id in a CTRL_ATTR_MCAST_GROUPS attribute.
+uint32_t FindGroup(const char *groups, size_t len, const char *wanted)
+{
+    uint32_t found = 0;
+    ForEachAttr(groups, len, [&](uint16_t, const char *group, size_t group_len)
+                {
+                    std::string name;
+                    uint32_t id = 0;
+                    ForEachAttr(group, group_len, [&](uint16_t type, const char *value, size_t value_len)
+                                {
+                                    if (type == CTRL_ATTR_MCAST_GRP_NAME)
+                                        name = ReadString(value, value_len);
+                                    else if (type == CTRL_ATTR_MCAST_GRP_ID)
+                                        id = ReadScalar<uint32_t>(value, value_len);
+                                });
+                    if (name == wanted)
+                        found = id;
+                });
+    return found;
+}
+
+bool IsInterfaceChange(uint8_t cmd)
+{
+    switch (cmd)
+    {
+    case NL80211_CMD_NEW_INTERFACE:
+    case NL80211_CMD_DEL_INTERFACE:
+    case NL80211_CMD_SET_INTERFACE:
+    case NL80211_CMD_NEW_WIPHY:
+    case NL80211_CMD_DEL_WIPHY:
+        return true;
+    default:
+        return false;
+    }
+}
+} // namespace
+
+Nl80211Client::~Nl80211Client()
+{
+    Close();
+}
+
+void Nl80211Client::Close()
+{
+    if (fd_ >= 0)
+        close(fd_);
+    if (event_fd_ >= 0)
+        close(event_fd_);
+    fd_ = -1;
+    event_fd_ = -1;
+    family_ = 0;
+    interfaces_.clear();
+    interfaces_stale_ = true;
+}
+
+bool Nl80211Client::Open()
+{
+    Close();
+    const int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (fd < 0)
+    {
+        LOG_WARN("Nl80211", "socket: %s", std::strerror(errno));
+        return false;
+    }
+    uint32_t config_group = 0;
+    if (!Attach(fd, config_group))
+    {
+        LOG_INFO("Nl80211", "nl80211 not available, using iw templates");
+        return false;
+    }
+
+    if (config_group != 0)
+    {
+        event_fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_GENERIC);
+        if (event_fd_ >= 0 &&
+            setsockopt(event_fd_, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &config_group, sizeof(config_group)) != 0)
+        {
+            close(event_fd_);
+            event_fd_ = -1;
+        }
+    }
+    if (event_fd_ < 0)
+        LOG_WARN("Nl80211", "no interface notifications, enumerating on every change");
+    LOG_INFO("Nl80211", "using nl80211 (family %u) for local monitor interfaces", family_);
+    return true;
+}
+
+bool Nl80211Client::Open(int fd, int event_fd)
+{
+    uint32_t config_group = 0;
+    if (!Attach(fd, config_group))
+    {
+        if (event_fd >= 0)
+            close(event_fd);
+        return false;
+    }
+    event_fd_ = event_fd;
+    return true;
+}
+
+bool Nl80211Client::Attach(int fd, uint32_t &config_group)
+{
+    Close();
+    fd_ = fd;
+    // A reply never takes this long; it only keeps a lost one from wedging
+    // the local command lane.
+    timeval tv{1, 0};
+    setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (!ResolveFamily(config_group))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool Nl80211Client::ResolveFamily(uint32_t &config_group)
+{
+    std::vector<char> attrs;
+    PutString(attrs, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME);
+    uint16_t family = 0;
+    const bool ok = Transact(GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY, attrs,
+                             [&](const char *data, size_t len)
+                             {
+                                 ForEachAttr(data, len, [&](uint16_t type, const char *value, size_t value_len)
+                                             {
+                                                 if (type == CTRL_ATTR_FAMILY_ID)
+                                                     family = ReadScalar<uint16_t>(value, value_len);
+                                                 else if (type == CTRL_ATTR_MCAST_GROUPS)
+                                                     config_group = FindGroup(value, value_len, NL80211_MULTICAST_GROUP_CONFIG);
+                                             });
+                             });
+    if (!ok || family == 0)
+        return false;
+    family_ = family;
+    return true;
+}
+
+bool Nl80211Client::Transact(uint16_t type, uint16_t flags, uint8_t cmd, const std::vector<char> &attrs,
+                             const ReplyHandler &on_reply)
+{
+    const uint32_t seq = ++seq_;
+    nlmsghdr hdr{};
+    hdr.nlmsg_len = static_cast<uint32_t>(NLMSG_HDRLEN + GENL_HDRLEN + attrs.size());
+    hdr.nlmsg_type = type;
+    hdr.nlmsg_flags = static_cast<uint16_t>(NLM_F_REQUEST | NLM_F_ACK | flags);
+    hdr.nlmsg_seq = seq;
+    genlmsghdr genl{};
+    genl.cmd = cmd;
+    genl.version = 1;
+
+    std::vector<char> msg(NLMSG_HDRLEN + GENL_HDRLEN);
+    std::memcpy(msg.data(), &hdr, sizeof(hdr));
+    std::memcpy(msg.data() + NLMSG_HDRLEN, &genl, sizeof(genl));
+    msg.insert(msg.end(), attrs.begin(), attrs.end());
+
+    // An unaddressed netlink send goes to the kernel.
+    if (send(fd_, msg.data(), msg.size(), 0) < 0)
+    {
+        LOG_WARN("Nl80211", "send cmd %u: %s", cmd, std::strerror(errno));
+        return false;
+    }
+
+    std::vector<char> buf(kReceiveBufferSize);
+    while (true)
+    {
+        const ssize_t n = recv(fd_, buf.data(), buf.size(), 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG_WARN("Nl80211", "recv cmd %u: %s", cmd, std::strerror(errno));
+            return false;
+        }
+        int remaining = static_cast<int>(n);
+        for (auto *msg_hdr = reinterpret_cast<nlmsghdr *>(buf.data()); NLMSG_OK(msg_hdr, remaining);
+             msg_hdr = NLMSG_NEXT(msg_hdr, remaining))
+        {
+            if (msg_hdr->nlmsg_seq != seq)
+                continue;
+            if (msg_hdr->nlmsg_type == NLMSG_DONE)
+                return true;
+            if (msg_hdr->nlmsg_type == NLMSG_ERROR)
+            {
+                if (msg_hdr->nlmsg_len < NLMSG_LENGTH(sizeof(nlmsgerr)))
+                    return false;
+                const auto *err = reinterpret_cast<const nlmsgerr *>(NLMSG_DATA(msg_hdr));
+                if (err->error == 0)
+                    return true;
+                LOG_DEBUG("Nl80211", "cmd %u: %s", cmd, std::strerror(-err->error));
+                return false;
+            }
+            if (on_reply && msg_hdr->nlmsg_len >= NLMSG_LENGTH(GENL_HDRLEN))
+            {
+                const char *payload = static_cast<const char *>(NLMSG_DATA(msg_hdr)) + GENL_HDRLEN;
+                on_reply(payload, msg_hdr->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN));
+            }
+        }
+    }
+}
+
+void Nl80211Client::DrainNotifications()
+{
+    if (event_fd_ < 0)
+    {
+        interfaces_stale_ = true;
+        return;
+    }
+    char buf[8192];
+    while (true)
+    {
+        const ssize_t n = recv(event_fd_, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // Notifications were lost; the cached list can't be trusted.
+            if (errno == ENOBUFS)
+            {
+                interfaces_stale_ = true;
+                continue;
+            }
+            return;
+        }
+        int remaining = static_cast<int>(n);
+        for (auto *msg_hdr = reinterpret_cast<nlmsghdr *>(buf); NLMSG_OK(msg_hdr, remaining);
+             msg_hdr = NLMSG_NEXT(msg_hdr, remaining))
+        {
+            if (msg_hdr->nlmsg_type != family_ || msg_hdr->nlmsg_len < NLMSG_LENGTH(GENL_HDRLEN))
+                continue;
+            const auto *genl = reinterpret_cast<const genlmsghdr *>(NLMSG_DATA(msg_hdr));
+            if (IsInterfaceChange(genl->cmd))
+                interfaces_stale_ = true;
+        }
+    }
+}
+
+bool Nl80211Client::RefreshInterfaces()
+{
+    std::vector<Interface> found;
+    const bool ok = Transact(family_, NLM_F_DUMP, NL80211_CMD_GET_INTERFACE, {},
+                             [&](const char *data, size_t len)
+                             {
+                                 Interface iface;
+                                 uint32_t iftype = NL80211_IFTYPE_UNSPECIFIED;
+                                 ForEachAttr(data, len, [&](uint16_t type, const char *value, size_t value_len)
+                                             {
+                                                 if (type == NL80211_ATTR_IFINDEX)
+                                                     iface.ifindex = ReadScalar<uint32_t>(value, value_len);
+                                                 else if (type == NL80211_ATTR_IFNAME)
+                                                     iface.name = ReadString(value, value_len);
+                                                 else if (type == NL80211_ATTR_IFTYPE)
+                                                     iftype = ReadScalar<uint32_t>(value, value_len);
+                                             });
+                                 if (iftype == NL80211_IFTYPE_MONITOR && iface.ifindex != 0)
+                                     found.push_back(std::move(iface));
+                             });
+    if (!ok)
+        return false;
+    interfaces_ = std::move(found);
+    interfaces_stale_ = false;
+    for (const Interface &iface : interfaces_)
+        LOG_DEBUG("Nl80211", "monitor interface %s (ifindex %u)", iface.name.c_str(), iface.ifindex);
+    return true;
+}
+
+bool Nl80211Client::MonitorInterfaces(std::vector<Interface> &out)
+{
+    if (fd_ < 0)
+        return false;
+    DrainNotifications();
+    if (interfaces_stale_ && !RefreshInterfaces())
+        return false;
+    out = interfaces_;
+    return true;
+}
+
+bool Nl80211Client::ApplyToMonitors(const std::vector<char> &attrs, const char *what)
+{
+    std::vector<Interface> monitors;
+    if (!MonitorInterfaces(monitors))
+        return false;
+    bool ok = true;
+    for (const Interface &iface : monitors)
+    {
+        std::vector<char> request;
+        PutU32(request, NL80211_ATTR_IFINDEX, iface.ifindex);
+        request.insert(request.end(), attrs.begin(), attrs.end());
+        if (!Transact(family_, 0, NL80211_CMD_SET_WIPHY, request))
+        {
+            LOG_WARN("Nl80211", "%s: setting %s failed", iface.name.c_str(), what);
+            ok = false;
+        }
+    }
+    // The interface may have gone away without us hearing about it.
+    if (!ok)
+        interfaces_stale_ = true;
+    return ok;
+}
+
+bool Nl80211Client::SetMonitorChannel(int channel, int bandwidth_mhz)
+{
+    const uint32_t freq = ChannelToFrequency(channel);
+    if (freq == 0)
+    {
+        LOG_WARN("Nl80211", "unknown channel %d", channel);
+        return false;
+    }
+    uint32_t channel_type = NL80211_CHAN_NO_HT;
+    if (bandwidth_mhz >= 40)
+        channel_type = NL80211_CHAN_HT40PLUS;
+    else if (bandwidth_mhz == 20)
+        channel_type = NL80211_CHAN_HT20;
+    std::vector<char> attrs;
+    PutU32(attrs, NL80211_ATTR_WIPHY_FREQ, freq);
+    PutU32(attrs, NL80211_ATTR_WIPHY_CHANNEL_TYPE, channel_type);
+    return ApplyToMonitors(attrs, "channel");
+}
+
+bool Nl80211Client::SetMonitorTxPower(int mbm)
+{
+    std::vector<char> attrs;
+    PutU32(attrs, NL80211_ATTR_WIPHY_TX_POWER_SETTING, NL80211_TX_POWER_FIXED);
+    PutU32(attrs, NL80211_ATTR_WIPHY_TX_POWER_LEVEL, static_cast<uint32_t>(mbm));
+    return ApplyToMonitors(attrs, "txpower");
+}
+
+uint32_t Nl80211Client::ChannelToFrequency(int channel)
+{
+    if (channel >= 1 && channel <= 13)
+        return 2407 + 5 * static_cast<uint32_t>(channel);
+    if (channel == 14)
+        return 2484;
+    if (channel >= 32 && channel <= 177)
+        return 5000 + 5 * static_cast<uint32_t>(channel);
+    return 0;
+}
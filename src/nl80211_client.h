@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Retunes the local monitor interfaces over a generic netlink socket instead
+// of running iw. Monitor interfaces are enumerated once and again only after
+// the kernel announces an interface change on the nl80211 "config" group.
+// Not thread-safe; Application only uses it from the local command lane.
+class Nl80211Client
+{
+public:
+    struct Interface
+    {
+        uint32_t ifindex = 0;
+        std::string name;
+    };
+
+    Nl80211Client() = default;
+    ~Nl80211Client();
+    Nl80211Client(const Nl80211Client &) = delete;
+    Nl80211Client &operator=(const Nl80211Client &) = delete;
+
+    // Resolves the nl80211 family and subscribes to interface changes.
+    // Returns false when the kernel offers no nl80211.
+    bool Open();
+    // Same over sockets the caller already has, e.g. one end of a socketpair
+    // standing in for the kernel. Takes ownership of both. fd carries the
+    // requests; event_fd, if given, receives "config" group notifications.
+    // Without it the interfaces are enumerated again before every change.
+    bool Open(int fd, int event_fd = -1);
+    bool IsOpen() const { return fd_ >= 0; }
+
+    bool MonitorInterfaces(std::vector<Interface> &out);
+    // Same effect as "iw dev <if> set channel <n> [HT20|HT40+]" on every
+    // monitor interface; bandwidths below 20 MHz use no HT.
+    bool SetMonitorChannel(int channel, int bandwidth_mhz);
+    // Same effect as "iw dev <if> set txpower fixed <mbm>".
+    bool SetMonitorTxPower(int mbm);
+
+    // 2.4 and 5 GHz channel numbers; 0 for anything else.
+    static uint32_t ChannelToFrequency(int channel);
+
+private:
+    // Receives the attributes of one reply message.
+    using ReplyHandler = std::function<void(const char *attrs, size_t len)>;
+
+    void Close();
+    // Adopts fd as the request socket and resolves the family over it.
+    bool Attach(int fd, uint32_t &config_group);
+    bool ResolveFamily(uint32_t &config_group);
+    bool RefreshInterfaces();
+    void DrainNotifications();
+    bool ApplyToMonitors(const std::vector<char> &attrs, const char *what);
+    // Sends one request and hands every reply to on_reply until the kernel
+    // acks, finishes the dump or reports an error.
+    bool Transact(uint16_t type, uint16_t flags, uint8_t cmd, const std::vector<char> &attrs,
+                  const ReplyHandler &on_reply = nullptr);
+
+    int fd_ = -1;
+    int event_fd_ = -1;
+    uint16_t family_ = 0;
+    uint32_t seq_ = 0;
+    bool interfaces_stale_ = true;
+    std::vector<Interface> interfaces_;
+};
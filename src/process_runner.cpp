@@ -0,0 +1,189 @@
+#include "process_runner.h"
+
+#include "logger.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+extern char **environ;
+
+namespace
+{
+// Time between SIGTERM and SIGKILL for a command past its deadline.
+constexpr auto kKillGrace = std::chrono::milliseconds(200);
+constexpr auto kReapPoll = std::chrono::milliseconds(10);
+
+int RemainingMs(std::chrono::steady_clock::time_point deadline)
+{
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return static_cast<int>(std::max<std::chrono::milliseconds::rep>(0, left.count()));
+}
+
+// SIGTERM to the process group, then SIGKILL once the leader has exited or
+// the grace period is over. The leader is not reaped in between, so the
+// group id cannot have been reused when SIGKILL is sent.
+void KillGroup(pid_t pid)
+{
+    kill(-pid, SIGTERM);
+    const auto grace_end = std::chrono::steady_clock::now() + kKillGrace;
+    while (std::chrono::steady_clock::now() < grace_end)
+    {
+        siginfo_t info{};
+        if (waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid)
+            break;
+        std::this_thread::sleep_for(kReapPoll);
+    }
+    kill(-pid, SIGKILL);
+}
+
+enum class ReapResult
+{
+    Reaped,
+    DeadlinePassed,
+    Failed, // errno holds the waitpid error
+};
+
+// Polls waitpid until the child is reaped or the deadline passes.
+ReapResult ReapBefore(pid_t pid, int &status, std::chrono::steady_clock::time_point deadline)
+{
+    while (true)
+    {
+        const pid_t rc = waitpid(pid, &status, WNOHANG);
+        if (rc == pid)
+            return ReapResult::Reaped;
+        if (rc < 0 && errno != EINTR)
+            return ReapResult::Failed;
+        if (std::chrono::steady_clock::now() >= deadline)
+            return ReapResult::DeadlinePassed;
+        std::this_thread::sleep_for(kReapPoll);
+    }
+}
+
+// Blocking waitpid; returns 0 or the errno that stopped it.
+int Reap(pid_t pid, int &status)
+{
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+            return errno;
+    }
+    return 0;
+}
+} // namespace
+
+ProcessResult RunShellCommand(const std::string &command, std::chrono::milliseconds timeout, size_t max_output)
+{
+    ProcessResult result;
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + timeout;
+
+    int out_pipe[2];
+    if (pipe2(out_pipe, O_CLOEXEC) != 0)
+    {
+        LOG_ERROR("ProcessRunner", "pipe2: %s", std::strerror(errno));
+        return result;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDERR_FILENO);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    posix_spawnattr_setsigmask(&attr, &empty_mask);
+    // Handlers installed here (SIGUSR1/2 for the logger) and ignored signals
+    // must not leak into the command.
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    for (int sig : {SIGPIPE, SIGCHLD, SIGINT, SIGTERM, SIGHUP, SIGUSR1, SIGUSR2})
+        sigaddset(&default_signals, sig);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    posix_spawnattr_setpgroup(&attr, 0);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP;
+#ifdef POSIX_SPAWN_USEVFORK
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    char sh[] = "/bin/sh";
+    char dash_c[] = "-c";
+    std::string command_copy = command;
+    char *argv[] = {sh, dash_c, command_copy.data(), nullptr};
+    pid_t pid = -1;
+    const int spawn_rc = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(out_pipe[1]);
+    if (spawn_rc != 0)
+    {
+        LOG_ERROR("ProcessRunner", "posix_spawn: %s", std::strerror(spawn_rc));
+        close(out_pipe[0]);
+        return result;
+    }
+    result.started = true;
+
+    // Read until every writer closed the pipe or the deadline passes.
+    char buffer[512];
+    while (true)
+    {
+        const int wait_ms = RemainingMs(deadline);
+        if (wait_ms <= 0)
+        {
+            result.timed_out = true;
+            break;
+        }
+        pollfd pfd{out_pipe[0], POLLIN, 0};
+        const int pr = poll(&pfd, 1, wait_ms);
+        if (pr < 0 && errno == EINTR)
+            continue;
+        if (pr <= 0)
+        {
+            result.timed_out = pr == 0;
+            break;
+        }
+        const ssize_t n = read(out_pipe[0], buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        const size_t room = max_output - std::min(max_output, result.output.size());
+        result.output.append(buffer, std::min(room, static_cast<size_t>(n)));
+    }
+    close(out_pipe[0]);
+
+    int status = 0;
+    const ReapResult reaped = result.timed_out ? ReapResult::DeadlinePassed : ReapBefore(pid, status, deadline);
+    if (reaped == ReapResult::Failed)
+    {
+        result.wait_error = errno;
+    }
+    else if (reaped == ReapResult::DeadlinePassed)
+    {
+        result.timed_out = true;
+        KillGroup(pid);
+        result.wait_error = Reap(pid, status);
+    }
+
+    if (result.wait_error != 0)
+        LOG_ERROR("ProcessRunner", "waitpid %d: %s", static_cast<int>(pid), std::strerror(result.wait_error));
+    else if (WIFEXITED(status))
+        result.exit_code = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        result.signal = WTERMSIG(status);
+    result.duration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+struct ProcessResult
+{
+    bool started = false;
+    bool timed_out = false;
+    // Exit status when the shell exited normally, -1 otherwise.
+    int exit_code = -1;
+    // Signal that terminated the shell, 0 if it exited.
+    int signal = 0;
+    // errno from waitpid when the exit status could not be collected (for
+    // example ECHILD when SIGCHLD is ignored); exit_code is then meaningless.
+    int wait_error = 0;
+    std::chrono::milliseconds duration{0};
+    // stdout and stderr interleaved, truncated to the requested size.
+    std::string output;
+
+    bool Succeeded() const { return started && !timed_out && wait_error == 0 && signal == 0 && exit_code == 0; }
+};
+
+// Runs command with /bin/sh -c through posix_spawn, so the child does not
+// copy this process's mappings the way fork() would. stdin is /dev/null and
+// signal handling is reset to defaults in the child. The shell gets its own
+// process group. Past timeout the whole group gets SIGTERM, then SIGKILL,
+// so pipelines and background children cannot outlive the deadline.
+ProcessResult RunShellCommand(const std::string &command, std::chrono::milliseconds timeout,
+                              size_t max_output = 4096);
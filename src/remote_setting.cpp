@@ -0,0 +1,55 @@
+#include "remote_setting.h"
+
+#include <string>
+
+const char *RemoteSettingParams(const MenuState &menu, MenuState::SettingType type, TemplateParams &params)
+{
+    switch (type)
+    {
+    case MenuState::SettingType::Channel:
+    {
+        const auto &chs = menu.Channels();
+        if (chs.empty())
+            return nullptr;
+        params.Set(TemplateVar::Channel, std::to_string(chs[menu.ChannelIndex()]));
+        return "channel";
+    }
+    case MenuState::SettingType::Bandwidth:
+    {
+        const int bw = (menu.BandwidthIndex() == 0) ? 10 : (menu.BandwidthIndex() == 1 ? 20 : 40);
+        params.Set(TemplateVar::Bandwidth, std::to_string(bw));
+        return "bandwidth";
+    }
+    case MenuState::SettingType::SkyMode:
+    {
+        const auto &sky_modes = menu.SkyModes();
+        if (sky_modes.empty())
+            return nullptr;
+        const VideoMode &mode = sky_modes[menu.SkyModeIndex()];
+        params.Set(TemplateVar::Width, std::to_string(mode.width))
+            .Set(TemplateVar::Height, std::to_string(mode.height))
+            .Set(TemplateVar::Fps, std::to_string(mode.refresh ? mode.refresh : 60));
+        return "sky_mode";
+    }
+    case MenuState::SettingType::Bitrate:
+    {
+        const auto &bitrates = menu.Bitrates();
+        if (bitrates.empty())
+            return nullptr;
+        // CLI expects kbps; e.g. 2 -> 2048
+        params.Set(TemplateVar::BitrateKbps, std::to_string(bitrates[menu.BitrateIndex()] * 1024));
+        return "bitrate";
+    }
+    case MenuState::SettingType::SkyPower:
+    {
+        const auto &powers = menu.PowerLevels();
+        if (powers.empty())
+            return nullptr;
+        const int p = powers[menu.SkyPowerIndex()];
+        params.Set(TemplateVar::Power, std::to_string(p)).Set(TemplateVar::TxPower, std::to_string(p * 50));
+        return "sky_power";
+    }
+    default:
+        return nullptr;
+    }
+}
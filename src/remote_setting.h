@@ -0,0 +1,9 @@
+#pragma once
+
+#include "command_templates.h"
+#include "menu_state.h"
+
+// Fills params from the menu's current selection for a setting that is sent
+// to the sky unit and returns its [remote] template key. Returns nullptr for
+// settings that stay on the ground or have nothing to select from.
+const char *RemoteSettingParams(const MenuState &menu, MenuState::SettingType type, TemplateParams &params);
@@ -1,21 +1,82 @@
 #include "signal_monitor.h"
 
-#include <cstdio>
+#include "logger.h"
+#include "wfb_log_parser.h"
+#include "wfb_stats_client.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
 #include <cstdlib>
 #include <cstring>
-#include <map>
-#include <stdexcept>
-#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
 
 namespace
 {
-const char *kJournalCmd = "journalctl -u wifibroadcast --since \"5 seconds ago\" --no-pager --output=export";
+const char *const kJournalArgv[] = {"journalctl", "-u", "wifibroadcast", "-f", "-n", "0",
+                                    "--no-pager", "--output=export", nullptr};
+constexpr std::chrono::seconds kRespawnMin{1};
+constexpr std::chrono::seconds kRespawnMax{16};
+constexpr std::chrono::seconds kAntennaStale{3};
+constexpr std::chrono::seconds kRateStale{3};
+constexpr size_t kMaxPending = 1 << 20;
+constexpr uint64_t kMaxBinaryField = 1 << 16;
+}
+
+SignalMonitor::SignalMonitor(Source source, std::string api_host, uint16_t api_port)
+    : source_(source)
+{
+    if (source_ == Source::WfbApi)
+        api_client_ = std::make_unique<WfbStatsClient>(std::move(api_host), api_port);
 }
 
-SignalMonitor::SignalMonitor() = default;
-bool SignalMonitor::Poll()
+SignalMonitor::~SignalMonitor()
 {
-    return UpdateSnapshot();
+    Stop();
+}
+
+void SignalMonitor::SetUpdateCallback(std::function<void()> callback)
+{
+    on_update_ = std::move(callback);
+}
+
+void SignalMonitor::Start()
+{
+    if (running_.exchange(true))
+        return;
+    if (pipe2(wake_fds_, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        LOG_ERROR("SignalMonitor", "pipe2: %s", std::strerror(errno));
+        wake_fds_[0] = wake_fds_[1] = -1;
+    }
+    worker_ = std::thread(&SignalMonitor::ThreadMain, this);
+}
+
+void SignalMonitor::Stop()
+{
+    if (!running_.exchange(false))
+        return;
+    if (wake_fds_[1] >= 0)
+    {
+        const char b = 1;
+        (void)!write(wake_fds_[1], &b, 1);
+    }
+    if (worker_.joinable())
+        worker_.join();
+    for (int &fd : wake_fds_)
+    {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
 }
 
 GroundSignalSnapshot SignalMonitor::Latest() const
@@ -30,213 +91,456 @@ PacketRateSnapshot SignalMonitor::LatestRate() const
     return latest_rate_;
 }
 
-bool SignalMonitor::UpdateSnapshot()
+void SignalMonitor::ThreadMain()
 {
-    FILE *pipe = popen(kJournalCmd, "r");
-    if (!pipe)
-    {
-        return false;
-    }
-
-    std::map<uint64_t, float> antenna_data;
-    uint64_t video_bytes = 0;
-    uint64_t first_ts = 0;
-    uint64_t last_ts = 0;
-    std::chrono::steady_clock::time_point log_ts = std::chrono::steady_clock::now();
-    char buffer[1024];
-    bool saw_pkt = false;
-
-    pid_t current_pid = -1;
-    std::string current_msg;
-    auto flush_entry = [&]() {
-        if (!current_msg.empty())
-        {
-            ProcessEntry(current_pid, current_msg, antenna_data, saw_pkt, video_bytes, first_ts, last_ts);
-        }
-        current_pid = -1;
-        current_msg.clear();
+    pthread_setname_np(pthread_self(), "signal");
+    auto backoff = kRespawnMin;
+    // Returns false when Stop() was requested during the wait.
+    auto wait_wake = [this](int timeout_ms) {
+        pollfd pfd{};
+        pfd.fd = wake_fds_[0];
+        pfd.events = POLLIN;
+        int pr = poll(&pfd, 1, timeout_ms);
+        return !(pr > 0 && (pfd.revents & POLLIN));
     };
 
-    while (fgets(buffer, sizeof(buffer), pipe))
+    int source_fd = -1;
+    while (running_)
     {
-        std::string line(buffer);
-        while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+        if (source_fd < 0)
         {
-            line.pop_back();
+            if (!OpenSource())
+            {
+                if (!wait_wake(static_cast<int>(std::chrono::milliseconds(backoff).count())))
+                    break;
+                backoff = std::min(backoff * 2, kRespawnMax);
+                continue;
+            }
+            source_fd = source_ == Source::WfbApi ? api_client_->Fd() : pipe_fd_;
         }
-        if (line.empty())
+
+        pollfd fds[2]{};
+        fds[0].fd = source_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wake_fds_[0];
+        fds[1].events = POLLIN;
+        int pr = poll(fds, 2, -1);
+        if (pr < 0)
         {
-            flush_entry();
-            continue;
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR("SignalMonitor", "poll: %s", std::strerror(errno));
+            break;
         }
+        if (fds[1].revents & POLLIN)
+            break;
+        if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
 
-        if (line.rfind("MESSAGE=", 0) == 0)
+        if (ReadSource())
         {
-            current_msg = line.substr(8);
+            backoff = kRespawnMin;
+            continue;
         }
-        else if (line.rfind("_PID=", 0) == 0)
+        LOG_WARN("SignalMonitor", "%s source closed, reconnecting in %llds",
+                 source_ == Source::WfbApi ? "stats API" : "journal", static_cast<long long>(backoff.count()));
+        CloseSource();
+        source_fd = -1;
+        if (!wait_wake(static_cast<int>(std::chrono::milliseconds(backoff).count())))
+            break;
+        backoff = std::min(backoff * 2, kRespawnMax);
+    }
+    CloseSource();
+}
+
+bool SignalMonitor::OpenSource()
+{
+    if (source_ == Source::WfbApi)
+        return api_client_->Connect();
+    return SpawnFollower();
+}
+
+void SignalMonitor::CloseSource()
+{
+    if (source_ == Source::WfbApi)
+        api_client_->Disconnect();
+    else
+        StopFollower();
+}
+
+bool SignalMonitor::ReadSource()
+{
+    if (source_ != Source::WfbApi)
+        return ReadFollower();
+    WfbStatsClient::Handler handler;
+    handler.on_antenna = [this](const AntennaSample &sample) { IngestAntenna(sample); };
+    handler.on_packets = [this](uint64_t stream_key, uint64_t ts_ms, const PacketSample &sample) {
+        IngestPackets(stream_key, ts_ms, sample);
+    };
+    return api_client_->ReadAvailable(handler);
+}
+
+bool SignalMonitor::SpawnFollower()
+{
+    int fds[2] = {-1, -1};
+    if (pipe2(fds, O_CLOEXEC) != 0)
+    {
+        LOG_ERROR("SignalMonitor", "pipe2: %s", std::strerror(errno));
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    pid_t pid = -1;
+    int rc = posix_spawnp(&pid, kJournalArgv[0], &actions, nullptr,
+                          const_cast<char *const *>(kJournalArgv), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (rc != 0)
+    {
+        LOG_ERROR("SignalMonitor", "failed to spawn journalctl: %s", std::strerror(rc));
+        close(fds[0]);
+        return false;
+    }
+
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    pipe_fd_ = fds[0];
+    child_pid_ = pid;
+    pending_.clear();
+    entry_pid_ = -1;
+    entry_msg_.clear();
+    return true;
+}
+
+void SignalMonitor::StopFollower()
+{
+    if (child_pid_ > 0)
+    {
+        kill(child_pid_, SIGTERM);
+        waitpid(child_pid_, nullptr, 0);
+        child_pid_ = -1;
+    }
+    if (pipe_fd_ >= 0)
+    {
+        close(pipe_fd_);
+        pipe_fd_ = -1;
+    }
+}
+
+bool SignalMonitor::ReadFollower()
+{
+    char buffer[4096];
+    while (true)
+    {
+        ssize_t n = read(pipe_fd_, buffer, sizeof(buffer));
+        if (n > 0)
         {
-            try
+            pending_.append(buffer, static_cast<size_t>(n));
+            ConsumeExport();
+            if (pending_.size() > kMaxPending)
             {
-                current_pid = static_cast<pid_t>(std::stoi(line.substr(5)));
-            }
-            catch (const std::exception &)
-            {
-                current_pid = -1;
+                // Never saw a field terminator; resynchronise on the next entry.
+                pending_.clear();
+                entry_pid_ = -1;
+                entry_msg_.clear();
             }
+            continue;
         }
+        if (n == 0)
+            return false;
+        if (errno == EINTR)
+            continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
     }
-    flush_entry();
-
-    pclose(pipe);
+}
 
-    if (!antenna_data.empty())
+void SignalMonitor::ConsumeExport()
+{
+    // Journal export format: "FIELD=value\n" lines, entries separated by a blank
+    // line. Fields with non-printable data are "FIELD\n<le64 size><data>\n".
+    size_t pos = 0;
+    while (pos < pending_.size())
     {
-        GroundSignalSnapshot snapshot;
-        size_t idx = 0;
-        for (const auto &entry : antenna_data)
+        const size_t nl = pending_.find('\n', pos);
+        if (nl == std::string::npos)
+            break;
+        if (nl == pos)
         {
-            if (idx == 0)
+            FlushEntry();
+            pos = nl + 1;
+            continue;
+        }
+
+        const size_t eq = pending_.find('=', pos);
+        if (eq != std::string::npos && eq < nl)
+        {
+            const size_t name_len = eq - pos;
+            if (pending_.compare(pos, name_len, "MESSAGE") == 0)
             {
-                snapshot.signal_a = entry.second;
+                entry_msg_.assign(pending_, eq + 1, nl - eq - 1);
             }
-            else if (idx == 1)
+            else if (pending_.compare(pos, name_len, "_PID") == 0)
             {
-                snapshot.signal_b = entry.second;
-                break;
+                const char *first = pending_.data() + eq + 1;
+                const char *last = pending_.data() + nl;
+                pid_t pid = -1;
+                const auto result = std::from_chars(first, last, pid);
+                entry_pid_ = (result.ec == std::errc() && result.ptr == last) ? pid : -1;
             }
-            ++idx;
+            pos = nl + 1;
+            continue;
         }
 
-        snapshot.valid = true;
-        snapshot.timestamp = log_ts;
-
-        std::lock_guard<std::mutex> lock(mutex_);
-        latest_ = snapshot;
+        const size_t size_pos = nl + 1;
+        if (pending_.size() < size_pos + 8)
+            break;
+        uint64_t len = 0;
+        for (size_t i = 0; i < 8; ++i)
+        {
+            len |= static_cast<uint64_t>(static_cast<uint8_t>(pending_[size_pos + i])) << (8 * i);
+        }
+        if (len > kMaxBinaryField)
+        {
+            pending_.clear();
+            entry_pid_ = -1;
+            entry_msg_.clear();
+            return;
+        }
+        const size_t data_pos = size_pos + 8;
+        if (pending_.size() < data_pos + len + 1)
+            break;
+        if (pending_.compare(pos, nl - pos, "MESSAGE") == 0)
+        {
+            entry_msg_.assign(pending_, data_pos, static_cast<size_t>(len));
+        }
+        pos = data_pos + static_cast<size_t>(len) + 1;
     }
+    pending_.erase(0, pos);
+}
 
-    if (!saw_pkt)
-        return true;
+void SignalMonitor::FlushEntry()
+{
+    if (!entry_msg_.empty())
+    {
+        ProcessEntry(entry_pid_, entry_msg_);
+    }
+    entry_pid_ = -1;
+    entry_msg_.clear();
+}
 
-    auto now = std::chrono::steady_clock::now();
-    PacketRateSnapshot rate{};
-    rate.timestamp = now;
-    auto &state = rate_states_["video"];
+void SignalMonitor::ProcessEntry(pid_t pid, std::string_view message)
+{
+    uint64_t log_ts = 0;
+    AntennaSample antenna;
+    PacketSample packets;
+    switch (ParseWfbLogMessage(message, log_ts, antenna, packets))
+    {
+    case WfbLogRecord::RxAnt:
+        IngestAntenna(antenna);
+        break;
+    case WfbLogRecord::Pkt:
+        if (pid > 0)
+            IngestPackets(static_cast<uint64_t>(pid), log_ts, packets);
+        break;
+    case WfbLogRecord::None:
+        break;
+    }
+}
 
-    double dt = 0.0;
-    if (last_ts > first_ts)
+void SignalMonitor::IngestAntenna(const AntennaSample &sample)
+{
+    const auto now = std::chrono::steady_clock::now();
+    auto begin = antennas_.begin();
+    auto end = begin + antenna_count_;
+    auto it = std::lower_bound(begin, end, sample.antenna_id,
+                               [](const AntennaState &state, uint64_t id) { return state.antenna_id < id; });
+    if (it == end || it->antenna_id != sample.antenna_id)
     {
-        dt = static_cast<double>(last_ts - first_ts) / 1000.0;
+        if (antenna_count_ == antennas_.size())
+        {
+            // Table full: give up the slot of the antenna heard from least recently.
+            auto oldest = std::min_element(begin, end, [](const AntennaState &a, const AntennaState &b) {
+                return a.seen < b.seen;
+            });
+            std::move(oldest + 1, end, oldest);
+            --antenna_count_;
+            end = begin + antenna_count_;
+            it = std::lower_bound(begin, end, sample.antenna_id,
+                                  [](const AntennaState &state, uint64_t id) { return state.antenna_id < id; });
+        }
+        std::move_backward(it, end, end + 1);
+        ++antenna_count_;
+        *it = AntennaState{};
+        it->antenna_id = sample.antenna_id;
     }
-    if (dt <= 0.0)
+
+    it->history[it->head] = sample;
+    it->head = (it->head + 1) % it->history.size();
+    it->count = std::min(it->count + 1, it->history.size());
+    it->seen = now;
+    PublishSignal(now);
+}
+
+void SignalMonitor::IngestPackets(uint64_t stream_key, uint64_t log_ts, const PacketSample &sample)
+{
+    // PKT counters are per log interval. Each record covers the time since the
+    // previous one from the same wfb_rx instance, so the window sums the
+    // newest records back to the first one at or before the window start and
+    // divides by the log time between them.
+    const auto now = std::chrono::steady_clock::now();
+    if (log_ts == 0)
     {
-        if (state.valid)
-            dt = std::chrono::duration<double>(now - state.ts).count();
+        log_ts = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count());
     }
-    if (dt <= 0.0)
+    auto &state = rate_states_[stream_key];
+    const size_t size = state.history.size();
+    auto at = [&](size_t age) -> const PacketRecord & { return state.history[(state.head + size - 1 - age) % size]; };
+    if (state.count > 0 && log_ts <= at(0).log_ts)
     {
-        dt = 1.0;
+        // wfb_rx restarted or the clock stepped back; start a fresh window.
+        state.count = 0;
+        state.valid = false;
     }
+    state.history[state.head] = PacketRecord{log_ts, sample};
+    state.head = (state.head + 1) % size;
+    state.count = std::min(state.count + 1, size);
+    state.updated = now;
 
-    rate.primary_mbps = static_cast<float>((static_cast<double>(video_bytes) * 8.0) /
-                                           (1024.0 * 1024.0) / dt);
-    state.bytes = video_bytes;
-    state.ts = now;
+    const uint64_t window_start = log_ts > kPacketWindowMs ? log_ts - kPacketWindowMs : 0;
+    PacketSample sum{};
+    uint64_t first_ts = log_ts;
+    for (size_t age = 1; age < state.count; ++age)
+    {
+        const PacketSample &s = at(age - 1).sample;
+        sum.all += s.all;
+        sum.all_bytes += s.all_bytes;
+        sum.dec_err += s.dec_err;
+        sum.session += s.session;
+        sum.data += s.data;
+        sum.uniq += s.uniq;
+        sum.fec_rec += s.fec_rec;
+        sum.lost += s.lost;
+        sum.bad += s.bad;
+        sum.out += s.out;
+        sum.out_bytes += s.out_bytes;
+        first_ts = at(age).log_ts;
+        if (first_ts <= window_start)
+            break;
+    }
+    if (first_ts >= log_ts)
+        return;
+    state.window = sum;
+    state.window_s = static_cast<double>(log_ts - first_ts) / 1000.0;
     state.valid = true;
-    rate.valid = (video_bytes > 0);
-
-    std::lock_guard<std::mutex> lock(mutex_);
-    latest_rate_ = rate;
-
-    return true;
+    PublishRate(now);
 }
 
-void SignalMonitor::ProcessEntry(pid_t pid, const std::string &message,
-                                 std::map<uint64_t, float> &antenna_data,
-                                 bool &saw_pkt,
-                                 uint64_t &video_bytes,
-                                 uint64_t &first_ts,
-                                 uint64_t &last_ts)
+void SignalMonitor::PublishSignal(std::chrono::steady_clock::time_point now)
 {
-    (void)pid;
-    if (message.empty())
-        return;
-
-    auto fields = SignalMonitor::SplitString(message, '\t');
-    if (fields.size() < 2)
+    auto end = std::remove_if(antennas_.begin(), antennas_.begin() + antenna_count_,
+                              [&](const AntennaState &state) { return now - state.seen > kAntennaStale; });
+    antenna_count_ = static_cast<size_t>(end - antennas_.begin());
+    if (antenna_count_ == 0)
         return;
 
-    if (fields[1] == "RX_ANT")
-    {
-        if (fields.size() < 5)
-            return;
-        try
-        {
-            uint64_t antenna_id = std::stoull(fields[3], nullptr, 16);
-            auto stats = SignalMonitor::SplitString(fields[4], ':');
-            if (stats.size() < 7)
-                return;
-            float rssi_val = static_cast<float>(std::stof(stats[2]));
-            antenna_data[antenna_id] = rssi_val;
-        }
-        catch (const std::exception &)
-        {
-            return;
-        }
-    }
-    else if (fields[1] == "PKT")
+    GroundSignalSnapshot snapshot;
+    for (size_t i = 0; i < antenna_count_; ++i)
     {
-        if (fields.size() < 3 || pid <= 0)
-            return;
-        uint64_t log_ts = 0;
-        try
-        {
-            log_ts = static_cast<uint64_t>(std::stoull(fields[0]));
-        }
-        catch (const std::exception &)
-        {
-            log_ts = 0;
-        }
+        const AntennaState &state = antennas_[i];
+        AntennaStats &stats = snapshot.antennas[i];
+        stats.antenna_id = state.antenna_id;
+        stats.last = state.history[(state.head + state.history.size() - 1) % state.history.size()];
+        stats.window_rssi_min = stats.last.rssi_min;
+        stats.window_rssi_max = stats.last.rssi_max;
+        stats.window_snr_min = stats.last.snr_min;
+        stats.window_snr_max = stats.last.snr_max;
 
-        auto stats = SignalMonitor::SplitString(fields[2], ':');
-        if (stats.size() < 11)
-            return;
-        uint64_t bytes_out = 0;
-        try
+        // Averages are weighted by packet count so quiet intervals don't skew them.
+        double rssi_sum = 0.0;
+        double snr_sum = 0.0;
+        for (size_t n = 0; n < state.count; ++n)
         {
-            bytes_out = static_cast<uint64_t>(std::stoull(stats.back()));
+            const AntennaSample &sample = state.history[n];
+            const uint64_t packets = sample.packets > 0 ? static_cast<uint64_t>(sample.packets) : 0;
+            stats.window_packets += packets;
+            rssi_sum += static_cast<double>(sample.rssi_avg) * static_cast<double>(packets);
+            snr_sum += static_cast<double>(sample.snr_avg) * static_cast<double>(packets);
+            stats.window_rssi_min = std::min(stats.window_rssi_min, sample.rssi_min);
+            stats.window_rssi_max = std::max(stats.window_rssi_max, sample.rssi_max);
+            stats.window_snr_min = std::min(stats.window_snr_min, sample.snr_min);
+            stats.window_snr_max = std::max(stats.window_snr_max, sample.snr_max);
         }
-        catch (const std::exception &)
+        if (stats.window_packets > 0)
         {
-            return;
+            stats.window_rssi_avg = static_cast<float>(rssi_sum / static_cast<double>(stats.window_packets));
+            stats.window_snr_avg = static_cast<float>(snr_sum / static_cast<double>(stats.window_packets));
         }
-
-        video_bytes += bytes_out;
-        if (log_ts > 0)
+        else
         {
-            if (first_ts == 0 || log_ts < first_ts)
-                first_ts = log_ts;
-            if (log_ts > last_ts)
-                last_ts = log_ts;
+            stats.window_rssi_avg = static_cast<float>(stats.last.rssi_avg);
+            stats.window_snr_avg = static_cast<float>(stats.last.snr_avg);
         }
-        saw_pkt = true;
     }
+    snapshot.antenna_count = antenna_count_;
+    snapshot.signal_a = static_cast<float>(snapshot.antennas[0].last.rssi_avg);
+    if (antenna_count_ > 1)
+        snapshot.signal_b = static_cast<float>(snapshot.antennas[1].last.rssi_avg);
+    snapshot.valid = true;
+    snapshot.timestamp = now;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latest_ = snapshot;
+    }
+    if (on_update_)
+        on_update_();
 }
 
-std::vector<std::string> SignalMonitor::SplitString(const std::string &line, char delim)
+void SignalMonitor::PublishRate(std::chrono::steady_clock::time_point now)
 {
-    std::vector<std::string> tokens;
-    size_t start = 0;
-    while (start <= line.size())
+    PacketRateSnapshot rate{};
+    rate.timestamp = now;
+    double out_bytes = 0.0;
+    double all_bytes = 0.0;
+    for (auto it = rate_states_.begin(); it != rate_states_.end();)
     {
-        auto pos = line.find(delim, start);
-        if (pos == std::string::npos)
+        if (now - it->second.updated > kRateStale)
         {
-            tokens.emplace_back(line.substr(start));
-            break;
+            it = rate_states_.erase(it);
+            continue;
         }
-        tokens.emplace_back(line.substr(start, pos - start));
-        start = pos + 1;
+        const RateState &state = it->second;
+        if (state.valid)
+        {
+            const double dt = state.window_s;
+            out_bytes += static_cast<double>(state.window.out_bytes) / dt;
+            all_bytes += static_cast<double>(state.window.all_bytes) / dt;
+            rate.received_pps += static_cast<float>(static_cast<double>(state.window.all) / dt);
+            rate.out_pps += static_cast<float>(static_cast<double>(state.window.out) / dt);
+            rate.lost_pps += static_cast<float>(static_cast<double>(state.window.lost) / dt);
+            rate.fec_recovered_pps += static_cast<float>(static_cast<double>(state.window.fec_rec) / dt);
+            rate.bad_pps += static_cast<float>(static_cast<double>(state.window.bad) / dt);
+            rate.valid = true;
+        }
+        ++it;
+    }
+    rate.primary_mbps = static_cast<float>(out_bytes * 8.0 / (1024.0 * 1024.0));
+    rate.secondary_mbps = static_cast<float>(all_bytes * 8.0 / (1024.0 * 1024.0));
+    const float expected = rate.out_pps + rate.lost_pps;
+    if (expected > 0.0f)
+    {
+        rate.loss_percent = rate.lost_pps * 100.0f / expected;
+        rate.fec_percent = rate.fec_recovered_pps * 100.0f / expected;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latest_rate_ = rate;
     }
-    return tokens;
+    if (on_update_)
+        on_update_();
 }
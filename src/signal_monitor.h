@@ -1,54 +1,175 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <map>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
-#include <vector>
 #include <sys/types.h>
 
-struct GroundSignalSnapshot {
-    float signal_a = 0.0f;
-    float signal_b = 0.0f;
+
+// Link rates summed over all wfb_rx instances, averaged over the last
+// kPacketWindowMs of PKT records (by log timestamp).
+struct PacketRateSnapshot {
+    float primary_mbps = 0.0f;   // decoded payload handed to the sink (out_bytes)
+    float secondary_mbps = 0.0f; // everything received over the air (all_bytes)
+    float received_pps = 0.0f;
+    float out_pps = 0.0f;
+    float lost_pps = 0.0f;
+    float fec_recovered_pps = 0.0f;
+    float bad_pps = 0.0f;
+    // Both relative to the packets the stream should have delivered (out + lost).
+    float loss_percent = 0.0f;
+    float fec_percent = 0.0f;
     bool valid = false;
     std::chrono::steady_clock::time_point timestamp = std::chrono::steady_clock::time_point::min();
 };
 
-struct PacketRateSnapshot {
-    float primary_mbps = 0.0f;
-    float secondary_mbps = 0.0f;
+// One RX_ANT record: per-antenna counters for the last log interval.
+struct AntennaSample {
+    uint64_t antenna_id = 0;
+    int32_t packets = 0;
+    int32_t rssi_min = 0;
+    int32_t rssi_avg = 0;
+    int32_t rssi_max = 0;
+    int32_t snr_min = 0;
+    int32_t snr_avg = 0;
+    int32_t snr_max = 0;
+};
+
+// One PKT record: wfb_rx packet counters for the last log interval.
+struct PacketSample {
+    uint64_t all = 0;
+    uint64_t all_bytes = 0;
+    uint64_t dec_err = 0;
+    uint64_t session = 0;
+    uint64_t data = 0;
+    uint64_t uniq = 0;
+    uint64_t fec_rec = 0;
+    uint64_t lost = 0;
+    uint64_t bad = 0;
+    uint64_t out = 0;
+    uint64_t out_bytes = 0;
+};
+
+constexpr size_t kMaxGroundAntennas = 8;
+constexpr size_t kAntennaWindow = 10;
+constexpr uint64_t kPacketWindowMs = 1000;
+constexpr size_t kPacketHistory = 32;
+
+// Full RX statistics for one antenna: the most recent RX_ANT record plus
+// aggregates over the last kAntennaWindow records. wfb-ng encodes the
+// antenna id as (wlan index << 8) | chain.
+struct AntennaStats {
+    uint64_t antenna_id = 0;
+    AntennaSample last{};
+    uint64_t window_packets = 0;
+    int32_t window_rssi_min = 0;
+    float window_rssi_avg = 0.0f;
+    int32_t window_rssi_max = 0;
+    int32_t window_snr_min = 0;
+    float window_snr_avg = 0.0f;
+    int32_t window_snr_max = 0;
+};
+
+struct GroundSignalSnapshot {
+    // Average RSSI of the first two antennas, kept for the compact OSD line.
+    float signal_a = 0.0f;
+    float signal_b = 0.0f;
+    std::array<AntennaStats, kMaxGroundAntennas> antennas{};
+    size_t antenna_count = 0;
     bool valid = false;
     std::chrono::steady_clock::time_point timestamp = std::chrono::steady_clock::time_point::min();
 };
 
+class WfbStatsClient;
+
+// Collects wfb_rx antenna and packet statistics on a background thread, either
+// by following the wifibroadcast journal through a single long-lived
+// `journalctl -f --output=export` child or by subscribing to the wfb-ng stats
+// API. Records are handled as they arrive, so each one is accounted once.
 class SignalMonitor {
 public:
-    SignalMonitor();
-    ~SignalMonitor() = default;
+    enum class Source {
+        Journal,
+        WfbApi,
+    };
+
+    SignalMonitor(Source source = Source::Journal, std::string api_host = "127.0.0.1",
+                  uint16_t api_port = 8003);
+    ~SignalMonitor();
 
-    bool Poll();
+    // Called on the monitor thread right after a new signal or rate snapshot is
+    // published. Set it before Start(); the callee must outlive Stop().
+    void SetUpdateCallback(std::function<void()> callback);
+    void Start();
+    void Stop();
     GroundSignalSnapshot Latest() const;
     PacketRateSnapshot LatestRate() const;
 
 private:
+    struct PacketRecord {
+        uint64_t log_ts = 0;
+        PacketSample sample{};
+    };
+
     struct RateState {
-        uint64_t bytes = 0;
-        std::chrono::steady_clock::time_point ts{};
+        std::array<PacketRecord, kPacketHistory> history{};
+        size_t head = 0;
+        size_t count = 0;
+        PacketSample window{};  // counters summed over the window
+        double window_s = 0.0;  // log time the window spans
+        std::chrono::steady_clock::time_point updated{};
         bool valid = false;
     };
 
-    bool UpdateSnapshot();
-    void ProcessEntry(pid_t pid, const std::string &message,
-                      std::map<uint64_t, float> &antenna_data,
-                      bool &saw_pkt,
-                      uint64_t &video_bytes,
-                      uint64_t &first_ts,
-                      uint64_t &last_ts);
-    static std::vector<std::string> SplitString(const std::string &line, char delim);
+    struct AntennaState {
+        uint64_t antenna_id = 0;
+        std::array<AntennaSample, kAntennaWindow> history{};
+        size_t head = 0;
+        size_t count = 0;
+        std::chrono::steady_clock::time_point seen{};
+    };
+
+    void ThreadMain();
+    bool OpenSource();
+    void CloseSource();
+    bool ReadSource();
+    bool SpawnFollower();
+    void StopFollower();
+    bool ReadFollower();
+    void ConsumeExport();
+    void FlushEntry();
+    void ProcessEntry(pid_t pid, std::string_view message);
+    void IngestAntenna(const AntennaSample &sample);
+    void IngestPackets(uint64_t stream_key, uint64_t log_ts, const PacketSample &sample);
+    void PublishSignal(std::chrono::steady_clock::time_point now);
+    void PublishRate(std::chrono::steady_clock::time_point now);
+
+    Source source_ = Source::Journal;
+    std::function<void()> on_update_;
+    std::unique_ptr<WfbStatsClient> api_client_;
+    std::thread worker_;
+    std::atomic<bool> running_{false};
+    int wake_fds_[2] = {-1, -1};
+
+    // Source state, owned by the worker thread.
+    pid_t child_pid_ = -1;
+    int pipe_fd_ = -1;
+    std::string pending_;
+    pid_t entry_pid_ = -1;
+    std::string entry_msg_;
+    // Sorted by antenna id so the OSD order is stable.
+    std::array<AntennaState, kMaxGroundAntennas> antennas_{};
+    size_t antenna_count_ = 0;
+    std::unordered_map<uint64_t, RateState> rate_states_;
 
     mutable std::mutex mutex_;
     GroundSignalSnapshot latest_;
     PacketRateSnapshot latest_rate_;
-    std::unordered_map<std::string, RateState> rate_states_;
 };
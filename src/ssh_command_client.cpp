@@ -1,114 +1,338 @@
 #include "ssh_command_client.h"
 
+#include "logger.h"
+
 #include <libssh/libssh.h>
 
+#include <pthread.h>
+
 #include <algorithm>
-#include <cerrno>
-#include <cstdio>
-#include <cstring>
+#include <atomic>
+#include <chrono>
 #include <sstream>
 
+namespace {
+// Reads hold the session lock, so they are sliced to let other channels and
+// the keepalive thread in between.
+constexpr int kReadSliceMs = 20;
+constexpr auto kKeepaliveInterval = std::chrono::seconds(10);
+constexpr int kBackgroundConnectTimeoutMs = 2000;
+// A handshake needs several round trips over the radio link and usually more
+// than a Send's 500 ms, so commands that have to reconnect give it at least
+// this long, whatever their own deadline.
+constexpr int kMinConnectTimeoutMs = 1500;
+
+std::chrono::steady_clock::time_point DeadlineIn(int timeout_ms) {
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+}
+
+int RemainingMs(std::chrono::steady_clock::time_point deadline) {
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return static_cast<int>(std::max<std::chrono::milliseconds::rep>(0, left.count()));
+}
+} // namespace
+
+struct SshCommandClient::Session {
+    ~Session() {
+        if (handle) {
+            ssh_disconnect(handle);
+            ssh_free(handle);
+        }
+    }
+
+    ssh_session handle = nullptr;
+    // libssh sessions are not thread safe: every call on the session or on
+    // one of its channels holds io.
+    std::mutex io;
+    std::atomic<bool> broken{false};
+};
+
 SshCommandClient::SshCommandClient(std::string host, uint16_t port,
                                    std::string user, std::string password)
     : host_(std::move(host)), port_(port),
       user_(std::move(user)), password_(std::move(password)) {}
 
+SshCommandClient::~SshCommandClient() {
+    StopAsync();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    keepalive_cv_.notify_all();
+    if (keepalive_thread_.joinable()) {
+        keepalive_thread_.join();
+    }
+}
+
 bool SshCommandClient::Send(const std::string &cmd, bool expect_reply, int timeout_ms) {
     std::vector<std::string> dummy;
-    return Execute(cmd, expect_reply ? &dummy : nullptr, timeout_ms);
+    return CommandAccepted(Execute(cmd, expect_reply ? &dummy : nullptr, DeadlineIn(timeout_ms), timeout_ms, nullptr));
 }
 
 bool SshCommandClient::SendWithReply(const std::string &cmd,
                                      std::vector<std::string> &response,
                                      int timeout_ms) {
-    return Execute(cmd, &response, timeout_ms);
+    return CommandAccepted(Execute(cmd, &response, DeadlineIn(timeout_ms), timeout_ms, nullptr));
 }
 
-bool SshCommandClient::Execute(const std::string &cmd, std::vector<std::string> *response,
-                               int timeout_ms) {
+CommandStatus SshCommandClient::ExecuteCancellable(const std::string &cmd, std::vector<std::string> &response,
+                                                   std::chrono::steady_clock::time_point deadline,
+                                                   const CommandCancelToken &cancel) {
+    return Execute(cmd, &response, deadline, -1, &cancel);
+}
+
+void SshCommandClient::WakeWaiters() {
+    // Channel reads poll for cancellation between slices; only the wait for
+    // a free channel needs waking.
     std::lock_guard<std::mutex> lock(mutex_);
-    ssh_session session = ssh_new();
-    if (!session) {
-        std::fprintf(stderr, "[AMLgsMenu] ssh_new failed\n");
-        return false;
+    channel_cv_.notify_all();
+}
+
+CommandStatus SshCommandClient::Execute(const std::string &cmd, std::vector<std::string> *response,
+                                        Deadline deadline, int timeout_ms, const CommandCancelToken *cancel) {
+    const auto cancelled = [cancel] { return cancel && cancel->IsCancelled(); };
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const bool free_channel =
+            channel_cv_.wait_until(lock, deadline, [&] { return open_channels_ < kMaxChannels || cancelled(); });
+        if (cancelled()) {
+            return CommandStatus::Cancelled;
+        }
+        if (!free_channel) {
+            LOG_EVERY_MS(LogLevel::Warn, "SshCommand", 5000, "no free channel before deadline, dropping: %s",
+                         cmd.c_str());
+            return CommandStatus::Failed;
+        }
+        ++open_channels_;
     }
-    ssh_options_set(session, SSH_OPTIONS_HOST, host_.c_str());
-    ssh_options_set(session, SSH_OPTIONS_PORT, &port_);
-    ssh_options_set(session, SSH_OPTIONS_USER, user_.c_str());
-    int strict_host = 0;
-    ssh_options_set(session, SSH_OPTIONS_STRICTHOSTKEYCHECK, &strict_host);
-    if (timeout_ms > 0) {
-        long sec = std::max(1, timeout_ms / 1000);
-        ssh_options_set(session, SSH_OPTIONS_TIMEOUT, &sec);
-    }
-    int rc = ssh_connect(session);
-    if (rc != SSH_OK) {
-        std::fprintf(stderr, "[AMLgsMenu] ssh_connect: %s\n", ssh_get_error(session));
-        ssh_free(session);
-        return false;
-    }
-    rc = ssh_userauth_password(session, nullptr, password_.c_str());
-    if (rc != SSH_AUTH_SUCCESS) {
-        std::fprintf(stderr, "[AMLgsMenu] ssh_userauth_password failed: %s\n", ssh_get_error(session));
-        ssh_disconnect(session);
-        ssh_free(session);
-        return false;
-    }
-
-    ssh_channel channel = ssh_channel_new(session);
-    if (!channel) {
-        std::fprintf(stderr, "[AMLgsMenu] ssh_channel_new failed\n");
-        ssh_disconnect(session);
-        ssh_free(session);
-        return false;
-    }
-    rc = ssh_channel_open_session(channel);
-    if (rc != SSH_OK) {
-        std::fprintf(stderr, "[AMLgsMenu] ssh_channel_open_session failed: %s\n", ssh_get_error(session));
-        ssh_channel_free(channel);
-        ssh_disconnect(session);
-        ssh_free(session);
-        return false;
-    }
-    rc = ssh_channel_request_exec(channel, cmd.c_str());
-    if (rc != SSH_OK) {
-        std::fprintf(stderr, "[AMLgsMenu] ssh_channel_request_exec failed: %s\n", ssh_get_error(session));
-        ssh_channel_close(channel);
-        ssh_channel_free(channel);
-        ssh_disconnect(session);
-        ssh_free(session);
-        return false;
+    std::string collected;
+    CommandStatus status = CommandStatus::Failed;
+    // A reused session may have died since its last keepalive. Nothing has
+    // run on the sky side when the channel cannot be opened, so it is safe to
+    // retry once on a fresh session.
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        const int remaining_ms = RemainingMs(deadline);
+        if (remaining_ms <= 0) {
+            break;
+        }
+        bool reused = false;
+        std::shared_ptr<Session> session = AcquireSession(std::max(remaining_ms, kMinConnectTimeoutMs), reused);
+        if (!session) {
+            break;
+        }
+        if (!reused) {
+            // A relative timeout covers the command, not the handshake. An
+            // absolute deadline stays put; the new session is kept for the
+            // next command even if this one has run out of time.
+            if (timeout_ms >= 0) {
+                deadline = DeadlineIn(timeout_ms);
+            } else if (RemainingMs(deadline) <= 0) {
+                LOG_EVERY_MS(LogLevel::Warn, "SshCommand", 5000, "reconnected after the deadline, dropping: %s",
+                             cmd.c_str());
+                break;
+            }
+        }
+        const ChannelResult result = RunChannel(*session, cmd, response ? &collected : nullptr, deadline, cancel);
+        if (result == ChannelResult::Done || result == ChannelResult::TimedOut) {
+            status = result == ChannelResult::Done ? CommandStatus::Ok : CommandStatus::TimedOut;
+            break;
+        }
+        if (result == ChannelResult::Cancelled) {
+            status = CommandStatus::Cancelled;
+            break;
+        }
+        DropSession(session);
+        if (result == ChannelResult::Failed || !reused) {
+            break;
+        }
+        LOG_INFO("SshCommand", "session to %s went stale, reconnecting", host_.c_str());
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --open_channels_;
     }
+    channel_cv_.notify_one();
 
-    std::string collected;
+    if (CommandAccepted(status) && response) {
+        SplitLines(collected, *response);
+    }
+    return status;
+}
+
+SshCommandClient::ChannelResult SshCommandClient::RunChannel(Session &session, const std::string &cmd,
+                                                             std::string *output, Deadline deadline,
+                                                             const CommandCancelToken *cancel) {
+    ssh_channel channel = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(session.io);
+        channel = ssh_channel_new(session.handle);
+        if (!channel) {
+            LOG_WARN("SshCommand", "ssh_channel_new failed: %s", ssh_get_error(session.handle));
+            return ChannelResult::Stale;
+        }
+        if (ssh_channel_open_session(channel) != SSH_OK) {
+            LOG_WARN("SshCommand", "ssh_channel_open_session failed: %s", ssh_get_error(session.handle));
+            ssh_channel_free(channel);
+            return ChannelResult::Stale;
+        }
+        if (ssh_channel_request_exec(channel, cmd.c_str()) != SSH_OK) {
+            LOG_WARN("SshCommand", "ssh_channel_request_exec failed: %s", ssh_get_error(session.handle));
+            ssh_channel_close(channel);
+            ssh_channel_free(channel);
+            return ChannelResult::Stale;
+        }
+    }
+
+    // Read until the command closes its output or the caller's deadline passes.
+    ChannelResult result = ChannelResult::Done;
     char buffer[512];
     while (true) {
-        rc = ssh_channel_read_timeout(channel, buffer, sizeof(buffer), 0, timeout_ms);
+        int rc = 0;
+        bool eof = false;
+        {
+            std::lock_guard<std::mutex> lock(session.io);
+            rc = ssh_channel_read_timeout(channel, buffer, sizeof(buffer), 0, kReadSliceMs);
+            if (rc == SSH_ERROR) {
+                LOG_WARN("SshCommand", "ssh_channel_read failed: %s", ssh_get_error(session.handle));
+            }
+            eof = rc == 0 && ssh_channel_is_eof(channel);
+        }
         if (rc == SSH_ERROR) {
-            std::fprintf(stderr, "[AMLgsMenu] ssh_channel_read failed: %s\n", ssh_get_error(session));
+            result = ChannelResult::Failed;
             break;
         }
-        if (rc == SSH_AGAIN) {
+        if (cancel && cancel->IsCancelled()) {
+            // Closing the channel below tells the sky side to stop as well.
+            result = ChannelResult::Cancelled;
             break;
         }
-        if (rc == 0) {
+        if (rc > 0 && output) {
+            output->append(buffer, rc);
+        }
+        if (eof) {
             break;
         }
-        if (response) {
-            collected.append(buffer, rc);
+        if (std::chrono::steady_clock::now() >= deadline) {
+            result = ChannelResult::TimedOut;
+            break;
         }
     }
 
+    std::lock_guard<std::mutex> lock(session.io);
     ssh_channel_send_eof(channel);
     ssh_channel_close(channel);
     ssh_channel_free(channel);
-    ssh_disconnect(session);
-    ssh_free(session);
+    return result;
+}
 
-    if (response) {
-        SplitLines(collected, *response);
+std::shared_ptr<SshCommandClient::Session> SshCommandClient::AcquireSession(int timeout_ms, bool &reused) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (session_ && !session_->broken) {
+            reused = true;
+            return session_;
+        }
+    }
+    std::lock_guard<std::mutex> connect_lock(connect_mutex_);
+    {
+        // Another caller may have finished the handshake while we waited.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (session_ && !session_->broken) {
+            reused = true;
+            return session_;
+        }
+    }
+    reused = false;
+    std::shared_ptr<Session> session = Connect(timeout_ms);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!session) {
+        return nullptr;
+    }
+    session_ = session;
+    reconnect_wanted_ = false;
+    if (!keepalive_thread_.joinable() && !stopping_) {
+        keepalive_thread_ = std::thread(&SshCommandClient::KeepaliveLoop, this);
+    }
+    return session;
+}
+
+std::shared_ptr<SshCommandClient::Session> SshCommandClient::Connect(int timeout_ms) {
+    auto session = std::make_shared<Session>();
+    session->handle = ssh_new();
+    if (!session->handle) {
+        LOG_ERROR("SshCommand", "ssh_new failed");
+        return nullptr;
+    }
+    ssh_options_set(session->handle, SSH_OPTIONS_HOST, host_.c_str());
+    // SSH_OPTIONS_PORT takes an unsigned int.
+    unsigned int port = port_;
+    ssh_options_set(session->handle, SSH_OPTIONS_PORT, &port);
+    ssh_options_set(session->handle, SSH_OPTIONS_USER, user_.c_str());
+    int strict_host = 0;
+    ssh_options_set(session->handle, SSH_OPTIONS_STRICTHOSTKEYCHECK, &strict_host);
+    if (timeout_ms > 0) {
+        long sec = timeout_ms / 1000;
+        long usec = (timeout_ms % 1000) * 1000L;
+        ssh_options_set(session->handle, SSH_OPTIONS_TIMEOUT, &sec);
+        ssh_options_set(session->handle, SSH_OPTIONS_TIMEOUT_USEC, &usec);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    if (ssh_connect(session->handle) != SSH_OK) {
+        LOG_EVERY_MS(LogLevel::Warn, "SshCommand", 5000, "ssh_connect %s: %s", host_.c_str(),
+                     ssh_get_error(session->handle));
+        return nullptr;
+    }
+    if (ssh_userauth_password(session->handle, nullptr, password_.c_str()) != SSH_AUTH_SUCCESS) {
+        LOG_EVERY_MS(LogLevel::Warn, "SshCommand", 5000, "ssh_userauth_password failed: %s",
+                     ssh_get_error(session->handle));
+        return nullptr;
+    }
+    const auto elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    LOG_INFO("SshCommand", "session to %s:%d established in %lld ms", host_.c_str(), port_,
+             static_cast<long long>(elapsed.count()));
+    return session;
+}
+
+void SshCommandClient::DropSession(const std::shared_ptr<Session> &session) {
+    session->broken = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (session_ == session) {
+        // Channels still running on it keep it alive until they finish.
+        session_.reset();
+        reconnect_wanted_ = true;
+    }
+    keepalive_cv_.notify_all();
+}
+
+void SshCommandClient::KeepaliveLoop() {
+    pthread_setname_np(pthread_self(), "ssh-keepalive");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        keepalive_cv_.wait_for(lock, kKeepaliveInterval);
+        if (stopping_) {
+            break;
+        }
+        std::shared_ptr<Session> session = session_;
+        const bool reconnect = !session && reconnect_wanted_;
+        lock.unlock();
+        if (session) {
+            bool alive = false;
+            {
+                std::lock_guard<std::mutex> io_lock(session->io);
+                alive = ssh_is_connected(session->handle) && ssh_send_keepalive(session->handle) == SSH_OK;
+            }
+            if (!alive) {
+                LOG_WARN("SshCommand", "keepalive to %s failed, dropping session", host_.c_str());
+                DropSession(session);
+            }
+        } else if (reconnect) {
+            // Reconnect in the background so the next command skips the handshake.
+            bool reused = false;
+            AcquireSession(kBackgroundConnectTimeoutMs, reused);
+        }
+        lock.lock();
     }
-    return true;
 }
 
 void SshCommandClient::SplitLines(const std::string &text, std::vector<std::string> &out) {
@@ -2,28 +2,70 @@
 
 #include "command_transport.h"
 
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+// Runs commands on the sky unit over one long-lived, authenticated SSH
+// session. Each command gets its own channel, and up to kMaxChannels commands
+// run concurrently. A background thread sends keepalives and re-establishes
+// the session after it drops; a command that finds a stale session reconnects
+// once before giving up.
 class SshCommandClient : public CommandTransport {
 public:
+    static constexpr int kMaxChannels = 4;
+
     SshCommandClient(std::string host = "10.5.0.10", uint16_t port = 22,
                      std::string user = "root", std::string password = "12345");
-    ~SshCommandClient() override = default;
+    ~SshCommandClient() override;
 
     bool Send(const std::string &cmd, bool expect_reply = false, int timeout_ms = 500) override;
     bool SendWithReply(const std::string &cmd, std::vector<std::string> &response,
                        int timeout_ms = 1000) override;
 
+protected:
+    CommandStatus ExecuteCancellable(const std::string &cmd, std::vector<std::string> &response,
+                                     std::chrono::steady_clock::time_point deadline,
+                                     const CommandCancelToken &cancel) override;
+    void WakeWaiters() override;
+
 private:
-    bool Execute(const std::string &cmd, std::vector<std::string> *response, int timeout_ms);
+    struct Session;
+    enum class ChannelResult { Done, Failed, Stale, Cancelled, TimedOut };
+
+    using Deadline = std::chrono::steady_clock::time_point;
+
+    // timeout_ms >= 0 restarts the deadline after a fresh handshake; -1 keeps
+    // the caller's absolute deadline.
+    CommandStatus Execute(const std::string &cmd, std::vector<std::string> *response, Deadline deadline,
+                          int timeout_ms, const CommandCancelToken *cancel);
+    ChannelResult RunChannel(Session &session, const std::string &cmd, std::string *output, Deadline deadline,
+                             const CommandCancelToken *cancel);
+    std::shared_ptr<Session> AcquireSession(int timeout_ms, bool &reused);
+    std::shared_ptr<Session> Connect(int timeout_ms);
+    void DropSession(const std::shared_ptr<Session> &session);
+    void KeepaliveLoop();
     static void SplitLines(const std::string &text, std::vector<std::string> &out);
 
     std::string host_;
     uint16_t port_;
     std::string user_;
     std::string password_;
+
+    // Guards session_, open_channels_, keepalive state and stopping_.
     std::mutex mutex_;
+    std::condition_variable channel_cv_;
+    std::condition_variable keepalive_cv_;
+    std::shared_ptr<Session> session_;
+    int open_channels_ = 0;
+    bool reconnect_wanted_ = false;
+    bool stopping_ = false;
+    // Serialises handshakes so concurrent callers share one new session.
+    std::mutex connect_mutex_;
+    std::thread keepalive_thread_;
 };
@@ -0,0 +1,134 @@
+#include "sysfs_sampler.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+
+SysfsAttribute::SysfsAttribute(std::string path)
+    : path_(std::move(path))
+{
+}
+
+SysfsAttribute::~SysfsAttribute()
+{
+    Close();
+}
+
+bool SysfsAttribute::EnsureOpen()
+{
+    if (fd_ >= 0)
+        return true;
+    const auto now = std::chrono::steady_clock::now();
+    if (now < next_open_)
+        return false;
+    fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0)
+    {
+        next_open_ = now + kReopenInterval;
+        return false;
+    }
+    return true;
+}
+
+void SysfsAttribute::Close()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+std::optional<std::string_view> SysfsAttribute::Read(char *buffer, size_t size)
+{
+    // One retry covers attributes whose device was replaced under the old fd.
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        if (!EnsureOpen())
+            return std::nullopt;
+        ssize_t n;
+        do
+        {
+            n = pread(fd_, buffer, size, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0)
+        {
+            Close();
+            continue;
+        }
+        std::string_view text(buffer, static_cast<size_t>(n));
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back())))
+            text.remove_suffix(1);
+        return text;
+    }
+    return std::nullopt;
+}
+
+std::optional<int64_t> SysfsAttribute::ReadInt(int base)
+{
+    char buffer[kBufferSize];
+    auto text = Read(buffer);
+    if (!text)
+        return std::nullopt;
+    return ParseSysfsInt(*text, base);
+}
+
+SysfsSampler &SysfsSampler::Shared()
+{
+    static SysfsSampler sampler;
+    return sampler;
+}
+
+SysfsAttribute &SysfsSampler::Attribute(const std::string &path)
+{
+    auto &slot = attributes_[path];
+    if (!slot)
+        slot = std::make_unique<SysfsAttribute>(path);
+    return *slot;
+}
+
+std::optional<int64_t> SysfsSampler::ReadInt(const std::string &path, int base)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Attribute(path).ReadInt(base);
+}
+
+bool SysfsSampler::Read(const std::string &path, const std::function<void(std::string_view)> &parse)
+{
+    char buffer[SysfsAttribute::kBufferSize];
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto text = Attribute(path).Read(buffer);
+    if (!text)
+        return false;
+    parse(*text);
+    return true;
+}
+
+std::optional<int64_t> ParseSysfsInt(std::string_view text, int base)
+{
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front())))
+        text.remove_prefix(1);
+    bool negative = false;
+    if (!text.empty() && (text.front() == '-' || text.front() == '+'))
+    {
+        negative = text.front() == '-';
+        text.remove_prefix(1);
+    }
+    if ((base == 0 || base == 16) && text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    {
+        text.remove_prefix(2);
+        base = 16;
+    }
+    else if (base == 0)
+    {
+        base = 10;
+    }
+    int64_t value = 0;
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value, base);
+    if (text.empty() || result.ec != std::errc() || result.ptr != end)
+        return std::nullopt;
+    return negative ? -value : value;
+}
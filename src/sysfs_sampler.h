@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// A sysfs (or procfs) attribute opened once and re-read with pread(fd, 0). The fd is only
+// closed and reopened after a read fails; a missing attribute is retried at
+// most every kReopenInterval.
+class SysfsAttribute
+{
+public:
+    static constexpr size_t kBufferSize = 256;
+    static constexpr std::chrono::seconds kReopenInterval{5};
+
+    explicit SysfsAttribute(std::string path);
+    ~SysfsAttribute();
+    SysfsAttribute(const SysfsAttribute &) = delete;
+    SysfsAttribute &operator=(const SysfsAttribute &) = delete;
+
+    // Reads the current value into buffer, with trailing whitespace removed.
+    // The returned view points into buffer.
+    std::optional<std::string_view> Read(char (&buffer)[kBufferSize]) { return Read(buffer, kBufferSize); }
+    // Same for larger procfs files; content beyond size bytes is cut off.
+    std::optional<std::string_view> Read(char *buffer, size_t size);
+    std::optional<int64_t> ReadInt(int base = 10);
+    const std::string &Path() const { return path_; }
+
+private:
+    bool EnsureOpen();
+    void Close();
+
+    std::string path_;
+    int fd_ = -1;
+    std::chrono::steady_clock::time_point next_open_{};
+};
+
+// Process-wide cache of SysfsAttribute by path, shared by the telemetry
+// thread and the render thread.
+class SysfsSampler
+{
+public:
+    static SysfsSampler &Shared();
+
+    std::optional<int64_t> ReadInt(const std::string &path, int base = 10);
+    // Calls parse with the attribute contents; returns false if unreadable.
+    bool Read(const std::string &path, const std::function<void(std::string_view)> &parse);
+
+private:
+    SysfsAttribute &Attribute(const std::string &path);
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<SysfsAttribute>> attributes_;
+};
+
+// Parses a whole token as an integer; base 0 accepts a 0x prefix.
+std::optional<int64_t> ParseSysfsInt(std::string_view text, int base = 10);
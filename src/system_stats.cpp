@@ -0,0 +1,276 @@
+#include "system_stats.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+
+namespace
+{
+// /proc/stat grows with the interrupt count, but the cpu lines come first.
+constexpr size_t kProcStatBuffer = 4096;
+constexpr size_t kSmallProcBuffer = 512;
+
+// Fields of /proc/<pid>/stat, counted from the state field (field 3) that
+// follows the parenthesised command name.
+constexpr size_t kStatUtime = 11;
+constexpr size_t kStatStime = 12;
+constexpr size_t kStatNumThreads = 17;
+constexpr size_t kStatRss = 21;
+
+std::string_view NextLine(std::string_view &text)
+{
+    const size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    text = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+    return line;
+}
+
+bool NextNumber(std::string_view &text, uint64_t &value)
+{
+    size_t pos = 0;
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t'))
+        ++pos;
+    const char *begin = text.data() + pos;
+    auto result = std::from_chars(begin, text.data() + text.size(), value);
+    if (result.ec != std::errc())
+        return false;
+    text.remove_prefix(static_cast<size_t>(result.ptr - text.data()));
+    return true;
+}
+
+// Splits a /proc/<pid>/stat line into the command name and the fields after
+// it. The name may itself contain spaces and parentheses.
+bool SplitTaskStat(std::string_view text, std::string_view &name, std::string_view &fields)
+{
+    const size_t open = text.find('(');
+    const size_t close = text.rfind(')');
+    if (open == std::string_view::npos || close == std::string_view::npos || close < open)
+        return false;
+    name = text.substr(open + 1, close - open - 1);
+    fields = text.substr(close + 1);
+    return true;
+}
+
+// Reads the whitespace separated field at index (0 = state).
+bool TaskStatField(std::string_view fields, size_t index, uint64_t &value)
+{
+    size_t field = 0;
+    size_t pos = 0;
+    while (pos < fields.size())
+    {
+        while (pos < fields.size() && fields[pos] == ' ')
+            ++pos;
+        const size_t end = std::min(fields.find(' ', pos), fields.size());
+        if (field == index)
+        {
+            auto result = std::from_chars(fields.data() + pos, fields.data() + end, value);
+            return result.ec == std::errc();
+        }
+        ++field;
+        pos = end;
+    }
+    return false;
+}
+
+float Percent(uint64_t part, uint64_t whole)
+{
+    return whole == 0 ? 0.0f : std::clamp(100.0f * static_cast<float>(part) / static_cast<float>(whole), 0.0f, 100.0f);
+}
+} // namespace
+
+SystemStatsSampler::SystemStatsSampler()
+{
+    const long ticks = sysconf(_SC_CLK_TCK);
+    if (ticks > 0)
+        ticks_per_s_ = static_cast<double>(ticks);
+    const long page = sysconf(_SC_PAGESIZE);
+    if (page > 0)
+        page_kb_ = std::max(1L, page / 1024);
+}
+
+SystemStatsSampler::~SystemStatsSampler() = default;
+
+bool SystemStatsSampler::Sample(SystemStats &out)
+{
+    const auto now = std::chrono::steady_clock::now();
+    const bool have_prev = primed_;
+    const double elapsed_s = have_prev ? std::chrono::duration<double>(now - prev_time_).count() : 0.0;
+    prev_time_ = now;
+    primed_ = true;
+
+    ReadCpu(out, have_prev);
+    ReadMemory(out);
+    ReadSelf(out, elapsed_s, have_prev);
+    ReadThreads(out, elapsed_s);
+    out.valid = have_prev && elapsed_s > 0.0;
+    return out.valid;
+}
+
+void SystemStatsSampler::ReadCpu(SystemStats &out, bool have_prev)
+{
+    char buffer[kProcStatBuffer];
+    auto text = proc_stat_.Read(buffer, sizeof(buffer));
+    if (!text)
+        return;
+    size_t cores = 0;
+    while (!text->empty())
+    {
+        std::string_view line = NextLine(*text);
+        if (line.substr(0, 3) != "cpu")
+            break;
+        line.remove_prefix(3);
+        size_t slot = 0;
+        if (!line.empty() && line.front() != ' ')
+        {
+            uint64_t index = 0;
+            if (!NextNumber(line, index) || index >= kMaxCpuCores)
+                continue;
+            slot = static_cast<size_t>(index) + 1;
+            cores = std::max(cores, slot);
+        }
+        // user nice system idle iowait irq softirq steal
+        uint64_t values[8] = {};
+        size_t count = 0;
+        while (count < 8 && NextNumber(line, values[count]))
+            ++count;
+        if (count < 4)
+            continue;
+        CpuTimes times;
+        for (size_t i = 0; i < count; ++i)
+            times.total += values[i];
+        const uint64_t idle = values[3] + (count > 4 ? values[4] : 0);
+        times.busy = times.total - std::min(idle, times.total);
+
+        const CpuTimes &prev = cpu_prev_[slot];
+        float percent = 0.0f;
+        if (have_prev && times.total > prev.total && times.busy >= prev.busy)
+            percent = Percent(times.busy - prev.busy, times.total - prev.total);
+        if (slot == 0)
+            out.cpu_percent = percent;
+        else
+            out.core_percent[slot - 1] = percent;
+        cpu_prev_[slot] = times;
+    }
+    out.core_count = cores;
+}
+
+void SystemStatsSampler::ReadMemory(SystemStats &out)
+{
+    char buffer[kSmallProcBuffer];
+    auto text = meminfo_.Read(buffer, sizeof(buffer));
+    if (!text)
+        return;
+    while (!text->empty())
+    {
+        std::string_view line = NextLine(*text);
+        uint64_t *target = nullptr;
+        if (line.substr(0, 9) == "MemTotal:")
+            target = &out.mem_total_kb;
+        else if (line.substr(0, 13) == "MemAvailable:")
+            target = &out.mem_available_kb;
+        else
+            continue;
+        line.remove_prefix(line.find(':') + 1);
+        NextNumber(line, *target);
+    }
+}
+
+void SystemStatsSampler::ReadSelf(SystemStats &out, double elapsed_s, bool have_prev)
+{
+    char buffer[kSmallProcBuffer];
+    auto text = self_stat_.Read(buffer, sizeof(buffer));
+    std::string_view name, fields;
+    if (!text || !SplitTaskStat(*text, name, fields))
+        return;
+    uint64_t utime = 0, stime = 0, rss_pages = 0, num_threads = 0;
+    if (!TaskStatField(fields, kStatUtime, utime) || !TaskStatField(fields, kStatStime, stime))
+        return;
+    const uint64_t ticks = utime + stime;
+    if (have_prev && elapsed_s > 0.0 && ticks >= self_ticks_prev_)
+        out.self_cpu_percent =
+            static_cast<float>(100.0 * static_cast<double>(ticks - self_ticks_prev_) / ticks_per_s_ / elapsed_s);
+    self_ticks_prev_ = ticks;
+    if (TaskStatField(fields, kStatRss, rss_pages))
+        out.self_rss_kb = rss_pages * static_cast<uint64_t>(page_kb_);
+    if (TaskStatField(fields, kStatNumThreads, num_threads) && num_threads != thread_count_)
+        rescan_ = true;
+}
+
+void SystemStatsSampler::ReadThreads(SystemStats &out, double elapsed_s)
+{
+    if (rescan_)
+        RescanThreads();
+    out.top_thread[0] = '\0';
+    out.top_thread_percent = 0.0f;
+    for (size_t i = 0; i < thread_count_; ++i)
+    {
+        ThreadState &thread = threads_[i];
+        char buffer[kSmallProcBuffer];
+        auto text = thread.stat->Read(buffer, sizeof(buffer));
+        std::string_view name, fields;
+        uint64_t utime = 0, stime = 0;
+        if (!text || !SplitTaskStat(*text, name, fields) || !TaskStatField(fields, kStatUtime, utime) ||
+            !TaskStatField(fields, kStatStime, stime))
+        {
+            rescan_ = true; // the thread exited
+            continue;
+        }
+        const size_t len = std::min(name.size(), sizeof(thread.name) - 1);
+        std::memcpy(thread.name, name.data(), len);
+        thread.name[len] = '\0';
+
+        const uint64_t ticks = utime + stime;
+        if (thread.primed && elapsed_s > 0.0 && ticks >= thread.ticks)
+        {
+            const float percent =
+                static_cast<float>(100.0 * static_cast<double>(ticks - thread.ticks) / ticks_per_s_ / elapsed_s);
+            if (percent > out.top_thread_percent || out.top_thread[0] == '\0')
+            {
+                out.top_thread_percent = percent;
+                std::memcpy(out.top_thread, thread.name, sizeof(out.top_thread));
+            }
+        }
+        thread.ticks = ticks;
+        thread.primed = true;
+    }
+}
+
+bool SystemStatsSampler::RescanThreads()
+{
+    rescan_ = false;
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir)
+        return false;
+    std::array<ThreadState, kMaxSampledThreads> next;
+    size_t count = 0;
+    while (dirent *entry = readdir(dir))
+    {
+        int tid = 0;
+        const char *end = entry->d_name + std::strlen(entry->d_name);
+        auto result = std::from_chars(entry->d_name, end, tid);
+        if (result.ec != std::errc() || result.ptr != end)
+            continue;
+        if (count == next.size())
+            break;
+        // Known threads keep their fd and tick baseline.
+        auto known = std::find_if(threads_.begin(), threads_.begin() + thread_count_,
+                                  [tid](const ThreadState &t) { return t.tid == tid; });
+        if (known != threads_.begin() + thread_count_)
+        {
+            next[count++] = std::move(*known);
+            continue;
+        }
+        char path[64];
+        std::snprintf(path, sizeof(path), "/proc/self/task/%d/stat", tid);
+        ThreadState &thread = next[count++];
+        thread.tid = tid;
+        thread.stat = std::make_unique<SysfsAttribute>(path);
+    }
+    closedir(dir);
+    threads_ = std::move(next);
+    thread_count_ = count;
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "sysfs_sampler.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+constexpr size_t kMaxCpuCores = 8;
+constexpr size_t kMaxSampledThreads = 32;
+
+// Machine load plus AMLgsMenu's own share of it. CPU figures follow top(1):
+// cpu_percent and core_percent are busy time of the machine / of each core,
+// self and thread percentages are relative to one core.
+struct SystemStats
+{
+    float cpu_percent = 0.0f;
+    std::array<float, kMaxCpuCores> core_percent{};
+    size_t core_count = 0;
+    uint64_t mem_total_kb = 0;
+    uint64_t mem_available_kb = 0;
+    float self_cpu_percent = 0.0f;
+    uint64_t self_rss_kb = 0;
+    char top_thread[16] = {};
+    float top_thread_percent = 0.0f;
+    bool valid = false;
+};
+
+// Samples /proc/stat, /proc/meminfo, /proc/self/stat and
+// /proc/self/task/*/stat through fds kept open between samples. Parsing works
+// on fixed stack buffers; the thread list is only rebuilt when a thread
+// appears or exits. Percentages need two samples, so the first Sample() call
+// only primes the counters. Single-threaded.
+class SystemStatsSampler
+{
+public:
+    SystemStatsSampler();
+    ~SystemStatsSampler();
+
+    // Returns false until there is a previous sample to diff against.
+    bool Sample(SystemStats &out);
+
+private:
+    struct CpuTimes
+    {
+        uint64_t busy = 0;
+        uint64_t total = 0;
+    };
+
+    struct ThreadState
+    {
+        int tid = 0;
+        std::unique_ptr<SysfsAttribute> stat;
+        uint64_t ticks = 0;
+        char name[16] = {};
+        bool primed = false;
+    };
+
+    void ReadCpu(SystemStats &out, bool have_prev);
+    void ReadMemory(SystemStats &out);
+    void ReadSelf(SystemStats &out, double elapsed_s, bool have_prev);
+    void ReadThreads(SystemStats &out, double elapsed_s);
+    bool RescanThreads();
+
+    SysfsAttribute proc_stat_{"/proc/stat"};
+    SysfsAttribute meminfo_{"/proc/meminfo"};
+    SysfsAttribute self_stat_{"/proc/self/stat"};
+    std::array<CpuTimes, kMaxCpuCores + 1> cpu_prev_{}; // [0] is the aggregate line
+    uint64_t self_ticks_prev_ = 0;
+    std::array<ThreadState, kMaxSampledThreads> threads_;
+    size_t thread_count_ = 0;
+    bool rescan_ = true;
+    double ticks_per_s_ = 100.0;
+    long page_kb_ = 4;
+    std::chrono::steady_clock::time_point prev_time_{};
+    bool primed_ = false;
+};
@@ -1,15 +1,20 @@
 #include "telemetry_worker.h"
 
+#include "device_monitor.h"
+#include "hid_descriptor.h"
+#include "logger.h"
+#include "sysfs_sampler.h"
 #include "video_mode.h"
 
 #include <algorithm>
 #include <cctype>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <fstream>
 #include <optional>
 #include <thread>
 #include <vector>
-#include <set>
 #include <unordered_map>
 #include <cstdio>
 #include <cmath>
@@ -17,16 +22,19 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <cerrno>
 #include <cstring>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 namespace {
-constexpr std::chrono::seconds kLoopSleep{1};
-constexpr std::chrono::seconds kSignalInterval{2};
-constexpr std::chrono::seconds kTempInterval{1};
-constexpr std::chrono::seconds kFpsInterval{1};
-constexpr std::chrono::seconds kHidBatteryInterval{2};
+constexpr std::chrono::milliseconds kTempInterval{1000};
+constexpr std::chrono::milliseconds kVideoInterval{1000};
+constexpr std::chrono::milliseconds kHidBatteryInterval{2000};
+constexpr std::chrono::milliseconds kPowerSupplyInterval{2000};
+constexpr std::chrono::milliseconds kSystemInterval{1000};
 constexpr uint16_t kCemianVendorId = 0x2019;
 constexpr uint16_t kCemianProductId = 0x056D;
 constexpr size_t kCemianBatteryIndex = 6;
@@ -98,62 +106,64 @@ bool LooksLikeHidSupply(const std::string &name)
     return false;
 }
 
-std::optional<float> QueryHidBatteryPercent()
+// Battery-type power_supply devices, fed by udev hotplug events. type and
+// scope never change for a device, so they are read once when it is added;
+// present and capacity stay open as SysfsAttributes and are re-read with pread.
+class PowerSupplyMonitor
 {
-    namespace fs = std::filesystem;
-    const fs::path base("/sys/class/power_supply");
-    std::error_code ec;
-    if (!fs::exists(base, ec) || !fs::is_directory(base, ec))
-        return std::nullopt;
-
-    std::optional<float> fallback;
-    for (const auto &entry : fs::directory_iterator(base, ec))
+public:
+    void Add(const std::string &name, const std::string &syspath)
     {
-        if (!entry.is_directory())
-            continue;
-        const std::string name = entry.path().filename().string();
-        auto type = ReadSingleLine(entry.path() / "type");
-        if (!type || *type != "Battery")
-            continue;
-
-        auto scope = ReadSingleLine(entry.path() / "scope");
-        if (scope && scope->find("System") != std::string::npos)
-            continue;
-
-        auto present = ReadSingleLine(entry.path() / "present");
-        if (present && *present == "0")
-            continue;
+        Remove(name);
+        const std::filesystem::path base(syspath);
+        auto type = ReadSingleLine(base / "type");
+        auto scope = ReadSingleLine(base / "scope");
+        if (!type || *type != "Battery" || (scope && scope->find("System") != std::string::npos))
+            return;
+        Supply supply;
+        supply.name = name;
+        supply.hid_hint = LooksLikeHidSupply(name);
+        supply.present = std::make_unique<SysfsAttribute>((base / "present").string());
+        supply.capacity = std::make_unique<SysfsAttribute>((base / "capacity").string());
+        supplies_.push_back(std::move(supply));
+    }
 
-        auto capacity = ReadSingleLine(entry.path() / "capacity");
-        if (!capacity)
-            continue;
+    void Remove(const std::string &name)
+    {
+        supplies_.erase(std::remove_if(supplies_.begin(), supplies_.end(),
+                                       [&](const Supply &supply) { return supply.name == name; }),
+                        supplies_.end());
+    }
 
-        float pct = 0.0f;
-        try
-        {
-            pct = std::stof(*capacity);
-        }
-        catch (const std::exception &)
+    std::optional<float> Query()
+    {
+        std::optional<float> fallback;
+        for (auto &supply : supplies_)
         {
-            continue;
+            if (auto present = supply.present->ReadInt(); present && *present == 0)
+                continue;
+            auto capacity = supply.capacity->ReadInt();
+            if (!capacity)
+                continue;
+            const float pct = std::clamp(static_cast<float>(*capacity), 0.0f, 100.0f);
+            if (supply.hid_hint)
+                return pct;
+            if (!fallback)
+                fallback = pct;
         }
-        pct = std::clamp(pct, 0.0f, 100.0f);
-
-        if (LooksLikeHidSupply(name))
-            return pct;
-        if (!fallback)
-            fallback = pct;
+        return fallback;
     }
-    return fallback;
-}
 
-struct HidBatteryField
-{
-    uint8_t report_id = 0;
-    uint32_t bit_offset = 0;
-    uint8_t bit_size = 0;
-    bool is_feature = false;
-    uint32_t report_bits = 0;
+private:
+    struct Supply
+    {
+        std::string name;
+        bool hid_hint = false;
+        std::unique_ptr<SysfsAttribute> present;
+        std::unique_ptr<SysfsAttribute> capacity;
+    };
+
+    std::vector<Supply> supplies_;
 };
 
 class HidBatteryMonitor
@@ -169,297 +179,107 @@ public:
         }
     }
 
-    float Poll()
+    // Called for hidraw hotplug events; non-battery devices are closed again
+    // right after their descriptor is inspected.
+    void Add(const std::string &path)
     {
-        const auto now = std::chrono::steady_clock::now();
-        if (last_scan_.time_since_epoch().count() == 0 ||
-            (now - last_scan_) >= std::chrono::seconds(5))
+        for (const auto &dev : devices_)
         {
-            Rescan();
-            last_scan_ = now;
+            if (dev.path == path)
+                return;
         }
+        InitDevice(path);
+    }
 
-        float best = -1.0f;
-        for (auto it = devices_.begin(); it != devices_.end();)
+    void Remove(const std::string &path)
+    {
+        for (auto it = devices_.begin(); it != devices_.end(); ++it)
         {
-            float value = ReadDevice(*it);
-            if (it->fd < 0)
-            {
-                it = devices_.erase(it);
+            if (it->path != path)
                 continue;
-            }
-            if (value >= 0.0f)
-                best = value;
-            ++it;
+            if (it->fd >= 0)
+                close(it->fd);
+            devices_.erase(it);
+            return;
         }
-        return best;
     }
 
-private:
-    struct Device
+    std::vector<int> Fds() const
     {
-        int fd = -1;
-        std::string path;
-        HidBatteryField field;
-        size_t payload_bytes = 0;
-        bool logged_once = false;
-        float last_value = -1.0f;
-        bool manual = false;
-        size_t manual_index = 0;
-        size_t manual_report_len = 0;
-    };
-
-    void Rescan()
-    {
-        namespace fs = std::filesystem;
-        std::set<std::string> present;
-        std::error_code ec;
-        for (const auto &entry : fs::directory_iterator("/dev", ec))
+        std::vector<int> fds;
+        for (const auto &dev : devices_)
         {
-            if (!entry.is_character_file(ec))
-                continue;
-            const std::string name = entry.path().filename().string();
-            if (name.rfind("hidraw", 0) != 0)
-                continue;
-            std::string path = entry.path().string();
-            std::fprintf(stderr, "[Telemetry] found candidate %s\n", path.c_str());
-            present.insert(path);
-            bool known = false;
-            for (const auto &dev : devices_)
-            {
-                if (dev.path == path)
-                {
-                    known = true;
-                    break;
-                }
-            }
-            if (!known)
-                InitDevice(path);
+            if (dev.fd >= 0)
+                fds.push_back(dev.fd);
         }
+        return fds;
+    }
 
-        devices_.erase(std::remove_if(devices_.begin(), devices_.end(),
-                                      [&](Device &dev) {
-                                          if (present.count(dev.path) == 0)
-                                          {
-                                              if (dev.fd >= 0)
-                                                  close(dev.fd);
-                                              dev.fd = -1;
-                                              return true;
-                                          }
-                                          return false;
-                                      }),
-                       devices_.end());
-    }
-
-    static bool IsBatteryUsage(uint32_t usage)
-    {
-        uint16_t page = static_cast<uint16_t>(usage >> 16);
-        uint16_t code = static_cast<uint16_t>(usage & 0xFFFF);
-        if (page == 0x06 && code == 0x20)
-        {
-            std::fprintf(stderr, "[Telemetry] matched battery usage GD 0x%04x\n", code);
-            return true;
-        }
-        if (page == 0x84 && (code == 0x68 || code == 0x20))
+    // Drains every pending input report from the device behind fd. A device
+    // that fails is closed and forgotten; Fds() no longer lists it afterwards.
+    void OnReadable(int fd)
+    {
+        for (auto it = devices_.begin(); it != devices_.end(); ++it)
         {
-            std::fprintf(stderr, "[Telemetry] matched battery usage PD 0x%04x\n", code);
-            return true;
+            if (it->fd != fd)
+                continue;
+            DrainReports(*it);
+            if (it->fd < 0)
+                devices_.erase(it);
+            return;
         }
-        return false;
     }
 
-    static std::optional<HidBatteryField> ParseField(int fd)
+    // Feature-report devices have to be asked. Input-report devices that
+    // stayed silent since the last call get the same treatment as a fallback.
+    void PollFeatures()
     {
-        int desc_size = 0;
-        if (ioctl(fd, HIDIOCGRDESCSIZE, &desc_size) < 0 || desc_size <= 0)
-            return std::nullopt;
-        hidraw_report_descriptor desc{};
-        desc.size = std::min(desc_size, HID_MAX_DESCRIPTOR_SIZE);
-        if (ioctl(fd, HIDIOCGRDESC, &desc) < 0)
-            return std::nullopt;
-        std::fprintf(stderr, "[Telemetry] descriptor size %d (clamped %u)\n", desc_size, desc.size);
-
-        std::unordered_map<uint8_t, std::pair<uint32_t, uint32_t>> report_bits;
-        uint16_t usage_page = 0;
-        uint32_t report_size = 0;
-        uint32_t report_count = 0;
-        uint8_t report_id = 0;
-        std::vector<uint32_t> usages;
-        std::optional<uint32_t> usage_min;
-        std::optional<uint32_t> usage_max;
-        bool pending_battery_usage = false;
-
-        size_t i = 0;
-        while (i < desc.size)
+        for (auto it = devices_.begin(); it != devices_.end();)
         {
-            uint8_t b = desc.value[i++];
-            uint8_t item_size = b & 0x3;
-            if (item_size == 3)
-                item_size = 4;
-            if (i + item_size > desc.size)
-                break;
-            uint8_t type = (b >> 2) & 0x3;
-            uint8_t tag = (b >> 4) & 0xF;
-            uint32_t value = 0;
-            for (uint8_t n = 0; n < item_size; ++n)
-            {
-                value |= static_cast<uint32_t>(desc.value[i++]) << (8 * n);
-            }
-
-            if (type == 1) // Global
-            {
-                switch (tag)
-                {
-                case 0: usage_page = static_cast<uint16_t>(value); break;
-                case 7: report_size = value; break;
-                case 8: report_count = value; break;
-                case 10: report_id = static_cast<uint8_t>(value); break;
-                default: break;
-                }
-            }
-            else if (type == 2) // Local
-            {
-                switch (tag)
-                {
-                case 0: // Usage
-                {
-                    uint32_t usage = (static_cast<uint32_t>(usage_page) << 16) | (value & 0xFFFF);
-                    if (usage_page == 0x84)
-                        std::fprintf(stderr, "[Telemetry] saw usage page84 code=0x%04x\n", value & 0xFFFF);
-                    if (IsBatteryUsage(usage))
-                        pending_battery_usage = true;
-                    usages.push_back(usage);
-                    break;
-                }
-                case 1:
-                    usage_min = value & 0xFFFF;
-                    break;
-                case 2:
-                    usage_max = value & 0xFFFF;
-                    if (usage_min && usage_max && usage_max >= usage_min)
-                    {
-                        for (uint32_t u = *usage_min; u <= *usage_max && usages.size() < 32; ++u)
-                        {
-                            usages.push_back((static_cast<uint32_t>(usage_page) << 16) | u);
-                        }
-                    }
-                    usage_min.reset();
-                    usage_max.reset();
-                    break;
-                default:
-                    break;
-                }
-            }
-            else if (type == 0) // Main
+            if (!it->manual && (it->field.is_feature || !it->report_seen))
+                FetchFeature(*it);
+            it->report_seen = false;
+            if (it->fd < 0)
             {
-                bool is_input = (tag == 8);
-                bool is_feature = (tag == 11);
-                if ((is_input || is_feature) && report_size > 0 && report_count > 0)
-                {
-                    auto &state = report_bits[report_id];
-                    uint32_t offset = is_feature ? state.second : state.first;
-                    uint32_t total_bits = report_size * report_count;
-                    std::fprintf(stderr,
-                                 "[Telemetry] main item report_id=%u type=%s size=%u count=%u usages=%zu pending=%d offset=%u\n",
-                                 report_id, is_feature ? "feature" : "input", report_size, report_count,
-                                 usages.size(), pending_battery_usage ? 1 : 0, offset);
-                    if (usages.empty() && usage_min && usage_max && usage_max >= usage_min)
-                    {
-                        for (uint32_t u = *usage_min; u <= *usage_max && usages.size() < 32; ++u)
-                        {
-                            usages.push_back((static_cast<uint32_t>(usage_page) << 16) | u);
-                        }
-                    }
-                    for (size_t idx = 0; idx < report_count; ++idx)
-                    {
-                        bool usage_is_batt = false;
-                        if (idx < usages.size())
-                        {
-                            std::fprintf(stderr, "[Telemetry] checking usage 0x%08x (page=0x%04x code=0x%04x)\n",
-                                         usages[idx], static_cast<uint16_t>(usages[idx] >> 16),
-                                         static_cast<uint16_t>(usages[idx] & 0xFFFF));
-                            usage_is_batt = IsBatteryUsage(usages[idx]);
-                            if (usage_is_batt)
-                                std::fprintf(stderr, "[Telemetry] usage slot %zu matches battery\n", idx);
-                        }
-                        else if (pending_battery_usage && idx == 0)
-                        {
-                            std::fprintf(stderr, "[Telemetry] assuming pending battery usage in mixed block\n");
-                            usage_is_batt = true;
-                        }
-
-                        if (usage_is_batt)
-                        {
-                            HidBatteryField field{};
-                            field.report_id = report_id;
-                            field.bit_offset = offset + static_cast<uint32_t>(idx) * report_size;
-                            field.bit_size = std::min<uint32_t>(report_size, 16);
-                            field.is_feature = is_feature;
-                            field.report_bits = offset + total_bits;
-                            std::fprintf(stderr, "[Telemetry] battery field resolved report_id=%u offset=%u size=%u\n",
-                                         field.report_id, field.bit_offset, field.bit_size);
-                            return field;
-                        }
-                    }
-                    if (pending_battery_usage)
-                    {
-                        HidBatteryField field{};
-                        field.report_id = report_id;
-                        field.bit_offset = offset;
-                        field.bit_size = report_size ? std::min<uint32_t>(report_size, 16) : 8;
-                        field.is_feature = is_feature;
-                        field.report_bits = offset + total_bits;
-                        std::fprintf(stderr, "[Telemetry] fallback battery field report_id=%u offset=%u size=%u\n",
-                                     field.report_id, field.bit_offset, field.bit_size);
-                        return field;
-                    }
-                    pending_battery_usage = false;
-                    if (is_feature)
-                        state.second += total_bits;
-                    else
-                        state.first += total_bits;
-                    usages.clear();
-                    usage_min.reset();
-                    usage_max.reset();
-                }
-                else if (tag == 10)
-                {
-                    usages.clear();
-                    usage_min.reset();
-                    usage_max.reset();
-                }
+                it = devices_.erase(it);
+                continue;
             }
+            ++it;
         }
-        return std::nullopt;
     }
 
-    static float ExtractValue(const uint8_t *data, size_t len, const HidBatteryField &field)
+    // Most recent battery reading from any open device, or -1.
+    float Latest() const
     {
-        if (field.bit_size == 0)
-            return -1.0f;
-        const size_t needed_bits = field.bit_offset + field.bit_size;
-        if (needed_bits > len * 8)
-            return -1.0f;
-        uint32_t raw = 0;
-        for (uint32_t bit = 0; bit < field.bit_size; ++bit)
+        float best = -1.0f;
+        for (const auto &dev : devices_)
         {
-            uint32_t idx = field.bit_offset + bit;
-            uint8_t byte = data[idx / 8];
-            raw |= ((byte >> (idx % 8)) & 0x1u) << bit;
+            if (dev.last_value >= 0.0f)
+                best = dev.last_value;
         }
-        uint32_t max_value = (field.bit_size >= 31) ? 0xFFFFFFFFu : ((1u << field.bit_size) - 1u);
-        if (max_value == 0)
-            return -1.0f;
-        float pct = (static_cast<float>(raw) * 100.0f) / static_cast<float>(max_value);
-        return std::clamp(pct, 0.0f, 100.0f);
+        return best;
     }
 
+private:
+    struct Device
+    {
+        int fd = -1;
+        std::string path;
+        HidBatteryField field;
+        size_t payload_bytes = 0;
+        bool report_seen = false;
+        float last_value = -1.0f;
+        bool manual = false;
+        size_t manual_index = 0;
+        size_t manual_report_len = 0;
+    };
+
     bool InitDevice(const std::string &path)
     {
         int fd = open(path.c_str(), O_RDWR | O_NONBLOCK);
         if (fd < 0)
             return false;
-        auto field = ParseField(fd);
+        auto field = ResolveField(fd, path);
         Device dev;
         dev.fd = fd;
         dev.path = path;
@@ -470,24 +290,50 @@ private:
                 devices_.push_back(std::move(dev));
                 return true;
             }
-            std::fprintf(stderr, "[Telemetry] %s has no battery usage\n", path.c_str());
+            LOG_INFO("Telemetry", "%s has no battery usage", path.c_str());
             close(fd);
             return false;
         }
         dev.field = *field;
         dev.payload_bytes = (field->report_bits + 7) / 8;
-        std::fprintf(stderr, "[Telemetry] HID device %s report_id=%u bits=%u feature=%d\n",
-                     path.c_str(), dev.field.report_id, dev.field.report_bits, dev.field.is_feature ? 1 : 0);
+        LOG_INFO("Telemetry", "HID device %s report_id=%u bits=%u feature=%d",
+                 path.c_str(), dev.field.report_id, dev.field.report_bits, dev.field.is_feature ? 1 : 0);
         devices_.push_back(std::move(dev));
         return true;
     }
 
+    // Descriptors are only walked the first time a VID/PID/descriptor
+    // combination is seen; reconnects are answered from field_cache_.
+    std::optional<HidBatteryField> ResolveField(int fd, const std::string &path)
+    {
+        hidraw_devinfo info{};
+        if (ioctl(fd, HIDIOCGRAWINFO, &info) < 0)
+            return std::nullopt;
+        int desc_size = 0;
+        if (ioctl(fd, HIDIOCGRDESCSIZE, &desc_size) < 0 || desc_size <= 0)
+            return std::nullopt;
+        hidraw_report_descriptor desc{};
+        desc.size = std::min(desc_size, HID_MAX_DESCRIPTOR_SIZE);
+        if (ioctl(fd, HIDIOCGRDESC, &desc) < 0)
+            return std::nullopt;
+
+        const auto vendor = static_cast<uint16_t>(info.vendor);
+        const auto product = static_cast<uint16_t>(info.product);
+        const uint64_t hash = HashHidDescriptor(desc.value, desc.size);
+        if (auto cached = field_cache_.Find(vendor, product, hash))
+            return *cached;
+
+        const bool verbose = Logger::Shared().Enabled("HidDescriptor", LogLevel::Debug);
+        auto field = FindHidBatteryField(desc.value, desc.size, verbose);
+        LOG_INFO("Telemetry", "%s %04x:%04x descriptor %u bytes parsed, battery %s", path.c_str(), vendor, product,
+                 desc.size, field ? "found" : "absent");
+        field_cache_.Store(vendor, product, hash, field);
+        return field;
+    }
+
     bool ConfigureManualDevice(Device &dev)
     {
-        struct hidraw_devinfo info
-        {
-            0
-        };
+        hidraw_devinfo info{};
         if (ioctl(dev.fd, HIDIOCGRAWINFO, &info) < 0)
             return false;
         if (static_cast<uint16_t>(info.vendor) != kCemianVendorId ||
@@ -496,165 +342,250 @@ private:
         dev.manual = true;
         dev.manual_index = kCemianBatteryIndex;
         dev.manual_report_len = kCemianReportLength;
-        std::fprintf(stderr, "[Telemetry] %s using manual HID fallback\n", dev.path.c_str());
+        LOG_INFO("Telemetry", "%s using manual HID fallback", dev.path.c_str());
         return true;
     }
 
-    float ReadDevice(Device &dev)
+    void UpdateValue(Device &dev, float pct, const char *how)
     {
-        if (dev.fd < 0)
-            return -1.0f;
+        if (pct < 0.0f)
+            return;
+        if (pct != dev.last_value)
+            LOG_DEBUG("Telemetry", "HID %s battery %.1f%%%s", dev.path.c_str(), pct, how);
+        dev.last_value = pct;
+    }
 
+    size_t ReportLength(const Device &dev) const
+    {
         if (dev.manual)
-            return ReadManualDevice(dev);
-
-        if (dev.payload_bytes == 0)
-            return -1.0f;
-        const size_t total_len = dev.payload_bytes + (dev.field.report_id ? 1 : 0);
-        std::vector<uint8_t> buffer(total_len ? total_len : 1, 0);
-        auto fetch_feature = [&](std::vector<uint8_t> &buf) -> bool {
-            if (dev.field.report_id && !buf.empty())
-                buf[0] = dev.field.report_id;
-            const int req_len = static_cast<int>(buf.size());
-            if (ioctl(dev.fd, HIDIOCGFEATURE(req_len), buf.data()) < 0)
-            {
-                if (errno == ENODEV || errno == EIO)
-                {
-                    close(dev.fd);
-                    dev.fd = -1;
-                }
-                std::fprintf(stderr, "[Telemetry] HID %s feature ioctl failed errno=%d\n",
-                             dev.path.c_str(), errno);
-                return false;
-            }
-            if (!buf.empty())
-                std::fprintf(stderr, "[Telemetry] HID %s feature len=%d first=0x%02x\n",
-                             dev.path.c_str(), req_len, buf[0]);
-            else
-                std::fprintf(stderr, "[Telemetry] HID %s feature len=%d\n", dev.path.c_str(), req_len);
-            return true;
-        };
+            return dev.manual_report_len;
+        return dev.payload_bytes + (dev.field.report_id ? 1 : 0);
+    }
 
-        if (dev.field.is_feature)
-        {
-            if (!fetch_feature(buffer))
-                return -1.0f;
-        }
-        else
+    void DrainReports(Device &dev)
+    {
+        const size_t report_len = ReportLength(dev);
+        if (report_len == 0)
+            return;
+        uint8_t buffer[HID_MAX_DESCRIPTOR_SIZE];
+        const size_t read_len = std::min(report_len, sizeof(buffer));
+        while (dev.fd >= 0)
         {
-            auto attempt_read = [&]() -> ssize_t {
-                return read(dev.fd, buffer.data(), buffer.size());
-            };
-
-            ssize_t rd = attempt_read();
-            if (rd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
-            {
-                pollfd pfd{};
-                pfd.fd = dev.fd;
-                pfd.events = POLLIN;
-                int pr = poll(&pfd, 1, 100);
-                if (pr > 0)
-                    rd = attempt_read();
-            }
-
+            ssize_t rd = read(dev.fd, buffer, read_len);
             if (rd < 0)
             {
-                if (errno == EAGAIN || errno == EWOULDBLOCK)
-                {
-                    std::fprintf(stderr, "[Telemetry] HID %s read timeout -> feature fallback\n",
-                                 dev.path.c_str());
-                    if (!fetch_feature(buffer))
-                        return -1.0f;
-                }
-                else
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
                 {
-                    std::fprintf(stderr, "[Telemetry] HID %s read failed errno=%d\n",
-                                 dev.path.c_str(), errno);
+                    LOG_WARN("Telemetry", "HID %s read failed errno=%d", dev.path.c_str(), errno);
                     close(dev.fd);
                     dev.fd = -1;
-                    return -1.0f;
                 }
+                return;
             }
-            else if (dev.field.report_id && buffer[0] != dev.field.report_id)
+            if (rd == 0)
+                return;
+            if (dev.manual)
             {
-                std::fprintf(stderr,
-                             "[Telemetry] HID %s read report_id mismatch got=0x%02x expect=0x%02x\n",
-                             dev.path.c_str(), buffer.empty() ? 0 : buffer[0], dev.field.report_id);
-                return -1.0f;
+                if (rd > static_cast<ssize_t>(dev.manual_index))
+                {
+                    dev.report_seen = true;
+                    UpdateValue(dev, std::clamp(static_cast<float>(buffer[dev.manual_index]), 0.0f, 100.0f),
+                                " (manual)");
+                }
+                continue;
             }
-            else
+            if (dev.field.is_feature || (dev.field.report_id && buffer[0] != dev.field.report_id))
+                continue; // some other report from the same device
+            dev.report_seen = true;
+            const uint8_t *payload = buffer + (dev.field.report_id ? 1 : 0);
+            const size_t payload_len = static_cast<size_t>(rd) - (dev.field.report_id ? 1 : 0);
+            UpdateValue(dev, ExtractHidBatteryPercent(payload, payload_len, dev.field), "");
+        }
+    }
+
+    void FetchFeature(Device &dev)
+    {
+        if (dev.fd < 0 || dev.payload_bytes == 0)
+            return;
+        std::vector<uint8_t> buffer(dev.payload_bytes + (dev.field.report_id ? 1 : 0), 0);
+        if (dev.field.report_id)
+            buffer[0] = dev.field.report_id;
+        const int req_len = static_cast<int>(buffer.size());
+        if (ioctl(dev.fd, HIDIOCGFEATURE(req_len), buffer.data()) < 0)
+        {
+            const int err = errno;
+            LOG_EVERY_MS(LogLevel::Warn, "Telemetry", 30000, "HID %s feature ioctl failed errno=%d", dev.path.c_str(),
+                         err);
+            if (err == ENODEV || err == EIO)
             {
-                std::fprintf(stderr, "[Telemetry] HID %s read %zd bytes first=0x%02x\n",
-                             dev.path.c_str(), rd, buffer.empty() ? 0 : buffer[0]);
+                close(dev.fd);
+                dev.fd = -1;
             }
+            return;
         }
         const uint8_t *payload = buffer.data() + (dev.field.report_id ? 1 : 0);
-        float pct = ExtractValue(payload, dev.payload_bytes, dev.field);
-        if (pct >= 0.0f)
+        UpdateValue(dev, ExtractHidBatteryPercent(payload, dev.payload_bytes, dev.field), " (feature)");
+    }
+
+    std::vector<Device> devices_;
+    HidFieldCache field_cache_;
+};
+
+// Single-threaded epoll reactor. Every source is an fd: periodic sources own
+// a timerfd, device sources are read when they become readable.
+class EventLoop
+{
+public:
+    EventLoop()
+        : epoll_fd_(epoll_create1(EPOLL_CLOEXEC))
+    {
+        if (epoll_fd_ < 0)
+            LOG_ERROR("Telemetry", "epoll_create1: %s", std::strerror(errno));
+    }
+
+    ~EventLoop()
+    {
+        for (const auto &timer : timers_)
+            close(timer.fd);
+        if (epoll_fd_ >= 0)
+            close(epoll_fd_);
+    }
+
+    bool Valid() const { return epoll_fd_ >= 0; }
+
+    // Runs fn now and then every period, independently of the other sources.
+    // Stretchable timers follow ScaleTimers().
+    bool AddTimer(std::chrono::milliseconds period, std::function<void()> fn, bool stretchable = true)
+    {
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (fd < 0)
         {
-            std::fprintf(stderr, "[Telemetry] HID %s battery %.1f%%\n", dev.path.c_str(), pct);
-            dev.logged_once = true;
-            dev.last_value = pct;
+            LOG_ERROR("Telemetry", "timerfd_create: %s", std::strerror(errno));
+            return false;
         }
-        return pct;
+        itimerspec spec{};
+        spec.it_value.tv_nsec = 1; // fire immediately
+        spec.it_interval = ToTimespec(Scaled(period, stretchable));
+        timerfd_settime(fd, 0, &spec, nullptr);
+        timers_.push_back(Timer{fd, period, stretchable});
+        return AddReadable(fd, [fd, fn = std::move(fn)]() {
+            uint64_t expirations = 0;
+            if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+                fn();
+        });
     }
 
-    float ReadManualDevice(Device &dev)
+    bool AddReadable(int fd, std::function<void()> fn)
     {
-        if (dev.manual_report_len == 0)
-            return -1.0f;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            LOG_ERROR("Telemetry", "epoll_ctl add: %s", std::strerror(errno));
+            return false;
+        }
+        handlers_[fd] = std::move(fn);
+        return true;
+    }
 
-        std::vector<uint8_t> buffer(dev.manual_report_len, 0);
-        auto attempt_read = [&]() -> ssize_t {
-            return read(dev.fd, buffer.data(), buffer.size());
-        };
+    // Safe to call from a handler, including for an fd already closed.
+    void Remove(int fd)
+    {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        handlers_.erase(fd);
+    }
+
+    bool Has(int fd) const { return handlers_.count(fd) != 0; }
 
-        ssize_t rd = attempt_read();
-        if (rd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    // Re-arms every stretchable timer at its base period times factor; the
+    // next expiry is one new period from now.
+    void ScaleTimers(float factor)
+    {
+        scale_ = std::max(factor, 1.0f);
+        for (const auto &timer : timers_)
         {
-            pollfd pfd{};
-            pfd.fd = dev.fd;
-            pfd.events = POLLIN;
-            int pr = poll(&pfd, 1, 100);
-            if (pr > 0)
-                rd = attempt_read();
+            if (!timer.stretchable)
+                continue;
+            itimerspec spec{};
+            spec.it_interval = ToTimespec(Scaled(timer.period, true));
+            spec.it_value = spec.it_interval;
+            timerfd_settime(timer.fd, 0, &spec, nullptr);
         }
+    }
+
+    // Dispatches events until running goes false; a write to wake_fd
+    // interrupts the wait.
+    void Run(int wake_fd, const std::atomic<bool> &running)
+    {
+        epoll_event wake{};
+        wake.events = EPOLLIN;
+        wake.data.fd = wake_fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd, &wake);
 
-        if (rd < 0)
+        epoll_event events[16];
+        while (running)
         {
-            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            int n = epoll_wait(epoll_fd_, events, 16, -1);
+            if (n < 0)
             {
-                std::fprintf(stderr, "[Telemetry] HID %s manual read failed errno=%d\n",
-                             dev.path.c_str(), errno);
-                close(dev.fd);
-                dev.fd = -1;
+                if (errno == EINTR)
+                    continue;
+                LOG_ERROR("Telemetry", "epoll_wait: %s", std::strerror(errno));
+                break;
+            }
+            for (int i = 0; i < n && running; ++i)
+            {
+                if (events[i].data.fd == wake_fd)
+                    continue;
+                auto it = handlers_.find(events[i].data.fd);
+                if (it == handlers_.end())
+                    continue; // removed by an earlier handler in this batch
+                auto handler = it->second;
+                handler();
             }
-            return -1.0f;
         }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, wake_fd, nullptr);
+    }
 
-        if (rd <= static_cast<ssize_t>(dev.manual_index))
-        {
-            std::fprintf(stderr, "[Telemetry] HID %s manual short read %zd\n",
-                         dev.path.c_str(), rd);
-            return -1.0f;
-        }
+private:
+    struct Timer
+    {
+        int fd = -1;
+        std::chrono::milliseconds period{};
+        bool stretchable = true;
+    };
 
-        uint8_t raw = buffer[dev.manual_index];
-        float pct = std::clamp(static_cast<float>(raw), 0.0f, 100.0f);
-        std::fprintf(stderr, "[Telemetry] HID %s battery %.1f%% (manual)\n",
-                     dev.path.c_str(), pct);
-        dev.logged_once = true;
-        dev.last_value = pct;
-        return pct;
+    std::chrono::milliseconds Scaled(std::chrono::milliseconds period, bool stretchable) const
+    {
+        if (!stretchable)
+            return period;
+        return std::chrono::milliseconds(static_cast<int64_t>(static_cast<double>(period.count()) * scale_));
     }
 
-    std::vector<Device> devices_;
-    std::chrono::steady_clock::time_point last_scan_{};
+    static timespec ToTimespec(std::chrono::milliseconds period)
+    {
+        timespec ts{};
+        ts.tv_sec = static_cast<time_t>(period.count() / 1000);
+        ts.tv_nsec = static_cast<long>((period.count() % 1000) * 1000000);
+        return ts;
+    }
+
+    int epoll_fd_ = -1;
+    float scale_ = 1.0f;
+    std::vector<Timer> timers_;
+    std::unordered_map<int, std::function<void()>> handlers_;
 };
 }
-
-TelemetryWorker::TelemetryWorker(SignalMonitor *signal_monitor)
-    : signal_monitor_(signal_monitor) {}
+TelemetryWorker::TelemetryWorker(SignalMonitor *signal_monitor, bool sample_system, ThermalPolicy *thermal)
+    : signal_monitor_(signal_monitor), sample_system_(sample_system), thermal_(thermal) {
+    if (signal_monitor_) {
+        // Ground signal is pushed from the monitor thread as records arrive.
+        signal_monitor_->SetUpdateCallback([this]() { OnSignalUpdate(); });
+    }
+}
 
 TelemetryWorker::~TelemetryWorker() {
     Stop();
@@ -664,6 +595,10 @@ void TelemetryWorker::Start() {
     if (running_.exchange(true)) {
         return;
     }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        LOG_ERROR("Telemetry", "eventfd: %s", std::strerror(errno));
+    }
     worker_ = std::thread(&TelemetryWorker::ThreadMain, this);
 }
 
@@ -671,9 +606,17 @@ void TelemetryWorker::Stop() {
     if (!running_.exchange(false)) {
         return;
     }
+    if (wake_fd_ >= 0) {
+        const uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+    }
     if (worker_.joinable()) {
         worker_.join();
     }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
 }
 
 TelemetryWorker::Snapshot TelemetryWorker::Latest() const {
@@ -681,85 +624,156 @@ TelemetryWorker::Snapshot TelemetryWorker::Latest() const {
     return latest_;
 }
 
-void TelemetryWorker::ThreadMain() {
-    HidBatteryMonitor hid_monitor;
-    auto last_signal = std::chrono::steady_clock::time_point{};
-    auto last_temp = std::chrono::steady_clock::time_point{};
-    auto last_fps = std::chrono::steady_clock::time_point{};
-    auto last_hid_batt = std::chrono::steady_clock::time_point{};
+uint64_t TelemetryWorker::Sequence() const {
+    return sequence_.load(std::memory_order_acquire);
+}
 
-    std::fprintf(stderr, "[Telemetry] worker thread start\n");
+template <typename Fn>
+void TelemetryWorker::Publish(Fn &&update) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        update(latest_);
+        latest_.timestamp = std::chrono::steady_clock::now();
+    }
+    sequence_.fetch_add(1, std::memory_order_release);
+}
 
-    while (running_) {
-        const auto now = std::chrono::steady_clock::now();
+void TelemetryWorker::OnSignalUpdate() {
+    const auto signal = signal_monitor_->Latest();
+    const auto rate = signal_monitor_->LatestRate();
+    Publish([&](Snapshot &snap) {
+        snap.ground_signal = signal;
+        snap.packet_rate = rate;
+    });
+}
 
-        if (signal_monitor_) {
-            if (last_signal.time_since_epoch().count() == 0 ||
-                (now - last_signal) >= kSignalInterval) {
-                signal_monitor_->Poll();
-                last_signal = now;
-            }
-        }
+void TelemetryWorker::ThreadMain() {
+    pthread_setname_np(pthread_self(), "telemetry");
+    LOG_INFO("Telemetry", "worker thread start");
 
-        Snapshot snap;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            snap = latest_;
-        }
+    EventLoop loop;
+    if (!loop.Valid() || wake_fd_ < 0) {
+        LOG_ERROR("Telemetry", "worker thread stop (no event loop)");
+        return;
+    }
 
-        if (signal_monitor_) {
-            snap.ground_signal = signal_monitor_->Latest();
-            snap.packet_rate = signal_monitor_->LatestRate();
-        }
-        bool updated = false;
-        if (last_temp.time_since_epoch().count() == 0 ||
-            (now - last_temp) >= kTempInterval) {
-            snap.ground_temp_c = ReadTemperatureC();
-            snap.has_ground_temp = true;
-            last_temp = now;
-            updated = true;
+    // Ground signal arrives through OnSignalUpdate on the monitor's own
+    // thread; everything else is scheduled here.
+    HidBatteryMonitor hid_monitor;
+    PowerSupplyMonitor power_supply;
+    float supply_percent = -1.0f;
+    bool started = false;
+    auto publish_battery = [&]() {
+        float hid = hid_monitor.Latest();
+        if (hid < 0.0f) {
+            hid = supply_percent;
         }
-
-        if (last_fps.time_since_epoch().count() == 0 ||
-            (now - last_fps) >= kFpsInterval) {
-            snap.output_fps = GetOutputFps();
-            last_fps = now;
-            updated = true;
+        Publish([&](Snapshot &snap) {
+            snap.has_hid_batt = hid >= 0.0f;
+            if (snap.has_hid_batt) {
+                snap.hid_batt_percent = hid;
+            }
+        });
+    };
+    // Keeps the loop's readable set in step with the open hidraw devices.
+    std::vector<int> hid_fds;
+    std::function<void()> sync_hid = [&]() {
+        const auto fds = hid_monitor.Fds();
+        for (int fd : hid_fds) {
+            if (std::find(fds.begin(), fds.end(), fd) == fds.end()) {
+                loop.Remove(fd);
+            }
         }
-
-        if (last_hid_batt.time_since_epoch().count() == 0 ||
-            (now - last_hid_batt) >= kHidBatteryInterval) {
-            const float hid_value = hid_monitor.Poll();
-            if (hid_value >= 0.0f) {
-                snap.hid_batt_percent = hid_value;
-                snap.has_hid_batt = true;
-            } else {
-                auto hid = QueryHidBatteryPercent();
-                if (hid.has_value()) {
-                    snap.hid_batt_percent = hid.value();
-                    snap.has_hid_batt = true;
-                } else {
-                    snap.has_hid_batt = false;
-                }
+        for (int fd : fds) {
+            if (!loop.Has(fd)) {
+                loop.AddReadable(fd, [&, fd]() {
+                    const float before = hid_monitor.Latest();
+                    hid_monitor.OnReadable(fd);
+                    sync_hid();
+                    if (hid_monitor.Latest() != before) {
+                        publish_battery();
+                    }
+                });
             }
-            last_hid_batt = now;
-            updated = true;
         }
+        hid_fds = fds;
+    };
 
-        if (signal_monitor_) {
-            updated = true;
+    // The temperature timer keeps its period so the thermal policy can also
+    // step back down promptly; every other timer stretches with the level.
+    loop.AddTimer(kTempInterval, [&]() {
+        const float temp = ReadTemperatureC();
+        if (thermal_ && thermal_->Update(temp)) {
+            loop.ScaleTimers(thermal_->WorkerPeriodScale());
         }
-
-        if (updated) {
-            snap.timestamp = now;
-            std::lock_guard<std::mutex> lock(mutex_);
-            latest_ = snap;
+        Publish([&](Snapshot &snap) {
+            snap.ground_temp_c = temp;
+            snap.has_ground_temp = true;
+        });
+    }, false);
+    VideoStatsCollector video_stats;
+    loop.AddTimer(kVideoInterval, [&]() {
+        VideoStats video;
+        video_stats.Sample(video);
+        Publish([&](Snapshot &snap) {
+            snap.video = video;
+            snap.output_fps = video.output_fps > 0 ? video.output_fps : video.input_fps;
+        });
+    });
+    auto query_supply = [&]() {
+        supply_percent = power_supply.Query().value_or(-1.0f);
+        publish_battery();
+    };
+    // Devices are opened and closed only on hotplug events; capacity changes
+    // on a power_supply also arrive as change events and publish right away.
+    DeviceMonitor devices;
+    auto on_device = [&](const DeviceMonitor::Event &event) {
+        if (event.subsystem == "hidraw" && !event.devnode.empty()) {
+            if (event.action == DeviceMonitor::Action::Add) {
+                hid_monitor.Add(event.devnode);
+            } else if (event.action == DeviceMonitor::Action::Remove) {
+                hid_monitor.Remove(event.devnode);
+                publish_battery();
+            }
+            sync_hid();
+        } else if (event.subsystem == "power_supply") {
+            if (event.action == DeviceMonitor::Action::Remove) {
+                power_supply.Remove(event.sysname);
+            } else if (event.action == DeviceMonitor::Action::Add) {
+                power_supply.Add(event.sysname, event.syspath);
+            }
+            if (started) {
+                query_supply();
+            }
         }
+    };
+    if (devices.Start({"hidraw", "power_supply"})) {
+        loop.AddReadable(devices.Fd(), [&]() { devices.Dispatch(on_device); });
+    } else {
+        LOG_WARN("Telemetry", "udev monitor unavailable, HID/power_supply hotplug disabled");
+    }
+    devices.Enumerate("hidraw", on_device);
+    devices.Enumerate("power_supply", on_device);
+    started = true;
+    loop.AddTimer(kHidBatteryInterval, [&]() {
+        hid_monitor.PollFeatures();
+        sync_hid();
+        publish_battery();
+    });
+    loop.AddTimer(kPowerSupplyInterval, query_supply);
+    SystemStatsSampler system_sampler;
+    if (sample_system_) {
+        loop.AddTimer(kSystemInterval, [&]() {
+            SystemStats stats;
+            if (system_sampler.Sample(stats)) {
+                Publish([&](Snapshot &snap) { snap.system = stats; });
+            }
+        });
+    }
 
-        if (!running_) {
-            break;
-        }
-        std::this_thread::sleep_for(kLoopSleep);
+    loop.Run(wake_fd_, running_);
+    for (int fd : hid_fds) {
+        loop.Remove(fd);
     }
-    std::fprintf(stderr, "[Telemetry] worker thread stop\n");
+    LOG_INFO("Telemetry", "worker thread stop");
 }
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "signal_monitor.h"
+#include "system_stats.h"
+#include "thermal_policy.h"
+#include "video_stats.h"
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <thread>
 
@@ -15,24 +19,40 @@ public:
         float ground_temp_c = 0.0f;
         bool has_ground_temp = false;
         int output_fps = 0;
+        VideoStats video{};
         float hid_batt_percent = 0.0f;
         bool has_hid_batt = false;
+        SystemStats system{};
         std::chrono::steady_clock::time_point timestamp = std::chrono::steady_clock::time_point::min();
     };
 
-    TelemetryWorker(SignalMonitor *signal_monitor);
+    // sample_system enables the /proc CPU/memory sampler behind Snapshot::system.
+    // thermal, if given, is fed every temperature sample and stretches the
+    // polling periods as the SoC heats up.
+    TelemetryWorker(SignalMonitor *signal_monitor, bool sample_system = false, ThermalPolicy *thermal = nullptr);
     ~TelemetryWorker();
 
     void Start();
     void Stop();
     Snapshot Latest() const;
+    // Bumped every time a source publishes into the snapshot; the render thread
+    // compares it against the last value it drew to pick up changes promptly.
+    uint64_t Sequence() const;
 
 private:
     void ThreadMain();
+    void OnSignalUpdate();
+    // Applies update to the shared snapshot and bumps the sequence counter.
+    template <typename Fn>
+    void Publish(Fn &&update);
 
     SignalMonitor *signal_monitor_ = nullptr;
+    bool sample_system_ = false;
+    ThermalPolicy *thermal_ = nullptr;
     std::thread worker_;
     std::atomic<bool> running_{false};
+    std::atomic<uint64_t> sequence_{0};
+    int wake_fd_ = -1;
     mutable std::mutex mutex_;
     Snapshot latest_;
 };
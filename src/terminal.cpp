@@ -5,11 +5,13 @@
 	Adapted from the MIT-licensed ImGui-Terminal project (Neal 2025).
 */
 #include "terminal.h"
+#include "logger.h"
 
 // Files.h dependency removed - not needed for standalone terminal
 // Settings dependency removed - using hardcoded values instead
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <iostream>
 #include <signal.h>
 #include <sys/ioctl.h>
@@ -564,8 +566,6 @@ void Terminal::handleTerminalResize()
 
 	if (new_cols != state.col || new_rows != state.row)
 	{
-		std::cout << "resizing terminal" << std::endl;
-
 		resize(new_cols, new_rows);
 	}
 }
@@ -2580,9 +2580,9 @@ void Terminal::resize(int cols, int rows)
 
 	} catch (const std::exception &e)
 	{
-		std::cerr << "Error during resize: " << e.what() << std::endl;
+		LOG_ERROR("Terminal", "error during resize: %s", e.what());
 	}
-	std::cout << "Resized to " << cols << "x" << rows << std::endl;
+	LOG_DEBUG("Terminal", "resized to %dx%d", cols, rows);
 }
 
 void Terminal::enableBracketedPaste()
@@ -2730,6 +2730,7 @@ void Terminal::SendSignal(int sig)
 
 void Terminal::readOutput()
 {
+	pthread_setname_np(pthread_self(), "term-read");
 	char buffer[4096];
 	while (!shouldTerminate)
 	{
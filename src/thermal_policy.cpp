@@ -0,0 +1,94 @@
+#include "thermal_policy.h"
+
+#include "logger.h"
+
+#include <algorithm>
+
+namespace
+{
+struct LevelSettings
+{
+    float osd_hz;
+    int data_interval_ms;
+    float worker_scale;
+};
+
+// Indexed by ThermalLevel.
+constexpr LevelSettings kLevelSettings[] = {
+    {30.0f, 0, 1.0f},
+    {20.0f, 100, 2.0f},
+    {15.0f, 250, 3.0f},
+    {10.0f, 500, 5.0f},
+};
+} // namespace
+
+ThermalPolicy::ThermalPolicy(ThermalConfig config)
+    : config_(config)
+{
+    // Keep the thresholds ordered even if the config file is not.
+    config_.hot_c = std::max(config_.hot_c, config_.warm_c);
+    config_.critical_c = std::max(config_.critical_c, config_.hot_c);
+    config_.hysteresis_c = std::max(config_.hysteresis_c, 0.0f);
+}
+
+float ThermalPolicy::EntryThreshold(ThermalLevel level) const
+{
+    switch (level)
+    {
+    case ThermalLevel::Warm: return config_.warm_c;
+    case ThermalLevel::Hot: return config_.hot_c;
+    case ThermalLevel::Critical: return config_.critical_c;
+    default: return -1000.0f;
+    }
+}
+
+bool ThermalPolicy::Update(float temp_c)
+{
+    const int current = level_.load(std::memory_order_relaxed);
+    int next = current;
+    // Climb as far as the temperature warrants, then step down one level at a
+    // time while below the current level's exit point.
+    while (next < static_cast<int>(ThermalLevel::Critical) &&
+           temp_c >= EntryThreshold(static_cast<ThermalLevel>(next + 1)))
+        ++next;
+    if (next == current)
+    {
+        while (next > static_cast<int>(ThermalLevel::Normal) &&
+               temp_c < EntryThreshold(static_cast<ThermalLevel>(next)) - config_.hysteresis_c)
+            --next;
+    }
+    if (next == current)
+        return false;
+    level_.store(next, std::memory_order_relaxed);
+    const LevelSettings &settings = kLevelSettings[next];
+    LOG_WARN("Thermal", "%.1fC: %s -> %s (OSD %.0fHz, telemetry periods x%.1f)", temp_c,
+             LevelName(static_cast<ThermalLevel>(current)), LevelName(static_cast<ThermalLevel>(next)),
+             settings.osd_hz, settings.worker_scale);
+    return true;
+}
+
+float ThermalPolicy::OsdRefreshHz() const
+{
+    return kLevelSettings[static_cast<int>(Level())].osd_hz;
+}
+
+std::chrono::milliseconds ThermalPolicy::OsdDataInterval() const
+{
+    return std::chrono::milliseconds(kLevelSettings[static_cast<int>(Level())].data_interval_ms);
+}
+
+float ThermalPolicy::WorkerPeriodScale() const
+{
+    return kLevelSettings[static_cast<int>(Level())].worker_scale;
+}
+
+const char *ThermalPolicy::LevelName(ThermalLevel level)
+{
+    switch (level)
+    {
+    case ThermalLevel::Warm: return "warm";
+    case ThermalLevel::Hot: return "hot";
+    case ThermalLevel::Critical: return "critical";
+    default: return "normal";
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+enum class ThermalLevel
+{
+    Normal = 0,
+    Warm,
+    Hot,
+    Critical,
+};
+
+// Entry thresholds for each level above Normal. A level is left again once
+// the temperature drops hysteresis_c below its entry threshold.
+struct ThermalConfig
+{
+    float warm_c = 70.0f;
+    float hot_c = 78.0f;
+    float critical_c = 85.0f;
+    float hysteresis_c = 3.0f;
+};
+
+// Maps SoC temperature to how much work AMLgsMenu allows itself, so the
+// overlay gives way before the decoder would be throttled. Update() is called
+// from the telemetry thread; the accessors are safe from any thread.
+class ThermalPolicy
+{
+public:
+    explicit ThermalPolicy(ThermalConfig config = {});
+
+    // Feeds one temperature sample; returns true when the level changed.
+    bool Update(float temp_c);
+    ThermalLevel Level() const { return static_cast<ThermalLevel>(level_.load(std::memory_order_relaxed)); }
+
+    // Render loop frame rate for the current level.
+    float OsdRefreshHz() const;
+    // Minimum spacing of OSD telemetry refreshes; zero means every update.
+    std::chrono::milliseconds OsdDataInterval() const;
+    // Factor applied to the telemetry worker's polling periods.
+    float WorkerPeriodScale() const;
+
+    static const char *LevelName(ThermalLevel level);
+
+private:
+    float EntryThreshold(ThermalLevel level) const;
+
+    ThermalConfig config_;
+    std::atomic<int> level_{static_cast<int>(ThermalLevel::Normal)};
+};
@@ -1,8 +1,12 @@
 #include "udp_command_client.h"
 
+#include "logger.h"
+
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -11,10 +15,17 @@
 #include <cstdio>
 #include <cstring>
 #include <cctype>
-#include <iostream>
 
-UdpCommandClient::UdpCommandClient(const std::string &ip, uint16_t tx_port, uint16_t rx_port)
-    : tx_port_(tx_port), rx_port_(rx_port), ip_(ip)
+namespace
+{
+std::chrono::steady_clock::time_point DeadlineIn(int timeout_ms)
+{
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+}
+} // namespace
+
+UdpCommandClient::UdpCommandClient(const std::string &ip, uint16_t tx_port, uint16_t rx_port, bool request_ids)
+    : tx_port_(tx_port), rx_port_(rx_port), ip_(ip), request_ids_(request_ids)
 {
     tx_fd_ = socket(AF_INET, SOCK_DGRAM, 0);
     if (tx_fd_ < 0)
@@ -39,10 +50,26 @@ UdpCommandClient::UdpCommandClient(const std::string &ip, uint16_t tx_port, uint
             rx_fd_ = -1;
         }
     }
+    if (rx_fd_ >= 0)
+    {
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        rx_thread_ = std::thread(&UdpCommandClient::ReceiveLoop, this);
+    }
 }
 
 UdpCommandClient::~UdpCommandClient()
 {
+    StopAsync();
+    stopping_ = true;
+    if (wake_fd_ >= 0)
+    {
+        uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+    }
+    if (rx_thread_.joinable())
+        rx_thread_.join();
+    if (wake_fd_ >= 0)
+        close(wake_fd_);
     if (tx_fd_ >= 0)
         close(tx_fd_);
     if (rx_fd_ >= 0)
@@ -54,15 +81,29 @@ bool UdpCommandClient::Send(const std::string &cmd, bool expect_reply, int timeo
     if (expect_reply)
     {
         std::vector<std::string> discard;
-        return Execute(cmd, &discard, timeout_ms);
+        return CommandAccepted(Execute(cmd, &discard, {}, timeout_ms, nullptr));
     }
-    return Execute(cmd, nullptr, timeout_ms);
+    return CommandAccepted(Execute(cmd, nullptr, {}, timeout_ms, nullptr));
 }
 
 bool UdpCommandClient::SendWithReply(const std::string &cmd, std::vector<std::string> &response, int timeout_ms)
 {
     response.clear();
-    return Execute(cmd, &response, timeout_ms);
+    return CommandAccepted(Execute(cmd, &response, {}, timeout_ms, nullptr));
+}
+
+CommandStatus UdpCommandClient::ExecuteCancellable(const std::string &cmd, std::vector<std::string> &response,
+                                                   std::chrono::steady_clock::time_point deadline,
+                                                   const CommandCancelToken &cancel)
+{
+    return Execute(cmd, &response, deadline, -1, &cancel);
+}
+
+void UdpCommandClient::WakeWaiters()
+{
+    // Taking the lock orders the wake-up after a waiter's predicate check.
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv_.notify_all();
 }
 
 std::string UdpCommandClient::Trim(const std::string &text)
@@ -80,137 +121,207 @@ std::string UdpCommandClient::Trim(const std::string &text)
     return text.substr(begin, end - begin);
 }
 
-bool UdpCommandClient::Execute(const std::string &cmd, std::vector<std::string> *response, int timeout_ms)
+CommandStatus UdpCommandClient::Execute(const std::string &cmd, std::vector<std::string> *response,
+                                        std::chrono::steady_clock::time_point deadline, int timeout_ms,
+                                        const CommandCancelToken *cancel)
 {
-    std::unique_lock<std::mutex> lock(io_mutex_);
     if (tx_fd_ < 0)
     {
-        std::cout << "[AMLgsMenu] tx_fd_ < 0" << std::endl;
-        return false;
+        LOG_EVERY_MS(LogLevel::Error, "UdpCommand", 5000, "no tx socket, dropping command: %s", cmd.c_str());
+        return CommandStatus::Failed;
     }
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
     addr.sin_port = htons(tx_port_);
     if (inet_pton(AF_INET, ip_.c_str(), &addr.sin_addr) != 1)
     {
-        std::fprintf(stderr, "[AMLgsMenu] invalid UDP target IP: %s\n", ip_.c_str());
-        return false;
+        LOG_ERROR("UdpCommand", "invalid UDP target IP: %s", ip_.c_str());
+        return CommandStatus::Failed;
     }
-    ssize_t n = sendto(tx_fd_, cmd.data(), cmd.size(), 0, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
-    if (n < 0)
+    if (response)
     {
-        std::perror("[AMLgsMenu] sendto");
-        return false;
+        response->clear();
     }
-    if (rx_fd_ < 0)
+
+    Pending pending;
+    pending.response = response;
+    const auto cancelled = [cancel]() { return cancel && cancel->IsCancelled(); };
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Untagged replies can only be matched by order, so without a tag-aware
+    // peer there is at most one command in flight. A relative timeout starts
+    // once the command owns the slot; the one in flight ends by its own
+    // deadline, so queueing behind it is bounded.
+    const auto slot_free = [&]() { return peer_tags_ || pending_.empty() || cancelled(); };
+    if (timeout_ms >= 0)
     {
-        std::perror("[AMLgsMenu] sendto rxfd < 0");
-        return true;
+        cv_.wait(lock, slot_free);
     }
-
-    if (response)
+    else if (!cv_.wait_until(lock, deadline, slot_free))
     {
-        response->clear();
+        LOG_EVERY_MS(LogLevel::Warn, "UdpCommand", 5000, "busy, dropping command: %s", cmd.c_str());
+        return CommandStatus::Failed;
     }
+    if (cancelled())
+    {
+        return CommandStatus::Cancelled;
+    }
+    if (timeout_ms >= 0)
+    {
+        deadline = DeadlineIn(timeout_ms);
+    }
+    pending.id = next_id_++;
+    if (rx_fd_ >= 0)
+    {
+        pending_.push_back(&pending);
+    }
+    lock.unlock();
 
-    bool ack_received = false;
-    bool done = false;
-    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
-    char buf[1024];
-
-    while (true)
+    const std::string wire = request_ids_ ? "#id:" + std::to_string(pending.id) + "\n" + cmd : cmd;
+    ssize_t n = sendto(tx_fd_, wire.data(), wire.size(), 0, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    lock.lock();
+    if (n < 0 || rx_fd_ < 0)
     {
-        auto now = std::chrono::steady_clock::now();
-        if (now >= deadline)
+        if (n < 0)
         {
-            break;
+            LOG_ERROR("UdpCommand", "sendto: %s", std::strerror(errno));
         }
-        pollfd pfd{};
-        pfd.fd = rx_fd_;
-        pfd.events = POLLIN;
-        int wait_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
-        int pr = poll(&pfd, 1, wait_ms);
+        pending_.remove(&pending);
+        cv_.notify_all();
+        return n >= 0 ? CommandStatus::Ok : CommandStatus::Failed;
+    }
+
+    cv_.wait_until(lock, deadline, [&]() { return pending.done || cancelled(); });
+    pending_.remove(&pending);
+    cv_.notify_all();
+    if (!pending.done && cancelled())
+    {
+        return CommandStatus::Cancelled;
+    }
+    if (!pending.ack)
+    {
+        LOG_EVERY_MS(LogLevel::Warn, "UdpCommand", 5000, "no ACK received for command: %s", cmd.c_str());
+        return CommandStatus::Failed;
+    }
+    if (pending.sky_timeout || !pending.done)
+    {
+        LOG_EVERY_MS(LogLevel::Warn, "UdpCommand", 5000, "command timed out%s: %s",
+                     pending.sky_timeout ? " on the sky side" : "", cmd.c_str());
+        return CommandStatus::TimedOut;
+    }
+    return CommandStatus::Ok;
+}
+
+void UdpCommandClient::ReceiveLoop()
+{
+    pthread_setname_np(pthread_self(), "udp-cmd-rx");
+    char buf[1024];
+    while (!stopping_)
+    {
+        pollfd fds[2]{};
+        fds[0].fd = rx_fd_;
+        fds[0].events = POLLIN;
+        fds[1].fd = wake_fd_;
+        fds[1].events = POLLIN;
+        // Without an eventfd the loop falls back to checking stopping_ periodically.
+        int pr = poll(fds, wake_fd_ >= 0 ? 2 : 1, wake_fd_ >= 0 ? -1 : 200);
         if (pr < 0)
         {
             if (errno == EINTR)
             {
                 continue;
             }
-            std::perror("[AMLgsMenu] poll");
-            return false;
-        }
-        if (pr == 0)
-        {
+            LOG_ERROR("UdpCommand", "poll: %s", std::strerror(errno));
             break;
         }
-        if (!(pfd.revents & POLLIN))
+        if (pr == 0 || !(fds[0].revents & POLLIN))
         {
             continue;
         }
-        sockaddr_in from{};
-        socklen_t fromlen = sizeof(from);
-        ssize_t rn = recvfrom(rx_fd_, buf, sizeof(buf), 0, reinterpret_cast<sockaddr *>(&from), &fromlen);
+        ssize_t rn = recv(rx_fd_, buf, sizeof(buf), 0);
         if (rn < 0)
         {
-            if (errno == EINTR)
+            if (errno != EINTR && errno != EAGAIN)
             {
-                continue;
+                LOG_EVERY_MS(LogLevel::Error, "UdpCommand", 5000, "recv: %s", std::strerror(errno));
             }
-            std::perror("[AMLgsMenu] recvfrom");
-            return false;
+            continue;
         }
-        std::string packet(buf, buf + rn);
-        std::string trimmed = Trim(packet);
-        if (trimmed == "OK")
+        Dispatch(std::string(buf, buf + rn));
+    }
+}
+
+void UdpCommandClient::Dispatch(const std::string &packet)
+{
+    std::string text = Trim(packet);
+    std::lock_guard<std::mutex> lock(mutex_);
+    Pending *target = nullptr;
+    // Tagged replies look like "#<id> <payload>".
+    uint32_t id = 0;
+    size_t digits = 0;
+    if (request_ids_ && text.size() > 1 && text[0] == '#')
+    {
+        while (1 + digits < text.size() && std::isdigit(static_cast<unsigned char>(text[1 + digits])))
+        {
+            id = id * 10 + static_cast<uint32_t>(text[1 + digits] - '0');
+            ++digits;
+        }
+    }
+    if (digits > 0 && (1 + digits == text.size() || text[1 + digits] == ' '))
+    {
+        text = Trim(text.substr(1 + digits));
+        if (!peer_tags_)
+        {
+            LOG_INFO("UdpCommand", "sky daemon tags replies, allowing concurrent commands");
+            peer_tags_ = true;
+        }
+        for (Pending *pending : pending_)
         {
-            if (!ack_received)
+            if (pending->id == id)
             {
-                ack_received = true;
-                continue;
+                target = pending;
+                break;
             }
-            done = true;
-            break;
         }
-        if (response && !trimmed.empty())
+        if (!target)
         {
-            response->push_back(trimmed);
+            LOG_DEBUG("UdpCommand", "dropping reply to finished command #%u: %s", id, text.c_str());
+            return;
         }
     }
-
-    if (!ack_received)
+    else
     {
-        std::cout << "[AMLgsMenu] no ACK received for command: " << cmd << std::endl;
-        return false;
+        if (peer_tags_)
+        {
+            // The daemon was replaced by one that does not tag; fall back to
+            // one command at a time. This reply cannot be attributed.
+            LOG_WARN("UdpCommand", "untagged reply from sky daemon, matching replies by order again");
+            peer_tags_ = false;
+            return;
+        }
+        if (pending_.empty())
+        {
+            LOG_DEBUG("UdpCommand", "dropping late reply: %s", text.c_str());
+            return;
+        }
+        target = pending_.front();
     }
 
-    if (!done)
+    if (text == "OK")
     {
-        // flush any pending final OK without blocking
-        while (true)
+        if (target->ack)
         {
-            pollfd pfd{};
-            pfd.fd = rx_fd_;
-            pfd.events = POLLIN;
-            int pr = poll(&pfd, 1, 0);
-            if (pr <= 0 || !(pfd.revents & POLLIN))
-            {
-                break;
-            }
-            sockaddr_in from{};
-            socklen_t fromlen = sizeof(from);
-            ssize_t rn = recvfrom(rx_fd_, buf, sizeof(buf), 0, reinterpret_cast<sockaddr *>(&from), &fromlen);
-            if (rn <= 0)
-            {
-                break;
-            }
-            std::string trimmed = Trim(std::string(buf, buf + rn));
-            if (trimmed == "OK")
-            {
-                done = true;
-                break;
-            }
+            target->done = true;
         }
+        target->ack = true;
     }
-
-    return true;
+    else if (text == "timeout")
+    {
+        // The daemon's own command timeout; its final "OK" still follows.
+        target->sky_timeout = true;
+    }
+    else if (target->response && !text.empty())
+    {
+        target->response->push_back(text);
+    }
+    cv_.notify_all();
 }
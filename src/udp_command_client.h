@@ -2,14 +2,29 @@
 
 #include "command_transport.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <list>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+// Sends shell commands to the sky daemon as UDP datagrams. The daemon replies
+// with "OK" (ACK), one datagram per output line and a final "OK".
+//
+// With request_ids set, each command is prefixed with a "#id:<n>" comment
+// line, which legacy daemons run as a no-op. A daemon that understands the tag
+// prefixes its replies with "#<n> ". Once such a reply is seen, several
+// commands may be in flight at once and replies to commands that already
+// timed out are dropped. Until then, and whenever untagged replies show up,
+// commands go out one at a time and replies are matched by order as before.
 class UdpCommandClient : public CommandTransport {
 public:
-    UdpCommandClient(const std::string &ip = "127.0.0.1", uint16_t tx_port = 14650, uint16_t rx_port = 14651);
+    UdpCommandClient(const std::string &ip = "127.0.0.1", uint16_t tx_port = 14650, uint16_t rx_port = 14651,
+                     bool request_ids = false);
     ~UdpCommandClient();
 
     // Fire-and-forget command; still waits for ACK but discards output.
@@ -18,14 +33,45 @@ public:
     bool SendWithReply(const std::string &cmd, std::vector<std::string> &response,
                        int timeout_ms = 1000) override;
 
+protected:
+    CommandStatus ExecuteCancellable(const std::string &cmd, std::vector<std::string> &response,
+                                     std::chrono::steady_clock::time_point deadline,
+                                     const CommandCancelToken &cancel) override;
+    void WakeWaiters() override;
+
 private:
-    bool Execute(const std::string &cmd, std::vector<std::string> *response, int timeout_ms);
+    struct Pending {
+        uint32_t id = 0;
+        bool ack = false;
+        bool done = false;
+        // The daemon reported that the command timed out on its side.
+        bool sky_timeout = false;
+        std::vector<std::string> *response = nullptr;
+    };
+
+    // With timeout_ms >= 0 the deadline is ignored and the command gets
+    // timeout_ms from the moment it may be sent.
+    CommandStatus Execute(const std::string &cmd, std::vector<std::string> *response,
+                          std::chrono::steady_clock::time_point deadline, int timeout_ms,
+                          const CommandCancelToken *cancel);
+    void ReceiveLoop();
+    void Dispatch(const std::string &packet);
     static std::string Trim(const std::string &text);
 
     int tx_fd_ = -1;
     int rx_fd_ = -1;
+    int wake_fd_ = -1;
     uint16_t tx_port_ = 0;
     uint16_t rx_port_ = 0;
     std::string ip_;
-    std::mutex io_mutex_;
+    bool request_ids_ = false;
+
+    // Guards everything below; cv_ is signalled on any change to pending_.
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::list<Pending *> pending_;
+    uint32_t next_id_ = 1;
+    bool peer_tags_ = false;
+    std::atomic<bool> stopping_{false};
+    std::thread rx_thread_;
 };
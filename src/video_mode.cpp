@@ -1,10 +1,15 @@
 #include "video_mode.h"
 
+#include "sysfs_sampler.h"
+#include "video_stats.h"
+
+#include <atomic>
+#include <cctype>
 #include <fstream>
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
-#include <chrono>
+#include <string_view>
 
 namespace {
 VideoMode MakeModeFromLegacy(int height, int refresh, const std::string &label) {
@@ -73,58 +78,21 @@ std::vector<VideoMode> LoadHdmiModes(const std::string &path) {
 }
 
 int GetOutputFps(const std::string &path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        return 0;
-    }
-    std::string line;
-    if (!std::getline(file, line)) {
-        return 0;
-    }
-    std::stringstream ss(line);
-    std::string token;
-    auto parse_val = [](const std::string &s) -> int {
-        if (s.empty()) return 0;
-        char *end = nullptr;
-        long v = std::strtol(s.c_str(), &end, 0);
-        if (end == s.c_str()) return 0;
-        return static_cast<int>(v);
-    };
     int output = 0;
     int input = 0;
-    while (ss >> token) {
-        auto pos = token.find("output_fps:");
-        if (pos != std::string::npos) {
-            output = parse_val(token.substr(pos + std::strlen("output_fps:")));
-        }
-        pos = token.find("input_fps:");
-        if (pos != std::string::npos) {
-            input = parse_val(token.substr(pos + std::strlen("input_fps:")));
-        }
-    }
+    int drop = 0;
+    SysfsSampler::Shared().Read(path, [&](std::string_view text) { ParseFpsInfo(text, input, output, drop); });
     if (output > 0) return output;
     return input;
 }
 
 float ReadTemperatureC(const std::string &path) {
-    static auto last_read = std::chrono::steady_clock::time_point{};
-    static float cached = 0.0f;
-
-    auto now = std::chrono::steady_clock::now();
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_read).count();
-    const bool need_read = (last_read.time_since_epoch().count() == 0 || ms >= 1000);
-    if (!need_read) {
-        return cached;
-    }
-
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        return cached;
+    // Keeps the last good reading if the zone briefly fails to read.
+    static std::atomic<float> cached{0.0f};
+    auto milli = SysfsSampler::Shared().ReadInt(path);
+    if (milli) {
+        cached = static_cast<float>(*milli) / 1000.0f;
     }
-    int milli = 0;
-    file >> milli;
-    cached = static_cast<float>(milli) / 1000.0f;
-    last_read = now;
     return cached;
 }
 
@@ -0,0 +1,218 @@
+#include "video_stats.h"
+
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <string_view>
+
+namespace {
+// vdec_status has a block of ~15 lines per decoder channel.
+constexpr size_t kStatusBuffer = 2048;
+
+std::string_view Trim(std::string_view text) {
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// First whitespace separated token as an integer; "60 fps" -> 60, "0x3c" -> 60.
+std::optional<int64_t> LeadingInt(std::string_view text) {
+    text = Trim(text);
+    size_t len = 0;
+    while (len < text.size() && !std::isspace(static_cast<unsigned char>(text[len]))) {
+        ++len;
+    }
+    return ParseSysfsInt(text.substr(0, len), 0);
+}
+
+// Calls fn(key, value) for each "key<sep>value" line, both sides trimmed.
+// Lines without sep are passed with an empty value (section headers).
+template <typename Fn>
+void ForEachField(std::string_view text, char sep, Fn &&fn) {
+    while (!text.empty()) {
+        const size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+        const size_t pos = line.find(sep);
+        if (pos == std::string_view::npos) {
+            fn(Trim(line), std::string_view{});
+        } else {
+            fn(Trim(line.substr(0, pos)), Trim(line.substr(pos + 1)));
+        }
+    }
+}
+
+std::string Join(const std::string &root, const char *relative) {
+    std::string path = root;
+    if (!path.empty() && path.back() != '/') {
+        path += '/';
+    }
+    return path + relative;
+}
+} // namespace
+
+bool ParseFpsInfo(std::string_view text, int &input, int &output, int &drop) {
+    // One line of "key:value" tokens; the values are usually hex.
+    text = text.substr(0, text.find('\n'));
+    bool found = false;
+    const auto find_val = [&](std::string_view key, int &value) {
+        const size_t pos = text.find(key);
+        if (pos == std::string_view::npos) {
+            return;
+        }
+        if (auto parsed = LeadingInt(text.substr(pos + key.size()))) {
+            value = static_cast<int>(*parsed);
+            found = true;
+        }
+    };
+    find_val("input_fps:", input);
+    find_val("output_fps:", output);
+    find_val("drop_fps:", drop);
+    return found;
+}
+
+VideoStatsCollector::VideoStatsCollector(const std::string &sysfs_root)
+    : fps_info_(Join(sysfs_root, "class/video/fps_info")),
+      vdec_status_(Join(sysfs_root, "class/vdec/vdec_status")),
+      amstream_bufs_(Join(sysfs_root, "class/amstream/bufs")),
+      vframe_states_(Join(sysfs_root, "class/video/vframe_states")) {}
+
+bool VideoStatsCollector::Sample(VideoStats &out) {
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed_s =
+        prev_time_ == std::chrono::steady_clock::time_point{} ? 0.0
+                                                              : std::chrono::duration<double>(now - prev_time_).count();
+    prev_time_ = now;
+
+    out = VideoStats{};
+    ReadFps(out);
+    ReadVdec(out, elapsed_s);
+    ReadBuffers(out);
+    ReadDisplayQueue(out);
+    out.timestamp = now;
+    out.valid = out.has_fps || out.has_vdec || out.has_buffer || out.has_display_queue;
+    return out.valid;
+}
+
+void VideoStatsCollector::ReadFps(VideoStats &out) {
+    char buffer[SysfsAttribute::kBufferSize];
+    auto text = fps_info_.Read(buffer);
+    if (!text || !ParseFpsInfo(*text, out.input_fps, out.output_fps, out.drop_fps)) {
+        return;
+    }
+    out.has_fps = true;
+
+    input_history_[history_head_] = out.input_fps;
+    output_history_[history_head_] = out.output_fps;
+    history_head_ = (history_head_ + 1) % kVideoFpsHistory;
+    history_count_ = std::min(history_count_ + 1, kVideoFpsHistory);
+    int input_sum = 0;
+    int output_sum = 0;
+    out.output_fps_min = out.output_fps;
+    for (size_t i = 0; i < history_count_; ++i) {
+        input_sum += input_history_[i];
+        output_sum += output_history_[i];
+        out.output_fps_min = std::min(out.output_fps_min, output_history_[i]);
+    }
+    out.input_fps_avg = static_cast<float>(input_sum) / static_cast<float>(history_count_);
+    out.output_fps_avg = static_cast<float>(output_sum) / static_cast<float>(history_count_);
+}
+
+void VideoStatsCollector::ReadVdec(VideoStats &out, double elapsed_s) {
+    char buffer[kStatusBuffer];
+    auto text = vdec_status_.Read(buffer, sizeof(buffer));
+    if (!text) {
+        return;
+    }
+    bool found = false;
+    ForEachField(*text, ':', [&](std::string_view key, std::string_view value) {
+        uint64_t *target = nullptr;
+        if (key == "frame count") {
+            target = &out.frames_decoded;
+        } else if (key == "drop count") {
+            target = &out.frames_dropped;
+        } else if (key == "fra err count" || key == "hw err count") {
+            target = &out.decode_errors;
+        }
+        if (!target) {
+            return;
+        }
+        if (auto parsed = LeadingInt(value); parsed && *parsed >= 0) {
+            *target += static_cast<uint64_t>(*parsed);
+            found = true;
+        }
+    });
+    if (!found) {
+        // "No vdec" when nothing is decoding; the counters restart with the next stream.
+        have_prev_counters_ = false;
+        return;
+    }
+    out.has_vdec = true;
+    if (have_prev_counters_ && elapsed_s > 0.0 && out.frames_dropped >= prev_dropped_ &&
+        out.decode_errors >= prev_errors_) {
+        out.dropped_per_s = static_cast<float>(static_cast<double>(out.frames_dropped - prev_dropped_) / elapsed_s);
+        out.errors_per_s = static_cast<float>(static_cast<double>(out.decode_errors - prev_errors_) / elapsed_s);
+    }
+    prev_dropped_ = out.frames_dropped;
+    prev_errors_ = out.decode_errors;
+    have_prev_counters_ = true;
+}
+
+void VideoStatsCollector::ReadBuffers(VideoStats &out) {
+    char buffer[kStatusBuffer];
+    auto text = amstream_bufs_.Read(buffer, sizeof(buffer));
+    if (!text) {
+        return;
+    }
+    // Sections start with "Video buffer:", "Audio buffer:", ...
+    bool in_video = false;
+    bool has_size = false;
+    bool has_level = false;
+    ForEachField(*text, ':', [&](std::string_view key, std::string_view value) {
+        if (value.empty() && key.size() > 7 && key.substr(key.size() - 7) == " buffer") {
+            in_video = key == "Video buffer";
+            return;
+        }
+        if (!in_video) {
+            return;
+        }
+        auto parsed = LeadingInt(value);
+        if (!parsed || *parsed < 0) {
+            return;
+        }
+        if (key == "buf size") {
+            out.buffer_size = static_cast<uint32_t>(*parsed);
+            has_size = true;
+        } else if (key == "buf level") {
+            out.buffer_level = static_cast<uint32_t>(*parsed);
+            has_level = true;
+        }
+    });
+    if (!has_size || !has_level || out.buffer_size == 0) {
+        return;
+    }
+    out.has_buffer = true;
+    out.buffer_percent =
+        std::min(100.0f, 100.0f * static_cast<float>(out.buffer_level) / static_cast<float>(out.buffer_size));
+}
+
+void VideoStatsCollector::ReadDisplayQueue(VideoStats &out) {
+    char buffer[kStatusBuffer];
+    auto text = vframe_states_.Read(buffer, sizeof(buffer));
+    if (!text) {
+        return;
+    }
+    ForEachField(*text, '=', [&](std::string_view key, std::string_view value) {
+        if (key != "vframe buf_avail_num") {
+            return;
+        }
+        if (auto parsed = LeadingInt(value)) {
+            out.display_queue = static_cast<int>(*parsed);
+            out.has_display_queue = true;
+        }
+    });
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "sysfs_sampler.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+constexpr size_t kVideoFpsHistory = 10;
+
+// Decoder and display pipeline counters from the Amlogic video/vdec/amstream
+// drivers. Each group has its own has_* flag because which attributes exist
+// depends on the kernel and on whether a stream is playing.
+struct VideoStats {
+    // class/video/fps_info
+    bool has_fps = false;
+    int input_fps = 0;
+    int output_fps = 0;
+    int drop_fps = 0;
+    // input/output fps over the last kVideoFpsHistory samples
+    float input_fps_avg = 0.0f;
+    float output_fps_avg = 0.0f;
+    int output_fps_min = 0;
+
+    // class/vdec/vdec_status, summed over decoder channels
+    bool has_vdec = false;
+    uint64_t frames_decoded = 0;
+    uint64_t frames_dropped = 0;
+    uint64_t decode_errors = 0;
+    float dropped_per_s = 0.0f;
+    float errors_per_s = 0.0f;
+
+    // class/amstream/bufs, video section
+    bool has_buffer = false;
+    uint32_t buffer_size = 0;
+    uint32_t buffer_level = 0;
+    float buffer_percent = 0.0f;
+
+    // class/video/vframe_states: decoded frames waiting for display
+    bool has_display_queue = false;
+    int display_queue = 0;
+
+    bool valid = false;
+    std::chrono::steady_clock::time_point timestamp{};
+};
+
+// Parses the one-line fps_info attribute ("input_fps:0x3c output_fps:0x3c
+// drop_fps:0x0"). Leaves absent keys untouched; false if none was found.
+bool ParseFpsInfo(std::string_view text, int &input, int &output, int &drop);
+
+// Samples the attributes above relative to sysfs_root, so it can be pointed
+// at a copied or synthetic tree off-target. Missing or unparsable attributes
+// just leave their group unset. Single-threaded.
+class VideoStatsCollector {
+public:
+    explicit VideoStatsCollector(const std::string &sysfs_root = "/sys");
+
+    // Fills out; returns false when none of the attributes could be read.
+    bool Sample(VideoStats &out);
+
+private:
+    void ReadFps(VideoStats &out);
+    void ReadVdec(VideoStats &out, double elapsed_s);
+    void ReadBuffers(VideoStats &out);
+    void ReadDisplayQueue(VideoStats &out);
+
+    SysfsAttribute fps_info_;
+    SysfsAttribute vdec_status_;
+    SysfsAttribute amstream_bufs_;
+    SysfsAttribute vframe_states_;
+
+    std::array<int, kVideoFpsHistory> input_history_{};
+    std::array<int, kVideoFpsHistory> output_history_{};
+    size_t history_head_ = 0;
+    size_t history_count_ = 0;
+
+    uint64_t prev_dropped_ = 0;
+    uint64_t prev_errors_ = 0;
+    bool have_prev_counters_ = false;
+    std::chrono::steady_clock::time_point prev_time_{};
+};
@@ -0,0 +1,73 @@
+#include "wfb_log_parser.h"
+
+#include <charconv>
+
+namespace
+{
+// Returns the text up to the next delimiter and advances `rest` past it. Once
+// the input is exhausted `rest` becomes a null view, so a missing field can be
+// told apart from an empty one.
+std::string_view NextToken(std::string_view &rest, char delim)
+{
+    const size_t pos = rest.find(delim);
+    const std::string_view token = rest.substr(0, pos);
+    rest = (pos == std::string_view::npos) ? std::string_view{} : rest.substr(pos + 1);
+    return token;
+}
+
+template <typename T>
+bool ParseNumber(std::string_view text, T &out, int base = 10)
+{
+    if (text.empty())
+        return false;
+    const char *end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, out, base);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+template <typename T, size_t N>
+bool ParseCounters(std::string_view text, T *const (&values)[N])
+{
+    for (size_t i = 0; i < N; ++i)
+    {
+        if (text.data() == nullptr || !ParseNumber(NextToken(text, ':'), *values[i]))
+            return false;
+    }
+    return true;
+}
+} // namespace
+
+WfbLogRecord ParseWfbLogMessage(std::string_view message, uint64_t &log_ts,
+                                AntennaSample &antenna, PacketSample &packets)
+{
+    std::string_view rest = message;
+    const std::string_view ts = NextToken(rest, '\t');
+    const std::string_view type = NextToken(rest, '\t');
+    if (rest.data() == nullptr)
+        return WfbLogRecord::None;
+    if (!ParseNumber(ts, log_ts))
+        log_ts = 0;
+
+    if (type == "RX_ANT")
+    {
+        NextToken(rest, '\t'); // freq:mcs:bandwidth
+        std::string_view id = NextToken(rest, '\t');
+        const std::string_view stats = NextToken(rest, '\t');
+        if (id.size() > 2 && id[0] == '0' && (id[1] == 'x' || id[1] == 'X'))
+            id.remove_prefix(2);
+        if (!ParseNumber(id, antenna.antenna_id, 16))
+            return WfbLogRecord::None;
+        int32_t *const values[] = {&antenna.packets, &antenna.rssi_min, &antenna.rssi_avg, &antenna.rssi_max,
+                                   &antenna.snr_min, &antenna.snr_avg, &antenna.snr_max};
+        return ParseCounters(stats, values) ? WfbLogRecord::RxAnt : WfbLogRecord::None;
+    }
+    if (type == "PKT")
+    {
+        const std::string_view stats = NextToken(rest, '\t');
+        uint64_t *const values[] = {&packets.all, &packets.all_bytes, &packets.dec_err, &packets.session,
+                                    &packets.data, &packets.uniq, &packets.fec_rec, &packets.lost,
+                                    &packets.bad, &packets.out, &packets.out_bytes};
+        return ParseCounters(stats, values) ? WfbLogRecord::Pkt : WfbLogRecord::None;
+    }
+    return WfbLogRecord::None;
+}
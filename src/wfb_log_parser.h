@@ -0,0 +1,21 @@
+#pragma once
+
+#include "signal_monitor.h"
+
+#include <cstdint>
+#include <string_view>
+
+enum class WfbLogRecord
+{
+    None,
+    RxAnt,
+    Pkt,
+};
+
+// Parses one wfb_rx stats message without allocating:
+//   <ts_ms>\tRX_ANT\t<freq:mcs:bw>\t<antenna_id hex>\t<7 ':' separated counters>
+//   <ts_ms>\tPKT\t<11 ':' separated counters>
+// Only the sample matching the returned record kind is written. A missing or
+// malformed timestamp leaves log_ts at 0.
+WfbLogRecord ParseWfbLogMessage(std::string_view message, uint64_t &log_ts,
+                                AntennaSample &antenna, PacketSample &packets);
@@ -0,0 +1,438 @@
+#include "wfb_stats_client.h"
+
+#include "logger.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr size_t kMaxFrame = 1 << 20;
+constexpr int kMaxDepth = 8;
+
+// Just enough of msgpack to walk wfb-ng stats messages.
+struct MsgValue
+{
+    enum class Type
+    {
+        Nil,
+        Bool,
+        Int,
+        Float,
+        Str,
+        Array,
+        Map,
+    };
+
+    Type type = Type::Nil;
+    int64_t i = 0;
+    double f = 0.0;
+    std::string s;
+    // Arrays hold their elements; maps hold key/value pairs flattened.
+    std::vector<MsgValue> items;
+
+    bool IsNumber() const { return type == Type::Int || type == Type::Float; }
+    double Number() const { return type == Type::Float ? f : static_cast<double>(i); }
+    size_t MapSize() const { return type == Type::Map ? items.size() / 2 : 0; }
+
+    const MsgValue *Find(const char *key) const
+    {
+        if (type != Type::Map)
+            return nullptr;
+        for (size_t n = 0; n + 1 < items.size(); n += 2)
+        {
+            if (items[n].type == Type::Str && items[n].s == key)
+                return &items[n + 1];
+        }
+        return nullptr;
+    }
+};
+
+class MsgReader
+{
+public:
+    MsgReader(const uint8_t *data, size_t len) : p_(data), end_(data + len) {}
+
+    bool Read(MsgValue &out, int depth = 0)
+    {
+        if (depth > kMaxDepth || p_ >= end_)
+            return false;
+        const uint8_t tag = *p_++;
+        out = MsgValue{};
+        if (tag <= 0x7f)
+            return SetInt(out, tag);
+        if (tag >= 0xe0)
+            return SetInt(out, static_cast<int8_t>(tag));
+        if ((tag & 0xf0) == 0x80)
+            return ReadContainer(out, tag & 0x0f, true, depth);
+        if ((tag & 0xf0) == 0x90)
+            return ReadContainer(out, tag & 0x0f, false, depth);
+        if ((tag & 0xe0) == 0xa0)
+            return ReadStr(out, tag & 0x1f);
+
+        uint64_t n = 0;
+        switch (tag)
+        {
+        case 0xc0:
+            return true;
+        case 0xc2:
+        case 0xc3:
+            out.type = MsgValue::Type::Bool;
+            out.i = tag == 0xc3;
+            return true;
+        case 0xc4:
+        case 0xd9:
+            return Be(1, n) && ReadStr(out, n);
+        case 0xc5:
+        case 0xda:
+            return Be(2, n) && ReadStr(out, n);
+        case 0xc6:
+        case 0xdb:
+            return Be(4, n) && ReadStr(out, n);
+        case 0xc7:
+            return Be(1, n) && Skip(n + 1);
+        case 0xc8:
+            return Be(2, n) && Skip(n + 1);
+        case 0xc9:
+            return Be(4, n) && Skip(n + 1);
+        case 0xca:
+        {
+            if (!Be(4, n))
+                return false;
+            uint32_t bits = static_cast<uint32_t>(n);
+            float v = 0.0f;
+            std::memcpy(&v, &bits, sizeof(v));
+            out.type = MsgValue::Type::Float;
+            out.f = v;
+            return true;
+        }
+        case 0xcb:
+        {
+            if (!Be(8, n))
+                return false;
+            double v = 0.0;
+            std::memcpy(&v, &n, sizeof(v));
+            out.type = MsgValue::Type::Float;
+            out.f = v;
+            return true;
+        }
+        case 0xcc:
+            return Be(1, n) && SetInt(out, static_cast<int64_t>(n));
+        case 0xcd:
+            return Be(2, n) && SetInt(out, static_cast<int64_t>(n));
+        case 0xce:
+            return Be(4, n) && SetInt(out, static_cast<int64_t>(n));
+        case 0xcf:
+            return Be(8, n) && SetInt(out, static_cast<int64_t>(n));
+        case 0xd0:
+            return Be(1, n) && SetInt(out, static_cast<int8_t>(n));
+        case 0xd1:
+            return Be(2, n) && SetInt(out, static_cast<int16_t>(n));
+        case 0xd2:
+            return Be(4, n) && SetInt(out, static_cast<int32_t>(n));
+        case 0xd3:
+            return Be(8, n) && SetInt(out, static_cast<int64_t>(n));
+        case 0xd4:
+            return Skip(2);
+        case 0xd5:
+            return Skip(3);
+        case 0xd6:
+            return Skip(5);
+        case 0xd7:
+            return Skip(9);
+        case 0xd8:
+            return Skip(17);
+        case 0xdc:
+            return Be(2, n) && ReadContainer(out, n, false, depth);
+        case 0xdd:
+            return Be(4, n) && ReadContainer(out, n, false, depth);
+        case 0xde:
+            return Be(2, n) && ReadContainer(out, n, true, depth);
+        case 0xdf:
+            return Be(4, n) && ReadContainer(out, n, true, depth);
+        default:
+            return false;
+        }
+    }
+
+private:
+    bool Be(size_t bytes, uint64_t &out)
+    {
+        if (static_cast<size_t>(end_ - p_) < bytes)
+            return false;
+        out = 0;
+        for (size_t n = 0; n < bytes; ++n)
+            out = (out << 8) | *p_++;
+        return true;
+    }
+
+    bool Skip(uint64_t bytes)
+    {
+        if (static_cast<uint64_t>(end_ - p_) < bytes)
+            return false;
+        p_ += bytes;
+        return true;
+    }
+
+    static bool SetInt(MsgValue &out, int64_t v)
+    {
+        out.type = MsgValue::Type::Int;
+        out.i = v;
+        return true;
+    }
+
+    bool ReadStr(MsgValue &out, uint64_t len)
+    {
+        if (static_cast<uint64_t>(end_ - p_) < len)
+            return false;
+        out.type = MsgValue::Type::Str;
+        out.s.assign(reinterpret_cast<const char *>(p_), static_cast<size_t>(len));
+        p_ += len;
+        return true;
+    }
+
+    bool ReadContainer(MsgValue &out, uint64_t count, bool is_map, int depth)
+    {
+        const uint64_t total = is_map ? count * 2 : count;
+        // Every element needs at least one byte; reject impossible sizes early.
+        if (total > static_cast<uint64_t>(end_ - p_))
+            return false;
+        out.type = is_map ? MsgValue::Type::Map : MsgValue::Type::Array;
+        out.items.resize(static_cast<size_t>(total));
+        for (auto &item : out.items)
+        {
+            if (!Read(item, depth + 1))
+                return false;
+        }
+        return true;
+    }
+
+    const uint8_t *p_;
+    const uint8_t *end_;
+};
+
+uint64_t PacketDelta(const MsgValue &value)
+{
+    // packets entries are (delta, total) tuples; older builds send bare counts.
+    const MsgValue *v = &value;
+    if (value.type == MsgValue::Type::Array && !value.items.empty())
+        v = &value.items[0];
+    if (!v->IsNumber() || v->Number() < 0.0)
+        return 0;
+    return static_cast<uint64_t>(v->Number());
+}
+
+bool AntennaIdFromKey(const MsgValue &key, uint64_t &out)
+{
+    // Keys are ((freq, mcs, bandwidth), antenna_id).
+    const MsgValue *v = &key;
+    if (key.type == MsgValue::Type::Array && !key.items.empty())
+        v = &key.items.back();
+    if (!v->IsNumber())
+        return false;
+    out = static_cast<uint64_t>(v->Number());
+    return true;
+}
+} // namespace
+
+WfbStatsClient::WfbStatsClient(std::string host, uint16_t port)
+    : host_(std::move(host)), port_(port)
+{
+}
+
+WfbStatsClient::~WfbStatsClient()
+{
+    Disconnect();
+}
+
+bool WfbStatsClient::Connect(int timeout_ms)
+{
+    Disconnect();
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    if (inet_pton(AF_INET, host_.c_str(), &addr.sin_addr) != 1)
+    {
+        LOG_ERROR("WfbStats", "invalid stats API host: %s", host_.c_str());
+        return false;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+    {
+        LOG_ERROR("WfbStats", "socket: %s", std::strerror(errno));
+        return false;
+    }
+    int rc = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    if (rc < 0 && errno == EINPROGRESS)
+    {
+        pollfd pfd{};
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (poll(&pfd, 1, timeout_ms) == 1 &&
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == 0 && err == 0)
+        {
+            rc = 0;
+        }
+        else
+        {
+            errno = err ? err : ETIMEDOUT;
+        }
+    }
+    if (rc < 0)
+    {
+        // Retried with backoff while wfb-ng is down; once per interval is enough.
+        LOG_EVERY_MS(LogLevel::Warn, "WfbStats", 30000, "connect %s:%u failed: %s", host_.c_str(),
+                     static_cast<unsigned>(port_), std::strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    fd_ = fd;
+    pending_.clear();
+    LOG_INFO("WfbStats", "connected to %s:%u", host_.c_str(), static_cast<unsigned>(port_));
+    return true;
+}
+
+void WfbStatsClient::Disconnect()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+    pending_.clear();
+}
+
+bool WfbStatsClient::ReadAvailable(const Handler &handler)
+{
+    if (fd_ < 0)
+        return false;
+    uint8_t buffer[4096];
+    while (true)
+    {
+        ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            pending_.insert(pending_.end(), buffer, buffer + n);
+            ConsumeFrames(handler);
+            if (fd_ < 0)
+                return false;
+            continue;
+        }
+        if (n == 0)
+            return false;
+        if (errno == EINTR)
+            continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+void WfbStatsClient::ConsumeFrames(const Handler &handler)
+{
+    size_t pos = 0;
+    while (pending_.size() - pos >= 4)
+    {
+        const uint8_t *hdr = pending_.data() + pos;
+        const size_t len = (static_cast<size_t>(hdr[0]) << 24) | (static_cast<size_t>(hdr[1]) << 16) |
+                           (static_cast<size_t>(hdr[2]) << 8) | static_cast<size_t>(hdr[3]);
+        if (len > kMaxFrame)
+        {
+            LOG_WARN("WfbStats", "oversized frame (%zu bytes), reconnecting", len);
+            Disconnect();
+            return;
+        }
+        if (pending_.size() - pos - 4 < len)
+            break;
+        HandleMessage(pending_.data() + pos + 4, len, handler);
+        pos += 4 + len;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(pos));
+}
+
+void WfbStatsClient::HandleMessage(const uint8_t *data, size_t len, const Handler &handler)
+{
+    MsgValue root;
+    MsgReader reader(data, len);
+    if (!reader.Read(root) || root.type != MsgValue::Type::Map)
+        return;
+    const MsgValue *type = root.Find("type");
+    if (!type || type->type != MsgValue::Type::Str || type->s != "rx")
+        return;
+
+    if (const MsgValue *ants = root.Find("rx_ant_stats"); ants && handler.on_antenna)
+    {
+        for (size_t n = 0; n < ants->MapSize(); ++n)
+        {
+            const MsgValue &key = ants->items[n * 2];
+            const MsgValue &value = ants->items[n * 2 + 1];
+            AntennaSample sample{};
+            if (!AntennaIdFromKey(key, sample.antenna_id))
+                continue;
+            if (value.type != MsgValue::Type::Array || value.items.size() < 7)
+                continue;
+            int32_t *fields[] = {&sample.packets, &sample.rssi_min, &sample.rssi_avg, &sample.rssi_max,
+                                 &sample.snr_min, &sample.snr_avg, &sample.snr_max};
+            bool ok = true;
+            for (size_t f = 0; f < 7; ++f)
+            {
+                if (!value.items[f].IsNumber())
+                {
+                    ok = false;
+                    break;
+                }
+                *fields[f] = static_cast<int32_t>(std::lround(value.items[f].Number()));
+            }
+            if (ok)
+                handler.on_antenna(sample);
+        }
+    }
+
+    const MsgValue *packets = root.Find("packets");
+    if (!packets || packets->type != MsgValue::Type::Map || !handler.on_packets)
+        return;
+    PacketSample sample{};
+    struct Field
+    {
+        const char *name;
+        uint64_t PacketSample::*member;
+    };
+    static const Field kFields[] = {
+        {"all", &PacketSample::all},
+        {"all_bytes", &PacketSample::all_bytes},
+        {"dec_err", &PacketSample::dec_err},
+        {"session", &PacketSample::session},
+        {"data", &PacketSample::data},
+        {"uniq", &PacketSample::uniq},
+        {"fec_rec", &PacketSample::fec_rec},
+        {"lost", &PacketSample::lost},
+        {"bad", &PacketSample::bad},
+        {"out", &PacketSample::out},
+        {"out_bytes", &PacketSample::out_bytes},
+    };
+    for (const auto &field : kFields)
+    {
+        if (const MsgValue *v = packets->Find(field.name))
+            sample.*field.member = PacketDelta(*v);
+    }
+
+    uint64_t ts_ms = 0;
+    if (const MsgValue *ts = root.Find("timestamp"); ts && ts->IsNumber() && ts->Number() > 0.0)
+        ts_ms = static_cast<uint64_t>(ts->Number() * 1000.0);
+    uint64_t stream_key = 0;
+    if (const MsgValue *id = root.Find("id"); id && id->type == MsgValue::Type::Str)
+        stream_key = std::hash<std::string>{}(id->s);
+    handler.on_packets(stream_key, ts_ms, sample);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "signal_monitor.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Client for the wfb-ng stats API (the msgpack stream served on the stats
+// port and consumed by wfb-cli). Frames are a 4-byte big-endian length
+// followed by one msgpack map per message.
+class WfbStatsClient
+{
+public:
+    struct Handler
+    {
+        std::function<void(const AntennaSample &)> on_antenna;
+        std::function<void(uint64_t stream_key, uint64_t ts_ms, const PacketSample &)> on_packets;
+    };
+
+    WfbStatsClient(std::string host = "127.0.0.1", uint16_t port = 8003);
+    ~WfbStatsClient();
+
+    bool Connect(int timeout_ms = 1000);
+    void Disconnect();
+    int Fd() const { return fd_; }
+    // Drains the socket and dispatches complete frames; false on EOF or error.
+    bool ReadAvailable(const Handler &handler);
+
+private:
+    void ConsumeFrames(const Handler &handler);
+    void HandleMessage(const uint8_t *data, size_t len, const Handler &handler);
+
+    std::string host_;
+    uint16_t port_ = 0;
+    int fd_ = -1;
+    std::vector<uint8_t> pending_;
+};
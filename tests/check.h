@@ -0,0 +1,29 @@
+#pragma once
+
+// Minimal assertions for the host-side tests: a failed check is printed and
+// counted, the test keeps going, and main() returns TestExitCode().
+
+#include <cstdio>
+
+inline int &TestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline int TestExitCode()
+{
+    if (TestFailures() > 0)
+        std::fprintf(stderr, "%d check(s) failed\n", TestFailures());
+    return TestFailures() > 0 ? 1 : 0;
+}
+
+#define CHECK(cond)                                                                       \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(cond))                                                                      \
+        {                                                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++TestFailures();                                                             \
+        }                                                                                 \
+    } while (0)
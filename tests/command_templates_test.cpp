@@ -0,0 +1,111 @@
+// Loads command.cfg variants and checks which [local] templates count as
+// built-in, which decides whether nl80211 or the template sets the monitor.
+
+#include "check.h"
+#include "command_templates.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+// The [local] templates as shipped before they moved to ${TXPOWER}.
+const std::string kBaselineChannel =
+    "sh -c 'for dev in $(iw dev 2>/dev/null | awk '\\''/Interface/ {iface=$2} /type[[:space:]]+monitor/ {print iface}'\\''); "
+    "do iw dev $dev set channel ${CHANNEL} ${BW_SUFFIX}; done'";
+const std::string kBaselinePower =
+    "sh -c 'for dev in $(iw dev 2>/dev/null | awk '\\''/Interface/ {iface=$2} /type[[:space:]]+monitor/ {print iface}'\\''); "
+    "do iw dev $dev set txpower fixed $(( ${POWER} * 50 )); done'";
+
+std::string LocalSection(const std::string &channel, const std::string &power)
+{
+    return "[local]\n"
+           "# Executed locally in a background thread; iterates monitor interfaces if any\n"
+           "monitor_channel = " + channel + "\n"
+           "monitor_power = " + power + "\n";
+}
+
+class TempConfig
+{
+public:
+    explicit TempConfig(const std::string &content)
+    {
+        char path[] = "/tmp/command_templates_test.XXXXXX";
+        const int fd = mkstemp(path);
+        if (fd >= 0)
+        {
+            close(fd);
+            path_ = path;
+            std::ofstream(path_, std::ios::trunc) << content;
+        }
+    }
+    ~TempConfig()
+    {
+        if (!path_.empty())
+            unlink(path_.c_str());
+    }
+
+    const std::string &Path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+bool LocalBuiltIn(CommandTemplates &templates)
+{
+    return templates.IsBuiltIn("local", "monitor_channel") && templates.IsBuiltIn("local", "monitor_power");
+}
+
+void TestUnsetKeys()
+{
+    TempConfig config("[remote]\nchannel = true\n");
+    CommandTemplates templates;
+    CHECK(templates.LoadFromFile(config.Path()));
+    CHECK(LocalBuiltIn(templates));
+    CHECK(!templates.IsBuiltIn("remote", "channel"));
+}
+
+void TestShippedConfig()
+{
+    CommandTemplates templates;
+    CHECK(templates.LoadFromFile(AML_COMMAND_CFG));
+    CHECK(LocalBuiltIn(templates));
+}
+
+void TestBaselineConfig()
+{
+    TempConfig config(LocalSection(kBaselineChannel, kBaselinePower));
+    CommandTemplates templates;
+    CHECK(templates.LoadFromFile(config.Path()));
+    CHECK(LocalBuiltIn(templates));
+}
+
+void TestEditedTemplate()
+{
+    std::string power = kBaselinePower;
+    power.replace(power.find("* 50"), 4, "* 40");
+    TempConfig config(LocalSection(kBaselineChannel, power));
+    CommandTemplates templates;
+    CHECK(templates.LoadFromFile(config.Path()));
+    CHECK(templates.IsBuiltIn("local", "monitor_channel"));
+    CHECK(!templates.IsBuiltIn("local", "monitor_power"));
+
+    // A shipped text only counts for the key it was shipped under.
+    TempConfig swapped(LocalSection(kBaselinePower, kBaselineChannel));
+    CommandTemplates swapped_templates;
+    CHECK(swapped_templates.LoadFromFile(swapped.Path()));
+    CHECK(!swapped_templates.IsBuiltIn("local", "monitor_channel"));
+    CHECK(!swapped_templates.IsBuiltIn("local", "monitor_power"));
+}
+} // namespace
+
+int main()
+{
+    TestUnsetKeys();
+    TestShippedConfig();
+    TestBaselineConfig();
+    TestEditedTemplate();
+    return TestExitCode();
+}
@@ -0,0 +1,457 @@
+// Drives Nl80211Client against a fake kernel on the other end of a
+// socketpair: family lookup, the GET_INTERFACE dump and the SET_WIPHY
+// requests for channel and txpower, including failures and notifications.
+
+#include "check.h"
+#include "nl80211_client.h"
+
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr uint16_t kFamily = 0x1c;
+constexpr uint32_t kConfigGroup = 5;
+
+struct Attrs
+{
+    std::map<uint16_t, std::vector<char>> values;
+
+    bool Has(uint16_t type) const { return values.count(type) != 0; }
+    uint32_t U32(uint16_t type) const
+    {
+        uint32_t value = 0;
+        auto it = values.find(type);
+        if (it != values.end() && it->second.size() >= sizeof(value))
+            std::memcpy(&value, it->second.data(), sizeof(value));
+        return value;
+    }
+    std::string String(uint16_t type) const
+    {
+        auto it = values.find(type);
+        if (it == values.end())
+            return {};
+        return std::string(it->second.data(), strnlen(it->second.data(), it->second.size()));
+    }
+};
+
+Attrs ParseAttrs(const char *data, size_t len)
+{
+    Attrs attrs;
+    while (len >= NLA_HDRLEN)
+    {
+        nlattr hdr;
+        std::memcpy(&hdr, data, sizeof(hdr));
+        if (hdr.nla_len < NLA_HDRLEN || hdr.nla_len > len)
+            break;
+        attrs.values[hdr.nla_type & NLA_TYPE_MASK].assign(data + NLA_HDRLEN, data + hdr.nla_len);
+        const size_t step = NLA_ALIGN(hdr.nla_len);
+        if (step >= len)
+            break;
+        data += step;
+        len -= step;
+    }
+    return attrs;
+}
+
+void PutAttr(std::vector<char> &buf, uint16_t type, const void *data, size_t len)
+{
+    nlattr hdr{};
+    hdr.nla_len = static_cast<uint16_t>(NLA_HDRLEN + len);
+    hdr.nla_type = type;
+    const size_t offset = buf.size();
+    buf.resize(offset + NLA_ALIGN(hdr.nla_len), 0);
+    std::memcpy(&buf[offset], &hdr, sizeof(hdr));
+    std::memcpy(&buf[offset + NLA_HDRLEN], data, len);
+}
+
+void PutU32(std::vector<char> &buf, uint16_t type, uint32_t value)
+{
+    PutAttr(buf, type, &value, sizeof(value));
+}
+
+void PutString(std::vector<char> &buf, uint16_t type, const std::string &value)
+{
+    PutAttr(buf, type, value.c_str(), value.size() + 1);
+}
+
+void AppendMessage(std::vector<char> &out, uint16_t type, uint16_t flags, uint32_t seq, uint8_t cmd,
+                   const std::vector<char> &attrs)
+{
+    nlmsghdr hdr{};
+    hdr.nlmsg_len = static_cast<uint32_t>(NLMSG_HDRLEN + GENL_HDRLEN + attrs.size());
+    hdr.nlmsg_type = type;
+    hdr.nlmsg_flags = flags;
+    hdr.nlmsg_seq = seq;
+    genlmsghdr genl{};
+    genl.cmd = cmd;
+    genl.version = 1;
+    const size_t offset = out.size();
+    out.resize(offset + NLMSG_ALIGN(hdr.nlmsg_len), 0);
+    std::memcpy(&out[offset], &hdr, sizeof(hdr));
+    std::memcpy(&out[offset + NLMSG_HDRLEN], &genl, sizeof(genl));
+    std::memcpy(&out[offset + NLMSG_HDRLEN + GENL_HDRLEN], attrs.data(), attrs.size());
+}
+
+void AppendStatus(std::vector<char> &out, uint16_t type, uint32_t seq, int error)
+{
+    nlmsghdr hdr{};
+    hdr.nlmsg_len = type == NLMSG_ERROR ? NLMSG_LENGTH(sizeof(nlmsgerr)) : NLMSG_LENGTH(sizeof(int));
+    hdr.nlmsg_type = type;
+    hdr.nlmsg_seq = seq;
+    const size_t offset = out.size();
+    out.resize(offset + NLMSG_ALIGN(hdr.nlmsg_len), 0);
+    std::memcpy(&out[offset], &hdr, sizeof(hdr));
+    if (type == NLMSG_ERROR)
+    {
+        nlmsgerr err{};
+        err.error = error;
+        std::memcpy(&out[offset + NLMSG_HDRLEN], &err, sizeof(err));
+    }
+}
+
+struct FakeInterface
+{
+    uint32_t ifindex;
+    std::string name;
+    uint32_t iftype;
+};
+
+// Answers requests on its end of the socketpair the way the kernel would.
+class FakeKernel
+{
+public:
+    struct SetWiphy
+    {
+        uint32_t ifindex;
+        Attrs attrs;
+    };
+
+    explicit FakeKernel(int fd) : fd_(fd), thread_(&FakeKernel::Run, this) {}
+    ~FakeKernel()
+    {
+        shutdown(fd_, SHUT_RDWR);
+        thread_.join();
+        close(fd_);
+    }
+
+    void SetInterfaces(std::vector<FakeInterface> interfaces)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        interfaces_ = std::move(interfaces);
+    }
+    void FailIfindex(uint32_t ifindex)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fail_ifindex_ = ifindex;
+    }
+    int Dumps()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dumps_;
+    }
+    std::vector<SetWiphy> TakeRequests()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::move(requests_);
+    }
+
+private:
+    void Run()
+    {
+        char buf[8192];
+        while (true)
+        {
+            const ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+            if (n <= 0)
+                return;
+            if (static_cast<size_t>(n) < NLMSG_HDRLEN + GENL_HDRLEN)
+                continue;
+            nlmsghdr hdr;
+            std::memcpy(&hdr, buf, sizeof(hdr));
+            genlmsghdr genl;
+            std::memcpy(&genl, buf + NLMSG_HDRLEN, sizeof(genl));
+            const Attrs attrs = ParseAttrs(buf + NLMSG_HDRLEN + GENL_HDRLEN, n - NLMSG_HDRLEN - GENL_HDRLEN);
+            const std::vector<char> reply = Handle(hdr, genl.cmd, attrs);
+            send(fd_, reply.data(), reply.size(), 0);
+        }
+    }
+
+    std::vector<char> Handle(const nlmsghdr &hdr, uint8_t cmd, const Attrs &attrs)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<char> reply;
+        if (hdr.nlmsg_type == GENL_ID_CTRL && cmd == CTRL_CMD_GETFAMILY)
+        {
+            if (attrs.String(CTRL_ATTR_FAMILY_NAME) != NL80211_GENL_NAME)
+            {
+                AppendStatus(reply, NLMSG_ERROR, hdr.nlmsg_seq, -ENOENT);
+                return reply;
+            }
+            std::vector<char> group;
+            PutString(group, CTRL_ATTR_MCAST_GRP_NAME, "scan");
+            PutU32(group, CTRL_ATTR_MCAST_GRP_ID, kConfigGroup + 1);
+            std::vector<char> config;
+            PutString(config, CTRL_ATTR_MCAST_GRP_NAME, NL80211_MULTICAST_GROUP_CONFIG);
+            PutU32(config, CTRL_ATTR_MCAST_GRP_ID, kConfigGroup);
+            std::vector<char> groups;
+            PutAttr(groups, 1, group.data(), group.size());
+            PutAttr(groups, 2, config.data(), config.size());
+            std::vector<char> body;
+            const uint16_t family = kFamily;
+            PutAttr(body, CTRL_ATTR_FAMILY_ID, &family, sizeof(family));
+            PutString(body, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME);
+            PutAttr(body, CTRL_ATTR_MCAST_GROUPS, groups.data(), groups.size());
+            AppendMessage(reply, GENL_ID_CTRL, 0, hdr.nlmsg_seq, CTRL_CMD_NEWFAMILY, body);
+            AppendStatus(reply, NLMSG_ERROR, hdr.nlmsg_seq, 0);
+        }
+        else if (hdr.nlmsg_type == kFamily && cmd == NL80211_CMD_GET_INTERFACE && (hdr.nlmsg_flags & NLM_F_DUMP))
+        {
+            ++dumps_;
+            for (const FakeInterface &iface : interfaces_)
+            {
+                std::vector<char> body;
+                PutU32(body, NL80211_ATTR_IFINDEX, iface.ifindex);
+                PutString(body, NL80211_ATTR_IFNAME, iface.name);
+                PutU32(body, NL80211_ATTR_IFTYPE, iface.iftype);
+                AppendMessage(reply, kFamily, NLM_F_MULTI, hdr.nlmsg_seq, NL80211_CMD_NEW_INTERFACE, body);
+            }
+            AppendStatus(reply, NLMSG_DONE, hdr.nlmsg_seq, 0);
+        }
+        else if (hdr.nlmsg_type == kFamily && cmd == NL80211_CMD_SET_WIPHY)
+        {
+            const uint32_t ifindex = attrs.U32(NL80211_ATTR_IFINDEX);
+            requests_.push_back({ifindex, attrs});
+            AppendStatus(reply, NLMSG_ERROR, hdr.nlmsg_seq, ifindex == fail_ifindex_ ? -ENODEV : 0);
+        }
+        else
+        {
+            AppendStatus(reply, NLMSG_ERROR, hdr.nlmsg_seq, -EOPNOTSUPP);
+        }
+        return reply;
+    }
+
+    int fd_;
+    std::mutex mutex_;
+    std::vector<FakeInterface> interfaces_;
+    uint32_t fail_ifindex_ = 0;
+    int dumps_ = 0;
+    std::vector<SetWiphy> requests_;
+    std::thread thread_;
+};
+
+const std::vector<FakeInterface> kInterfaces = {
+    {3, "wlan0", NL80211_IFTYPE_MONITOR},
+    {4, "wlan1", NL80211_IFTYPE_STATION},
+    {7, "wlan2mon", NL80211_IFTYPE_MONITOR},
+};
+
+void SendInterfaceNotification(int fd, uint8_t cmd)
+{
+    std::vector<char> msg;
+    std::vector<char> body;
+    PutU32(body, NL80211_ATTR_IFINDEX, 9);
+    AppendMessage(msg, kFamily, 0, 0, cmd, body);
+    send(fd, msg.data(), msg.size(), 0);
+}
+
+void TestOpen()
+{
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == 0);
+    FakeKernel kernel(fds[1]);
+    Nl80211Client client;
+    CHECK(client.Open(fds[0]));
+    CHECK(client.IsOpen());
+}
+
+void TestRefreshInterfaces()
+{
+    int fds[2];
+    int events[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == 0);
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, events) == 0);
+    FakeKernel kernel(fds[1]);
+    kernel.SetInterfaces(kInterfaces);
+    Nl80211Client client;
+    CHECK(client.Open(fds[0], events[0]));
+
+    // Only monitor interfaces are listed, and the list is cached.
+    std::vector<Nl80211Client::Interface> monitors;
+    CHECK(client.MonitorInterfaces(monitors));
+    CHECK(monitors.size() == 2);
+    CHECK(monitors.size() == 2 && monitors[0].ifindex == 3 && monitors[0].name == "wlan0");
+    CHECK(monitors.size() == 2 && monitors[1].ifindex == 7 && monitors[1].name == "wlan2mon");
+    CHECK(client.MonitorInterfaces(monitors));
+    CHECK(kernel.Dumps() == 1);
+
+    // An unrelated notification keeps the cache; an interface change drops it.
+    SendInterfaceNotification(events[1], NL80211_CMD_TRIGGER_SCAN);
+    CHECK(client.MonitorInterfaces(monitors));
+    CHECK(kernel.Dumps() == 1);
+    kernel.SetInterfaces({{3, "wlan0", NL80211_IFTYPE_MONITOR}});
+    SendInterfaceNotification(events[1], NL80211_CMD_DEL_INTERFACE);
+    CHECK(client.MonitorInterfaces(monitors));
+    CHECK(kernel.Dumps() == 2);
+    CHECK(monitors.size() == 1 && monitors[0].ifindex == 3);
+    close(events[1]);
+}
+
+void TestNoNotifications()
+{
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == 0);
+    FakeKernel kernel(fds[1]);
+    kernel.SetInterfaces(kInterfaces);
+    Nl80211Client client;
+    CHECK(client.Open(fds[0]));
+    // Without the event socket nothing can be cached.
+    std::vector<Nl80211Client::Interface> monitors;
+    CHECK(client.MonitorInterfaces(monitors));
+    CHECK(client.MonitorInterfaces(monitors));
+    CHECK(kernel.Dumps() == 2);
+}
+
+void TestSetMonitorChannel()
+{
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == 0);
+    FakeKernel kernel(fds[1]);
+    kernel.SetInterfaces(kInterfaces);
+    Nl80211Client client;
+    CHECK(client.Open(fds[0]));
+
+    CHECK(client.SetMonitorChannel(36, 40));
+    auto requests = kernel.TakeRequests();
+    CHECK(requests.size() == 2);
+    for (const auto &request : requests)
+    {
+        CHECK(request.ifindex == 3 || request.ifindex == 7);
+        CHECK(request.attrs.U32(NL80211_ATTR_WIPHY_FREQ) == 5180);
+        CHECK(request.attrs.U32(NL80211_ATTR_WIPHY_CHANNEL_TYPE) == NL80211_CHAN_HT40PLUS);
+    }
+
+    CHECK(client.SetMonitorChannel(6, 20));
+    requests = kernel.TakeRequests();
+    CHECK(requests.size() == 2 && requests[0].attrs.U32(NL80211_ATTR_WIPHY_FREQ) == 2437);
+    CHECK(requests.size() == 2 && requests[0].attrs.U32(NL80211_ATTR_WIPHY_CHANNEL_TYPE) == NL80211_CHAN_HT20);
+
+    CHECK(client.SetMonitorChannel(14, 10));
+    requests = kernel.TakeRequests();
+    CHECK(requests.size() == 2 && requests[0].attrs.U32(NL80211_ATTR_WIPHY_FREQ) == 2484);
+    CHECK(requests.size() == 2 && requests[0].attrs.U32(NL80211_ATTR_WIPHY_CHANNEL_TYPE) == NL80211_CHAN_NO_HT);
+
+    // Unknown channels are refused before anything is sent.
+    CHECK(!client.SetMonitorChannel(200, 20));
+    CHECK(kernel.TakeRequests().empty());
+}
+
+void TestSetMonitorTxPower()
+{
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == 0);
+    FakeKernel kernel(fds[1]);
+    kernel.SetInterfaces(kInterfaces);
+    Nl80211Client client;
+    CHECK(client.Open(fds[0], -1));
+
+    CHECK(client.SetMonitorTxPower(2000));
+    const auto requests = kernel.TakeRequests();
+    CHECK(requests.size() == 2);
+    for (const auto &request : requests)
+    {
+        CHECK(request.attrs.U32(NL80211_ATTR_WIPHY_TX_POWER_SETTING) == NL80211_TX_POWER_FIXED);
+        CHECK(request.attrs.U32(NL80211_ATTR_WIPHY_TX_POWER_LEVEL) == 2000);
+        CHECK(!request.attrs.Has(NL80211_ATTR_WIPHY_FREQ));
+    }
+}
+
+void TestFailedInterface()
+{
+    int fds[2];
+    int events[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == 0);
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, events) == 0);
+    FakeKernel kernel(fds[1]);
+    kernel.SetInterfaces(kInterfaces);
+    kernel.FailIfindex(7);
+    Nl80211Client client;
+    CHECK(client.Open(fds[0], events[0]));
+
+    // The other interface is still retuned, and the failure makes the next
+    // change enumerate again even without a notification.
+    CHECK(!client.SetMonitorTxPower(1500));
+    CHECK(kernel.TakeRequests().size() == 2);
+    CHECK(kernel.Dumps() == 1);
+    kernel.FailIfindex(0);
+    CHECK(client.SetMonitorTxPower(1500));
+    CHECK(kernel.Dumps() == 2);
+    close(events[1]);
+}
+
+void TestNoFamily()
+{
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == 0);
+    // A peer that answers every request with an error, like a kernel
+    // without cfg80211.
+    std::thread peer(
+        [fd = fds[1]]
+        {
+            char buf[4096];
+            ssize_t n;
+            while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+            {
+                nlmsghdr hdr;
+                std::memcpy(&hdr, buf, sizeof(hdr));
+                std::vector<char> reply;
+                AppendStatus(reply, NLMSG_ERROR, hdr.nlmsg_seq, -ENOENT);
+                send(fd, reply.data(), reply.size(), 0);
+            }
+        });
+    {
+        Nl80211Client client;
+        CHECK(!client.Open(fds[0]));
+        CHECK(!client.IsOpen());
+        std::vector<Nl80211Client::Interface> monitors;
+        CHECK(!client.MonitorInterfaces(monitors));
+    }
+    shutdown(fds[1], SHUT_RDWR);
+    peer.join();
+    close(fds[1]);
+}
+
+void TestChannelToFrequency()
+{
+    CHECK(Nl80211Client::ChannelToFrequency(1) == 2412);
+    CHECK(Nl80211Client::ChannelToFrequency(13) == 2472);
+    CHECK(Nl80211Client::ChannelToFrequency(14) == 2484);
+    CHECK(Nl80211Client::ChannelToFrequency(149) == 5745);
+    CHECK(Nl80211Client::ChannelToFrequency(0) == 0);
+    CHECK(Nl80211Client::ChannelToFrequency(15) == 0);
+}
+} // namespace
+
+int main()
+{
+    TestOpen();
+    TestRefreshInterfaces();
+    TestNoNotifications();
+    TestSetMonitorChannel();
+    TestSetMonitorTxPower();
+    TestFailedInterface();
+    TestNoFamily();
+    TestChannelToFrequency();
+    return TestExitCode();
+}
@@ -0,0 +1,110 @@
+// Feeds temperature sequences to ThermalPolicy::Update and checks the levels
+// it settles on, including the hysteresis band and badly ordered thresholds.
+
+#include "check.h"
+#include "thermal_policy.h"
+
+#include <initializer_list>
+
+namespace
+{
+// The defaults: warm 70, hot 78, critical 85, hysteresis 3.
+const ThermalConfig kDefaults{};
+
+void TestClimbsSeveralLevels()
+{
+    ThermalPolicy policy(kDefaults);
+    CHECK(!policy.Update(50.0f));
+    CHECK(policy.Level() == ThermalLevel::Normal);
+
+    // One sample past the critical threshold goes straight there.
+    CHECK(policy.Update(90.0f));
+    CHECK(policy.Level() == ThermalLevel::Critical);
+    CHECK(policy.OsdRefreshHz() == 10.0f);
+
+    ThermalPolicy warm_to_hot(kDefaults);
+    CHECK(warm_to_hot.Update(71.0f));
+    CHECK(warm_to_hot.Level() == ThermalLevel::Warm);
+    CHECK(warm_to_hot.Update(80.0f));
+    CHECK(warm_to_hot.Level() == ThermalLevel::Hot);
+}
+
+void TestStepsDownBandByBand()
+{
+    ThermalPolicy policy(kDefaults);
+    CHECK(policy.Update(90.0f));
+
+    // Below critical's exit (82) but inside hot's band: one level down.
+    CHECK(policy.Update(81.0f));
+    CHECK(policy.Level() == ThermalLevel::Hot);
+    // Above hot's exit (75): stays.
+    CHECK(!policy.Update(76.0f));
+    CHECK(policy.Level() == ThermalLevel::Hot);
+    // Below hot's exit but above warm's (67).
+    CHECK(policy.Update(74.0f));
+    CHECK(policy.Level() == ThermalLevel::Warm);
+    CHECK(policy.Update(66.0f));
+    CHECK(policy.Level() == ThermalLevel::Normal);
+
+    // A drop below every exit point leaves all levels in one sample.
+    ThermalPolicy cooled(kDefaults);
+    CHECK(cooled.Update(90.0f));
+    CHECK(cooled.Update(40.0f));
+    CHECK(cooled.Level() == ThermalLevel::Normal);
+}
+
+void TestNoFlappingInsideHysteresis()
+{
+    ThermalPolicy policy(kDefaults);
+    CHECK(policy.Update(70.0f));
+    CHECK(policy.Level() == ThermalLevel::Warm);
+    for (float temp : {69.0f, 70.5f, 67.5f, 71.0f, 67.0f, 69.9f})
+    {
+        CHECK(!policy.Update(temp));
+        CHECK(policy.Level() == ThermalLevel::Warm);
+    }
+    CHECK(policy.Update(66.9f));
+    CHECK(policy.Level() == ThermalLevel::Normal);
+
+    // Just under the entry threshold never enters.
+    for (float temp : {69.9f, 69.0f, 69.9f})
+        CHECK(!policy.Update(temp));
+    CHECK(policy.Level() == ThermalLevel::Normal);
+}
+
+void TestMisorderedThresholds()
+{
+    // hot and critical below warm are raised to warm.
+    ThermalConfig config;
+    config.warm_c = 80.0f;
+    config.hot_c = 70.0f;
+    config.critical_c = 60.0f;
+    ThermalPolicy policy(config);
+    CHECK(!policy.Update(75.0f));
+    CHECK(policy.Level() == ThermalLevel::Normal);
+    CHECK(policy.Update(80.0f));
+    CHECK(policy.Level() == ThermalLevel::Critical);
+    CHECK(policy.Update(76.0f));
+    CHECK(policy.Level() == ThermalLevel::Normal);
+
+    // A negative hysteresis counts as none, so the exit point is not above
+    // the entry threshold.
+    ThermalConfig negative;
+    negative.hysteresis_c = -5.0f;
+    ThermalPolicy no_band(negative);
+    CHECK(no_band.Update(71.0f));
+    CHECK(!no_band.Update(72.0f));
+    CHECK(no_band.Level() == ThermalLevel::Warm);
+    CHECK(no_band.Update(69.9f));
+    CHECK(no_band.Level() == ThermalLevel::Normal);
+}
+} // namespace
+
+int main()
+{
+    TestClimbsSeveralLevels();
+    TestStepsDownBandByBand();
+    TestNoFlappingInsideHysteresis();
+    TestMisorderedThresholds();
+    return TestExitCode();
+}
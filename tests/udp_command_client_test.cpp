@@ -0,0 +1,207 @@
+// Runs UdpCommandClient against sim/sky_sim and checks the status and output
+// it reports for answered, lost, timed-out and concurrent tagged commands.
+
+#include "check.h"
+#include "command_transport.h"
+#include "udp_command_client.h"
+
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern char **environ;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Every test gets its own port pair, so a simulator still shutting down
+// cannot answer the next test's commands.
+uint16_t g_next_port = 25650;
+
+class SkySim
+{
+public:
+    explicit SkySim(std::vector<std::string> args) : port_(g_next_port), rx_port_(g_next_port + 1)
+    {
+        g_next_port += 2;
+        args.insert(args.begin(), {AML_SKY_SIM, "--port", std::to_string(port_), "--reply",
+                                   "127.0.0.1:" + std::to_string(rx_port_)});
+        std::vector<char *> argv;
+        for (auto &arg : args)
+            argv.push_back(&arg[0]);
+        argv.push_back(nullptr);
+        if (posix_spawn(&pid_, AML_SKY_SIM, nullptr, nullptr, argv.data(), environ) != 0)
+            pid_ = -1;
+    }
+    ~SkySim()
+    {
+        if (pid_ <= 0)
+            return;
+        kill(pid_, SIGTERM);
+        waitpid(pid_, nullptr, 0);
+    }
+
+    std::shared_ptr<UdpCommandClient> Connect(bool request_ids = false) const
+    {
+        return std::make_shared<UdpCommandClient>("127.0.0.1", port_, rx_port_, request_ids);
+    }
+
+    // Waits for the simulator to take a command, which also lets a client
+    // with request_ids learn that replies are tagged.
+    static bool WaitReady(UdpCommandClient &client)
+    {
+        const auto deadline = Clock::now() + std::chrono::seconds(5);
+        while (Clock::now() < deadline)
+        {
+            if (client.Send("true", false, 100))
+                return true;
+        }
+        return false;
+    }
+
+private:
+    pid_t pid_ = -1;
+    uint16_t port_;
+    uint16_t rx_port_;
+};
+
+CommandResult RunAsync(CommandTransport &client, const std::string &cmd, int timeout_ms)
+{
+    return client.SendAsync(cmd, Clock::now() + std::chrono::milliseconds(timeout_ms)).get();
+}
+
+void TestReplyLines()
+{
+    SkySim sim({"--stub-reply", "hello world"});
+    auto client = sim.Connect();
+    CHECK(SkySim::WaitReady(*client));
+
+    std::vector<std::string> response;
+    CHECK(client->SendWithReply("cli -g .video0.fps", response));
+    CHECK(response == std::vector<std::string>{"hello world"});
+
+    CommandResult result = RunAsync(*client, "cli -g .video0.fps", 1000);
+    CHECK(result.status == CommandStatus::Ok);
+    CHECK(result.response == std::vector<std::string>{"hello world"});
+}
+
+void TestBatchScript()
+{
+    SkySim sim({"--stub-reply", "7"});
+    auto client = sim.Connect();
+    CHECK(SkySim::WaitReady(*client));
+
+    std::vector<std::string> response;
+    CHECK(client->SendWithReply("echo '@@channel'; (x); echo '@@bitrate'; (y); echo '@@end'", response));
+    CHECK((response == std::vector<std::string>{"@@channel", "7", "@@bitrate", "7", "@@end"}));
+}
+
+void TestLostRequest()
+{
+    SkySim sim({"--loss", "100"});
+    auto client = sim.Connect();
+    const auto start = Clock::now();
+    CHECK(!client->Send("true", false, 200));
+    CHECK(RunAsync(*client, "true", 200).status == CommandStatus::Failed);
+    CHECK(Clock::now() - start < std::chrono::seconds(2));
+}
+
+void TestSkySideTimeout()
+{
+    SkySim sim({"--exec-ms", "400", "--cmd-timeout", "200"});
+    auto client = sim.Connect();
+    CHECK(SkySim::WaitReady(*client));
+    // Let the probe's own "timeout" and final "OK" arrive; untagged, they
+    // would be taken for the next command's.
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    CommandResult result = RunAsync(*client, "sleep 1", 2000);
+    CHECK(result.status == CommandStatus::TimedOut);
+    // Send only reports whether the command was taken.
+    CHECK(client->Send("sleep 1", false, 2000));
+}
+
+void TestDeadline()
+{
+    SkySim sim({"--exec-ms", "1000"});
+    auto client = sim.Connect();
+    CHECK(SkySim::WaitReady(*client));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+    const auto start = Clock::now();
+    CommandResult result = RunAsync(*client, "sleep 1", 300);
+    CHECK(result.status == CommandStatus::TimedOut);
+    CHECK(Clock::now() - start < std::chrono::milliseconds(800));
+}
+
+void TestSendQueuedBehindAsync()
+{
+    SkySim sim({"--exec-ms", "1000"});
+    auto client = sim.Connect();
+    CHECK(SkySim::WaitReady(*client));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+    auto in_flight = client->SendAsync("sleep 1", Clock::now() + std::chrono::seconds(2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Untagged, this waits for the slot; its 500 ms start once it is sent.
+    CHECK(client->Send("true", false, 500));
+    CHECK(in_flight.get().status == CommandStatus::Ok);
+}
+
+void TestTaggedConcurrency()
+{
+    SkySim sim({"--tags", "--exec", "--workers", "4"});
+    auto client = sim.Connect(true);
+    CHECK(SkySim::WaitReady(*client));
+
+    const auto start = Clock::now();
+    std::vector<std::future<CommandResult>> replies;
+    for (int i = 0; i < 4; ++i)
+        replies.push_back(client->SendAsync("sleep 0.3; echo " + std::to_string(i),
+                                            Clock::now() + std::chrono::seconds(3)));
+    for (int i = 0; i < 4; ++i)
+    {
+        CommandResult result = replies[static_cast<size_t>(i)].get();
+        CHECK(result.status == CommandStatus::Ok);
+        CHECK(result.response == std::vector<std::string>{std::to_string(i)});
+    }
+    // One at a time would take at least 1.2 s.
+    CHECK(Clock::now() - start < std::chrono::milliseconds(1000));
+}
+
+void TestTaggedLateReplyDropped()
+{
+    SkySim sim({"--tags", "--exec", "--workers", "2"});
+    auto client = sim.Connect(true);
+    CHECK(SkySim::WaitReady(*client));
+
+    CHECK(RunAsync(*client, "sleep 0.5; echo stale", 200).status == CommandStatus::TimedOut);
+    // "stale" arrives while this command is still running; its tag keeps it
+    // out of this response.
+    CommandResult result = RunAsync(*client, "sleep 0.6; echo fresh", 3000);
+    CHECK(result.status == CommandStatus::Ok);
+    CHECK(result.response == std::vector<std::string>{"fresh"});
+}
+} // namespace
+
+int main()
+{
+    TestReplyLines();
+    TestBatchScript();
+    TestLostRequest();
+    TestSkySideTimeout();
+    TestDeadline();
+    TestSendQueuedBehindAsync();
+    TestTaggedConcurrency();
+    TestTaggedLateReplyDropped();
+    return TestExitCode();
+}
@@ -0,0 +1,212 @@
+// Points VideoStatsCollector at a fake sysfs tree in a temporary directory
+// and checks what it makes of typical and broken attribute contents.
+
+#include "check.h"
+#include "sysfs_sampler.h"
+#include "video_stats.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+class FakeSysfs
+{
+public:
+    FakeSysfs()
+    {
+        char path[] = "/tmp/video_stats_test.XXXXXX";
+        if (mkdtemp(path))
+            root_ = path;
+        for (const char *dir : kDirs)
+            mkdir((root_ + "/" + dir).c_str(), 0755);
+    }
+    ~FakeSysfs()
+    {
+        for (const char *file : kFiles)
+            unlink((root_ + "/" + file).c_str());
+        for (auto dir = std::rbegin(kDirs); dir != std::rend(kDirs); ++dir)
+            rmdir((root_ + "/" + *dir).c_str());
+        rmdir(root_.c_str());
+    }
+
+    const std::string &Root() const { return root_; }
+
+    // Rewrites in place, like the kernel does, so open descriptors see the
+    // new content.
+    void Write(const std::string &relative, const std::string &content) const
+    {
+        std::ofstream file(root_ + "/" + relative, std::ios::trunc);
+        file << content;
+    }
+
+private:
+    static constexpr const char *kDirs[] = {"class", "class/video", "class/vdec", "class/amstream"};
+    static constexpr const char *kFiles[] = {"class/video/fps_info", "class/vdec/vdec_status", "class/amstream/bufs",
+                                             "class/video/vframe_states"};
+
+    std::string root_;
+};
+
+const char kVdecStatus[] = "vdec channel 0 statistics:\n"
+                           "  device name : ammvdec_h264\n"
+                           "  frame width : 1920\n"
+                           "  frame rate : 60 fps\n"
+                           "  frame count : 1230\n"
+                           "  drop count : 15\n"
+                           "  fra err count : 3\n"
+                           "  hw err count : 2\n"
+                           "vdec channel 1 statistics:\n"
+                           "  frame count : 100\n"
+                           "  drop count : 1\n"
+                           "  fra err count : 0\n"
+                           "  hw err count : 0\n";
+
+const char kAmstreamBufs[] = "Video buffer:\n"
+                             "\tbuf addr:0000\n"
+                             "\tbuf size:0x1000000\n"
+                             "\tbuf level:0x400000\n"
+                             "Audio buffer:\n"
+                             "\tbuf size:0x100\n"
+                             "\tbuf level:0x80\n";
+
+const char kVframeStates[] = "vframe_pool_size=16\n"
+                             "vframe buf_free_num=10\n"
+                             "vframe buf_avail_num=3\n";
+
+void TestParseSysfsInt()
+{
+    CHECK(ParseSysfsInt("42") == 42);
+    CHECK(ParseSysfsInt("  42") == 42);
+    CHECK(ParseSysfsInt("-7") == -7);
+    CHECK(ParseSysfsInt("0x3c", 0) == 60);
+    CHECK(ParseSysfsInt("3c", 16) == 60);
+    CHECK(ParseSysfsInt("017", 0) == 17);
+    CHECK(!ParseSysfsInt("0x3c"));
+    CHECK(!ParseSysfsInt("12abc"));
+    CHECK(!ParseSysfsInt("42\n"));
+    CHECK(!ParseSysfsInt(""));
+    CHECK(!ParseSysfsInt("0x", 0));
+}
+
+void TestParseFpsInfo()
+{
+    int input = -1;
+    int output = -1;
+    int drop = -1;
+    CHECK(ParseFpsInfo("input_fps:0x3c output_fps:0x3a drop_fps:0x2\n", input, output, drop));
+    CHECK(input == 60 && output == 58 && drop == 2);
+
+    // Absent keys are left alone; decimal values are accepted too.
+    input = output = drop = -1;
+    CHECK(ParseFpsInfo("output_fps:30", input, output, drop));
+    CHECK(input == -1 && output == 30 && drop == -1);
+
+    // Only the first line counts.
+    input = -1;
+    CHECK(!ParseFpsInfo("\ninput_fps:0x3c", input, output, drop));
+    CHECK(input == -1);
+    CHECK(!ParseFpsInfo("input_fps:garbage", input, output, drop));
+    CHECK(!ParseFpsInfo("", input, output, drop));
+}
+
+void TestSampleFullTree()
+{
+    FakeSysfs sysfs;
+    sysfs.Write("class/video/fps_info", "input_fps:0x3c output_fps:0x3a drop_fps:0x2\n");
+    sysfs.Write("class/vdec/vdec_status", kVdecStatus);
+    sysfs.Write("class/amstream/bufs", kAmstreamBufs);
+    sysfs.Write("class/video/vframe_states", kVframeStates);
+
+    VideoStatsCollector collector(sysfs.Root());
+    VideoStats stats;
+    CHECK(collector.Sample(stats));
+    CHECK(stats.valid);
+    CHECK(stats.has_fps && stats.input_fps == 60 && stats.output_fps == 58 && stats.drop_fps == 2);
+    CHECK(stats.output_fps_min == 58 && stats.output_fps_avg == 58.0f);
+    // Counters are summed over decoder channels.
+    CHECK(stats.has_vdec);
+    CHECK(stats.frames_decoded == 1330 && stats.frames_dropped == 16 && stats.decode_errors == 5);
+    CHECK(stats.dropped_per_s == 0.0f && stats.errors_per_s == 0.0f);
+    // Only the video section of amstream/bufs is used.
+    CHECK(stats.has_buffer && stats.buffer_size == 0x1000000 && stats.buffer_level == 0x400000);
+    CHECK(stats.buffer_percent == 25.0f);
+    CHECK(stats.has_display_queue && stats.display_queue == 3);
+
+    // Second sample: fps history and counter rates.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    sysfs.Write("class/video/fps_info", "input_fps:0x3c output_fps:0x1e drop_fps:0x0\n");
+    sysfs.Write("class/vdec/vdec_status", "vdec channel 0 statistics:\n"
+                                          "  frame count : 1300\n"
+                                          "  drop count : 25\n"
+                                          "  fra err count : 3\n"
+                                          "  hw err count : 7\n");
+    CHECK(collector.Sample(stats));
+    CHECK(stats.output_fps == 30 && stats.output_fps_min == 30 && stats.output_fps_avg == 44.0f);
+    CHECK(stats.input_fps_avg == 60.0f);
+    CHECK(stats.has_vdec && stats.frames_dropped == 25 && stats.decode_errors == 10);
+    CHECK(stats.dropped_per_s > 0.0f && stats.errors_per_s > 0.0f);
+}
+
+void TestSampleNoStream()
+{
+    FakeSysfs sysfs;
+    sysfs.Write("class/video/fps_info", "input_fps:0x3c output_fps:0x3c drop_fps:0x0\n");
+    sysfs.Write("class/vdec/vdec_status", kVdecStatus);
+    VideoStatsCollector collector(sysfs.Root());
+    VideoStats stats;
+    CHECK(collector.Sample(stats));
+    CHECK(stats.has_vdec);
+
+    // Decoding stopped: no vdec counters, and the next stream starts from
+    // fresh counters instead of producing a bogus rate.
+    sysfs.Write("class/vdec/vdec_status", "No vdec.\n");
+    CHECK(collector.Sample(stats));
+    CHECK(stats.has_fps && !stats.has_vdec);
+    sysfs.Write("class/vdec/vdec_status", kVdecStatus);
+    CHECK(collector.Sample(stats));
+    CHECK(stats.has_vdec && stats.dropped_per_s == 0.0f);
+
+    // Attributes that do not exist leave their groups unset.
+    CHECK(!stats.has_buffer && !stats.has_display_queue);
+}
+
+void TestSampleMissingTree()
+{
+    VideoStatsCollector collector("/nonexistent/sysfs");
+    VideoStats stats;
+    CHECK(!collector.Sample(stats));
+    CHECK(!stats.valid && !stats.has_fps && !stats.has_vdec && !stats.has_buffer && !stats.has_display_queue);
+}
+
+void TestSampleMalformed()
+{
+    FakeSysfs sysfs;
+    // Zero-sized buffer and an unparsable queue length.
+    sysfs.Write("class/amstream/bufs", "Video buffer:\n\tbuf size:0\n\tbuf level:0x10\n");
+    sysfs.Write("class/video/vframe_states", "vframe buf_avail_num=many\n");
+    sysfs.Write("class/video/fps_info", "fps unavailable\n");
+    sysfs.Write("class/vdec/vdec_status", "vdec channel 0 statistics:\n  frame count : -3\n");
+    VideoStatsCollector collector(sysfs.Root());
+    VideoStats stats;
+    CHECK(!collector.Sample(stats));
+    CHECK(!stats.has_buffer && !stats.has_display_queue && !stats.has_fps && !stats.has_vdec);
+}
+} // namespace
+
+int main()
+{
+    TestParseSysfsInt();
+    TestParseFpsInfo();
+    TestSampleFullTree();
+    TestSampleNoStream();
+    TestSampleMissingTree();
+    TestSampleMalformed();
+    return TestExitCode();
+}
@@ -0,0 +1,285 @@
+// Serves length-prefixed msgpack frames shaped like the wfb-ng stats API from
+// an in-process TCP server and checks what SignalMonitor::Source::WfbApi makes
+// of them.
+
+#include "check.h"
+#include "signal_monitor.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Writes the msgpack subset wfb-ng uses for its stats messages.
+class MsgPack
+{
+public:
+    MsgPack &Map(uint32_t pairs) { return Header(0x80, 0xde, pairs); }
+    MsgPack &Array(uint32_t items) { return Header(0x90, 0xdc, items); }
+
+    MsgPack &Str(const std::string &text)
+    {
+        if (text.size() < 32)
+            out_.push_back(static_cast<uint8_t>(0xa0 | text.size()));
+        else
+            Be(0xd9, text.size(), 1);
+        out_.insert(out_.end(), text.begin(), text.end());
+        return *this;
+    }
+
+    MsgPack &Int(int64_t value)
+    {
+        if (value >= 0 && value <= 0x7f)
+            out_.push_back(static_cast<uint8_t>(value));
+        else if (value < 0 && value >= -32)
+            out_.push_back(static_cast<uint8_t>(value));
+        else if (value < 0)
+            Be(0xd0, static_cast<uint64_t>(value) & 0xff, 1);
+        else if (value <= 0xffff)
+            Be(0xcd, static_cast<uint64_t>(value), 2);
+        else
+            Be(0xce, static_cast<uint64_t>(value), 4);
+        return *this;
+    }
+
+    MsgPack &Double(double value)
+    {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return Be(0xcb, bits, 8);
+    }
+
+    // Prepends the 4-byte big-endian length the stats API frames use.
+    std::vector<uint8_t> Frame() const
+    {
+        std::vector<uint8_t> frame;
+        const uint32_t len = static_cast<uint32_t>(out_.size());
+        for (int shift = 24; shift >= 0; shift -= 8)
+            frame.push_back(static_cast<uint8_t>(len >> shift));
+        frame.insert(frame.end(), out_.begin(), out_.end());
+        return frame;
+    }
+
+private:
+    MsgPack &Header(uint8_t fix, uint8_t wide, uint32_t count)
+    {
+        if (count < 16)
+            out_.push_back(static_cast<uint8_t>(fix | count));
+        else
+            Be(wide, count, 2);
+        return *this;
+    }
+
+    MsgPack &Be(uint8_t tag, uint64_t value, int bytes)
+    {
+        out_.push_back(tag);
+        for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8)
+            out_.push_back(static_cast<uint8_t>(value >> shift));
+        return *this;
+    }
+
+    std::vector<uint8_t> out_;
+};
+
+struct AntennaRow
+{
+    int antenna_id;
+    int packets;
+    int rssi_avg;
+    int snr_avg;
+};
+
+// One "rx" message: rx_ant_stats keyed by ((freq, mcs, bandwidth), antenna)
+// with (packets, rssi min/avg/max, snr min/avg/max) values, and packets as
+// (delta, total) pairs.
+std::vector<uint8_t> RxFrame(double timestamp, const std::vector<AntennaRow> &antennas, int out, int out_bytes,
+                             int lost, int fec_rec)
+{
+    MsgPack msg;
+    msg.Map(5);
+    msg.Str("type").Str("rx");
+    msg.Str("timestamp").Double(timestamp);
+    msg.Str("id").Str("video rx");
+    msg.Str("rx_ant_stats").Map(static_cast<uint32_t>(antennas.size()));
+    for (const auto &ant : antennas)
+    {
+        msg.Array(2).Array(3).Int(5805).Int(1).Int(20).Int(ant.antenna_id);
+        msg.Array(7)
+            .Int(ant.packets)
+            .Int(ant.rssi_avg - 3)
+            .Int(ant.rssi_avg)
+            .Int(ant.rssi_avg + 3)
+            .Int(ant.snr_avg - 2)
+            .Int(ant.snr_avg)
+            .Int(ant.snr_avg + 2);
+    }
+    msg.Str("packets").Map(6);
+    msg.Str("all").Array(2).Int(out + lost).Int(100000);
+    msg.Str("all_bytes").Array(2).Int(out_bytes + out_bytes / 10).Int(100000000);
+    msg.Str("out").Array(2).Int(out).Int(100000);
+    msg.Str("out_bytes").Array(2).Int(out_bytes).Int(100000000);
+    msg.Str("lost").Array(2).Int(lost).Int(1000);
+    msg.Str("fec_rec").Array(2).Int(fec_rec).Int(1000);
+    return msg.Frame();
+}
+
+// Accepts one client on an ephemeral loopback port, sends it the given
+// chunks and keeps the connection open until destroyed.
+class StatsServer
+{
+public:
+    explicit StatsServer(std::vector<std::vector<uint8_t>> chunks) : chunks_(std::move(chunks))
+    {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            listen(listen_fd_, 1) != 0 || getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+            return;
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread(&StatsServer::Serve, this);
+    }
+    ~StatsServer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (listen_fd_ >= 0)
+            shutdown(listen_fd_, SHUT_RDWR);
+        if (thread_.joinable())
+            thread_.join();
+        if (listen_fd_ >= 0)
+            close(listen_fd_);
+    }
+
+    uint16_t Port() const { return port_; }
+
+private:
+    void Serve()
+    {
+        const int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0)
+            return;
+        for (const auto &chunk : chunks_)
+        {
+            if (send(fd, chunk.data(), chunk.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(chunk.size()))
+                break;
+            // Separate writes so the client sees frames split across reads.
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stopping_; });
+        close(fd);
+    }
+
+    std::vector<std::vector<uint8_t>> chunks_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
+
+bool WaitFor(const std::function<bool()> &done)
+{
+    const auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (Clock::now() < deadline)
+    {
+        if (done())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+bool Near(float value, float expected)
+{
+    return std::fabs(value - expected) < 0.01f;
+}
+
+void TestAntennaAndRate()
+{
+    std::vector<uint8_t> first = RxFrame(1000.0, {{1, 100, -60, 20}, {0, 50, -70, 10}}, 900, 1048576, 100, 50);
+    std::vector<uint8_t> second = RxFrame(1001.0, {{0, 150, -50, 30}, {1, 100, -65, 25}}, 800, 1048576, 200, 100);
+    MsgPack settings;
+    settings.Map(2).Str("type").Str("settings").Str("profile").Str("gs");
+
+    // The second rx frame arrives in two pieces, the first with the ignored
+    // settings message in front of it.
+    std::vector<uint8_t> head = settings.Frame();
+    head.insert(head.end(), second.begin(), second.begin() + 10);
+    StatsServer server({first, head, std::vector<uint8_t>(second.begin() + 10, second.end())});
+    CHECK(server.Port() != 0);
+
+    SignalMonitor monitor(SignalMonitor::Source::WfbApi, "127.0.0.1", server.Port());
+    monitor.Start();
+    CHECK(WaitFor([&]() { return monitor.LatestRate().valid; }));
+    const GroundSignalSnapshot signal = monitor.Latest();
+    const PacketRateSnapshot rate = monitor.LatestRate();
+    monitor.Stop();
+
+    CHECK(signal.valid);
+    CHECK(signal.antenna_count == 2);
+    // Antennas are listed by id, whatever order the message used.
+    CHECK(signal.antennas[0].antenna_id == 0);
+    CHECK(signal.antennas[1].antenna_id == 1);
+    CHECK(signal.antennas[0].last.packets == 150);
+    CHECK(signal.antennas[0].last.rssi_min == -53);
+    CHECK(signal.antennas[0].last.snr_max == 32);
+    CHECK(Near(signal.signal_a, -50.0f));
+    CHECK(Near(signal.signal_b, -65.0f));
+    // Window averages are weighted by packet count: (50 * -70 + 150 * -50) / 200.
+    CHECK(signal.antennas[0].window_packets == 200);
+    CHECK(Near(signal.antennas[0].window_rssi_avg, -55.0f));
+    CHECK(signal.antennas[0].window_rssi_min == -73);
+
+    // The second record covers the one second since the first.
+    CHECK(rate.valid);
+    CHECK(Near(rate.out_pps, 800.0f));
+    CHECK(Near(rate.lost_pps, 200.0f));
+    CHECK(Near(rate.primary_mbps, 8.0f));
+    CHECK(Near(rate.loss_percent, 20.0f));
+    CHECK(Near(rate.fec_percent, 10.0f));
+}
+
+void TestOversizedFrameReconnects()
+{
+    // A length beyond the client's limit drops the connection; nothing from
+    // the garbage behind it may be taken as a sample.
+    std::vector<uint8_t> bogus = {0x7f, 0xff, 0xff, 0xff, 0x81, 0xa4, 't', 'y', 'p', 'e'};
+    StatsServer server({bogus});
+    SignalMonitor monitor(SignalMonitor::Source::WfbApi, "127.0.0.1", server.Port());
+    monitor.Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CHECK(!monitor.Latest().valid);
+    CHECK(!monitor.LatestRate().valid);
+    monitor.Stop();
+}
+} // namespace
+
+int main()
+{
+    TestAntennaAndRate();
+    TestOversizedFrameReconnects();
+    return TestExitCode();
+}